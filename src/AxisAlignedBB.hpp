@@ -249,6 +249,15 @@ struct Aabb {
 		return (D)xLength() * (D)yLength() * (D)zLength();
 	}
 
+	/**
+	 * Calculates the surface area of the box.
+	 * @return The surface area.
+	 */
+	template<typename D=T>
+	D getSurfaceArea() const {
+		return 2 * ((D)xLength() * (D)yLength() + (D)xLength() * (D)zLength() + (D)yLength() * (D)zLength());
+	}
+
 	/**
 	 * The below three functions get the dimensions of the box.
 	 * @return The lengths of the sides of the box.
@@ -17,6 +17,7 @@
  ******************************************************************************/
 
 #include "PhysicsComponent.hpp"
+#include "PhysicsManager.hpp"
 #include "ExtraMath.hpp"
 
 PhysicsComponent::PhysicsComponent(std::shared_ptr<PhysicsObject> physics, std::shared_ptr<CollisionHandler> collHandler) :
@@ -28,7 +29,11 @@ PhysicsComponent::PhysicsComponent(std::shared_ptr<PhysicsObject> physics, std::
 	velocity(0.0, 0.0, 0.0),
 	angularVelocity(0.0, 0.0, 0.0),
 	acceleration(1.2f),
-	rotAccel(1.2f) {
+	rotAccel(1.2f),
+	lastGhostTransform(btTransform::getIdentity()),
+	ghostsPlaced(false),
+	manager(nullptr),
+	managerIndex(0) {
 
 	physics->getBody()->setUserPointer(this);
 
@@ -43,32 +48,33 @@ PhysicsComponent::PhysicsComponent(std::shared_ptr<PhysicsObject> physics, std::
 }
 
 void PhysicsComponent::setControlMode(PhysicsControlMode mode) {
-	currentMode = mode;
+	if (mode == PhysicsControlMode::DYNAMIC && physics->getInitialMass() == 0.0f) {
+		throw std::runtime_error("Attempt to set zero-mass object to dynamic!");
+	}
 
-	switch (mode) {
-		case PhysicsControlMode::DYNAMIC: {
-			if (physics->getInitialMass() == 0.0f) {
-				throw std::runtime_error("Attempt to set zero-mass object to dynamic!");
-			}
+	currentMode = mode;
 
-			btRigidBody* body = physics->getBody();
-			body->setCollisionFlags(body->getCollisionFlags() & ~btCollisionObject::CF_KINEMATIC_OBJECT);
-			body->setActivationState(ACTIVE_TAG);
-			body->setMassProps(physics->getInitialMass(), body->getLocalInertia());
-		}; break;
-		case PhysicsControlMode::KINEMATIC: {
-			btRigidBody* body = physics->getBody();
-			body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
-			body->setActivationState(DISABLE_DEACTIVATION);
-			body->setMassProps(0.0f, body->getLocalInertia());
-		}; break;
-		case PhysicsControlMode::STATIC: {
-			btRigidBody* body = physics->getBody();
-			body->setCollisionFlags(body->getCollisionFlags() & ~btCollisionObject::CF_KINEMATIC_OBJECT);
-			body->setMassProps(0.0f, body->getLocalInertia());
-		}; break;
-		default: throw std::runtime_error("Somehow static, dynamic, and kinematic weren't enough!");
-	}
+	modifyBody([physics = physics, mode]() {
+		btRigidBody* body = physics->getBody();
+
+		switch (mode) {
+			case PhysicsControlMode::DYNAMIC: {
+				body->setCollisionFlags(body->getCollisionFlags() & ~btCollisionObject::CF_KINEMATIC_OBJECT);
+				body->setActivationState(ACTIVE_TAG);
+				body->setMassProps(physics->getInitialMass(), body->getLocalInertia());
+			}; break;
+			case PhysicsControlMode::KINEMATIC: {
+				body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+				body->setActivationState(DISABLE_DEACTIVATION);
+				body->setMassProps(0.0f, body->getLocalInertia());
+			}; break;
+			case PhysicsControlMode::STATIC: {
+				body->setCollisionFlags(body->getCollisionFlags() & ~btCollisionObject::CF_KINEMATIC_OBJECT);
+				body->setMassProps(0.0f, body->getLocalInertia());
+			}; break;
+			default: throw std::runtime_error("Somehow static, dynamic, and kinematic weren't enough!");
+		}
+	});
 }
 
 void PhysicsComponent::onParentSet() {
@@ -98,20 +104,44 @@ void PhysicsComponent::update() {
 		default: throw std::runtime_error("Missing physics control mode");
 	}
 
-	//Reposition ghosts
+	updateGhosts();
+}
+
+void PhysicsComponent::updateGhosts() {
+	if (ghosts.empty()) {
+		return;
+	}
+
+	btTransform objectTransform;
+	physics->getMotionState()->getWorldTransform(objectTransform);
+
+	//Moving ghosts makes bullet update their bounding boxes and overlaps, skip it if nothing changed.
+	if (ghostsPlaced && objectTransform == lastGhostTransform) {
+		return;
+	}
+
 	for (std::shared_ptr<PhysicsGhostObject> ghost : ghosts) {
 		glm::vec3 offset = ghost->getOffset();
 		btTransform ghostTransform(btQuaternion(1, 0, 0, 0), btVector3(offset.x, offset.y, offset.z));
-		btTransform objectTransform;
-		physics->getMotionState()->getWorldTransform(objectTransform);
 
 		ghost->getObject()->setWorldTransform(objectTransform * ghostTransform);
 	}
+
+	lastGhostTransform = objectTransform;
+	ghostsPlaced = true;
 }
 
 glm::vec3 PhysicsComponent::getTranslation() const {
 	btTransform transform;
-	physics->getMotionState()->getWorldTransform(transform);
+	const BodySnapshot* snapshot = getSnapshot();
+
+	if (snapshot) {
+		transform = snapshot->transform;
+	}
+	else {
+		physics->getMotionState()->getWorldTransform(transform);
+	}
+
 	btVector3 trans = transform.getOrigin();
 
 	return glm::vec3(trans.x(), trans.y(), trans.z());
@@ -120,7 +150,14 @@ glm::vec3 PhysicsComponent::getTranslation() const {
 
 glm::quat PhysicsComponent::getRotation() const {
 	btTransform trans;
-	physics->getMotionState()->getWorldTransform(trans);
+	const BodySnapshot* snapshot = getSnapshot();
+
+	if (snapshot) {
+		trans = snapshot->transform;
+	}
+	else {
+		physics->getMotionState()->getWorldTransform(trans);
+	}
 
 	btQuaternion btRot = trans.getRotation();
 
@@ -129,7 +166,14 @@ glm::quat PhysicsComponent::getRotation() const {
 
 glm::vec3 PhysicsComponent::getFront() {
 	btTransform trans;
-	physics->getMotionState()->getWorldTransform(trans);
+	const BodySnapshot* snapshot = getSnapshot();
+
+	if (snapshot) {
+		trans = snapshot->transform;
+	}
+	else {
+		physics->getMotionState()->getWorldTransform(trans);
+	}
 
 	btVector3 front(0.0, 0.0, -1.0);
 	front = trans.getBasis() * front;
@@ -140,33 +184,44 @@ glm::vec3 PhysicsComponent::getFront() {
 void PhysicsComponent::setVelocity(glm::vec3 v) {
 	//TODO: Make threshold configurable?
 	if (glm::distance(v, glm::vec3(velocity.x(), velocity.y(), velocity.z())) > 0.01f) {
-		physics->getBody()->activate(true);
+		modifyBody([physics = physics]() { physics->getBody()->activate(true); });
 		velocity = btVector3(v.x, v.y, v.z);
 	}
 }
 
 glm::vec3 PhysicsComponent::getVelocity() {
-	const btVector3& velocity = getBody()->getBody()->getLinearVelocity();
+	const BodySnapshot* snapshot = getSnapshot();
+	const btVector3& velocity = snapshot ? snapshot->linearVelocity : getBody()->getBody()->getLinearVelocity();
 	return glm::vec3(velocity.x(), velocity.y(), velocity.z());
 }
 
 void PhysicsComponent::applyImpulse(glm::vec3 impulse) {
 	if (currentMode == PhysicsControlMode::DYNAMIC) {
-		physics->getBody()->activate(true);
-		physics->getBody()->applyCentralImpulse(btVector3(impulse.x, impulse.y, impulse.z));
+		modifyBody([physics = physics, impulse]() {
+			physics->getBody()->activate(true);
+			physics->getBody()->applyCentralImpulse(btVector3(impulse.x, impulse.y, impulse.z));
+		});
 	}
 }
 
 void PhysicsComponent::rotate(glm::vec3 amount) {
-	physics->getBody()->activate(true);
-	physics->getBody()->applyTorque(btVector3(amount.x, amount.y, amount.z));
+	modifyBody([physics = physics, amount]() {
+		physics->getBody()->activate(true);
+		physics->getBody()->applyTorque(btVector3(amount.x, amount.y, amount.z));
+	});
 }
 
 void PhysicsComponent::setRotation(glm::vec3 amount) {
-	physics->getBody()->activate(true);
+	modifyBody([physics = physics]() { physics->getBody()->activate(true); });
 	angularVelocity = btVector3(amount.x, amount.y, amount.z);
 }
 
+void PhysicsComponent::setLinearDamping(float amount) {
+	modifyBody([physics = physics, amount]() {
+		physics->getBody()->setDamping(amount, physics->getBody()->getAngularDamping());
+	});
+}
+
 void PhysicsComponent::velocityReduction(bool enable) {
 	linearBrakes = enable;
 }
@@ -183,9 +238,22 @@ void PhysicsComponent::setRotationalAcceleration(float accel) {
 	rotAccel = accel;
 }
 
-void PhysicsComponent::onCollide(Screen* screen, PhysicsComponent* other) {
+void PhysicsComponent::onCollide(Screen* screen, const CollisionEvent* events, size_t count) {
 	if (collider) {
-		collider->handleCollision(screen, other);
+		collider->handleCollisions(screen, events, count);
+	}
+}
+
+const BodySnapshot* PhysicsComponent::getSnapshot() const {
+	return manager ? manager->getBodySnapshot(managerIndex) : nullptr;
+}
+
+void PhysicsComponent::modifyBody(std::function<void()>&& func) {
+	if (manager) {
+		manager->runCommand(std::move(func));
+	}
+	else {
+		func();
 	}
 }
 
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include <glm/glm.hpp>
 
 #include "Component.hpp"
@@ -28,6 +30,8 @@
 #include "PhysicsGhostObject.hpp"
 
 class PhysicsComponent;
+class PhysicsManager;
+struct BodySnapshot;
 
 //Determines how the physics body is controlled. Defaults to dynamic if
 //mass is non-zero, static otherwise. 0 mass objects cannot currently
@@ -41,6 +45,24 @@ enum class PhysicsControlMode {
 	DYNAMIC
 };
 
+//The kinds of changes in contact state between two objects.
+enum class CollisionEventType {
+	//The objects started touching during the last tick.
+	BEGIN,
+	//The objects were touching in the previous tick, and still are.
+	PERSIST,
+	//The objects were touching in the previous tick, but aren't anymore.
+	END
+};
+
+//A change in contact state between a handler's parent and another object.
+struct CollisionEvent {
+	//What happened between the two objects.
+	CollisionEventType type;
+	//The object the parent collided with.
+	PhysicsComponent* other;
+};
+
 //Allows for user-defined collision responses.
 struct CollisionHandler {
 	virtual ~CollisionHandler() {}
@@ -49,13 +71,36 @@ struct CollisionHandler {
 	PhysicsComponent* parent;
 
 	/**
-	 * Handles collision with the provided object. This function MUST
-	 * be threadsafe.
+	 * Handles all of the parent's collision events from the last tick. This
+	 * is called at most once per tick, and never from more than one thread
+	 * at once for the same handler, so the parent object can be modified
+	 * without locking. If the physics manager dispatches collisions in parallel,
+	 * handlers for other objects may be running at the same time, so other objects
+	 * shouldn't be modified directly in that case.
+	 * The default implementation calls handleCollision for every object the parent
+	 * is touching (BEGIN and PERSIST events).
+	 * @param screen The parent screen, for adding / removing objects and
+	 *     modifying screen state.
+	 * @param events The events for the parent, grouped together.
+	 * @param count The number of events.
+	 */
+	virtual void handleCollisions(Screen* screen, const CollisionEvent* events, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			if (events[i].type != CollisionEventType::END) {
+				handleCollision(screen, events[i].other);
+			}
+		}
+	}
+
+	/**
+	 * Handles collision with the provided object. Only called from the default
+	 * implementation of handleCollisions above, once per tick for each object
+	 * touching the parent.
 	 * @param screen The parent screen, for adding / removing objects and
 	 *     modifying screen state.
 	 * @param hitObject The object that was hit.
 	 */
-	virtual void handleCollision(Screen* screen, PhysicsComponent* hitObject) = 0;
+	virtual void handleCollision(Screen* screen, PhysicsComponent* hitObject) {}
 };
 
 class PhysicsComponent : public Component, ObjectPhysicsInterface {
@@ -104,19 +149,39 @@ public:
 
 	/**
 	 * Fetches all the physics components intersecting with the provided
-	 * ghost object.
+	 * ghost object. To be notified of changes instead of polling, set a
+	 * TriggerHandler in the ghost's creation info.
 	 * @param index The value returned from the call to addGhost for the desired ghost object.
 	 * @return A list of items colliding with the selected ghost.
 	 */
-	std::vector<PhysicsComponent*> getGhostCollisions(uint64_t index) {
-		return ghosts.at(index)->getCollisions();
-	}
+	const std::vector<PhysicsComponent*>& getGhostCollisions(uint64_t index) const { return ghosts.at(index)->getCollisions(); }
 
 	/**
 	 * Applies velocity changes and such to the internal object.
 	 */
 	void update();
 
+	/**
+	 * Moves all ghost objects to their offsets from the body's current position,
+	 * if the body moved since they were last placed. Called from update, and by
+	 * the manager when the component is first added.
+	 */
+	void updateGhosts();
+
+	/**
+	 * Returns whether update() has any work to do for this component. Static
+	 * bodies never change, and bodies bullet has put to sleep will ignore
+	 * any applied forces anyway.
+	 * @return Whether the component needs to be updated this tick.
+	 */
+	bool needsUpdate() const { return currentMode != PhysicsControlMode::STATIC && physics->getBody()->isActive(); }
+
+	/**
+	 * Gets the way the object is currently being animated.
+	 * @return The current control mode.
+	 */
+	PhysicsControlMode getControlMode() const { return currentMode; }
+
 	/**
 	 * Used by rendering.
 	 */
@@ -185,14 +250,22 @@ public:
 	 * Sets the damping on the linear velocity of the object.
 	 * @param amount The new damping value.
 	 */
-	void setLinearDamping(float amount) { physics->getBody()->setDamping(amount, physics->getBody()->getAngularDamping()); }
+	void setLinearDamping(float amount);
 
 	/**
-	 * Called by the physics component manager when this object collides with another.
+	 * Called by the physics component manager with this object's collision events for the tick.
 	 * @param screen A screen, can be used for removing / adding other objects as a result of a collision.
-	 * @param other The object that was collided with.
+	 * @param events The collision events involving this object.
+	 * @param count The number of events.
 	 */
-	void onCollide(Screen* screen, PhysicsComponent* other);
+	void onCollide(Screen* screen, const CollisionEvent* events, size_t count);
+
+	/**
+	 * Returns whether the component has a collision handler, so the manager
+	 * can avoid generating events nobody will receive.
+	 * @return Whether a collision handler was set.
+	 */
+	bool hasCollisionHandler() const { return collider != nullptr; }
 
 	/**
 	 * Returns the parent object, mainly for removal from screen and manipulating state.
@@ -205,6 +278,13 @@ public:
 	 */
 	std::vector<std::shared_ptr<PhysicsGhostObject>>& getGhosts() { return ghosts; }
 
+	/**
+	 * Only to be called from PhysicsManager.
+	 * @param newManager The manager this component was added to, or nullptr if removed.
+	 * @param index The component's index in the manager's component list.
+	 */
+	void setManager(PhysicsManager* newManager, size_t index) { manager = newManager; managerIndex = index; }
+
 private:
 	//Physics object used by this physics component.
 	std::shared_ptr<PhysicsObject> physics;
@@ -220,6 +300,28 @@ private:
 	btVector3 angularVelocity;
 	float acceleration;
 	float rotAccel;
+	//The body's transform when the ghosts were last moved.
+	btTransform lastGhostTransform;
+	//Whether the ghosts have been placed at all yet.
+	bool ghostsPlaced;
+	//The manager this component is in, null if none.
+	PhysicsManager* manager;
+	//Index of this component in the manager, for finding its snapshot.
+	size_t managerIndex;
+
+	/**
+	 * Gets the state of the body at the end of the last step, if the manager
+	 * is stepping asynchronously.
+	 * @return The snapshot, or nullptr if the body can be read directly.
+	 */
+	const BodySnapshot* getSnapshot() const;
+
+	/**
+	 * Runs a function that modifies the body, delaying it until the current
+	 * step finishes if the world is being stepped asynchronously.
+	 * @param func The function to run.
+	 */
+	void modifyBody(std::function<void()>&& func);
 
 	btVector3 getAdjustedForce(btVector3 target, btVector3 current, float acceleration, float damping, bool brakes);
 };
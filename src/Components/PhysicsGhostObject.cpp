@@ -16,46 +16,111 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 
+#include <algorithm>
+
 #include "PhysicsGhostObject.hpp"
+#include "Engine.hpp"
+
+void TriggerGhost::addOverlappingObjectInternal(btBroadphaseProxy* otherProxy, btBroadphaseProxy* thisProxy) {
+	const int oldOverlaps = getNumOverlappingObjects();
+
+	btPairCachingGhostObject::addOverlappingObjectInternal(otherProxy, thisProxy);
+
+	//Bullet ignores duplicate additions, so only record ones that actually did something.
+	if (getNumOverlappingObjects() != oldOverlaps) {
+		owner->recordChange(static_cast<const btCollisionObject*>(otherProxy->m_clientObject), true);
+	}
+}
+
+void TriggerGhost::removeOverlappingObjectInternal(btBroadphaseProxy* otherProxy, btDispatcher* dispatcher, btBroadphaseProxy* thisProxy) {
+	const int oldOverlaps = getNumOverlappingObjects();
+
+	btPairCachingGhostObject::removeOverlappingObjectInternal(otherProxy, dispatcher, thisProxy);
+
+	if (getNumOverlappingObjects() != oldOverlaps) {
+		owner->recordChange(static_cast<const btCollisionObject*>(otherProxy->m_clientObject), false);
+	}
+}
 
 PhysicsGhostObject::PhysicsGhostObject(const PhysicsGhostInfo& info, PhysicsComponent* parent) :
 	ghost(nullptr),
-	shape(nullptr),
 	posOffset(info.pos),
-	parent(parent) {
+	parent(parent),
+	handler(info.handler),
+	changeList(nullptr),
+	collisionGroup(info.collisionGroup),
+	collisionMask(info.collisionMask) {
 
-	ghost = new btGhostObject;
-
-	switch (info.shape) {
-		case PhysicsShape::PLANE: throw std::runtime_error("Plane not supported for ghosts!");
-		case PhysicsShape::BOX: shape = createBoxObject(info); break;
-		case PhysicsShape::CAPSULE: shape = createCapsuleObject(info); break;
-		case PhysicsShape::SPHERE: shape = createSphereObject(info); break;
-		default: throw std::runtime_error("Missing physics shape!");
+	if (info.shape == PhysicsShape::PLANE) {
+		throw std::runtime_error("Plane not supported for ghosts!");
 	}
 
+	ghost = new TriggerGhost(this);
+
+	shape = Engine::instance->getPhysicsShapeCache().getShape(info.shape, info.box);
+
 	btTransform trans;
 	trans.setIdentity();
 	trans.setOrigin(btVector3(info.pos.x, info.pos.y, info.pos.z));
 
 	ghost->setWorldTransform(trans);
 
-	ghost->setCollisionShape(shape);
+	ghost->setCollisionShape(shape.get());
 	ghost->setCollisionFlags(ghost->getCollisionFlags() | btCollisionObject::CF_NO_CONTACT_RESPONSE);
 }
 
-std::vector<PhysicsComponent*> PhysicsGhostObject::getCollisions() {
-	uint64_t numCollisions = ghost->getNumOverlappingObjects();
+void PhysicsGhostObject::recordChange(const btCollisionObject* other, bool entered) {
+	PhysicsComponent* comp = static_cast<PhysicsComponent*>(other->getUserPointer());
 
-	std::vector<PhysicsComponent*> out;
+	//Other ghosts don't have a user pointer
+	if (comp == nullptr || comp == parent) {
+		return;
+	}
+
+	if (pendingChanges.empty() && changeList != nullptr) {
+		changeList->push_back(this);
+	}
+
+	pendingChanges.push_back({comp, entered ? 1 : -1});
+}
+
+void PhysicsGhostObject::flushChanges(Screen* screen) {
+	//Group changes by component, keeping their order, so an object that
+	//entered and left in the same tick cancels out.
+	std::stable_sort(pendingChanges.begin(), pendingChanges.end(), [](const std::pair<PhysicsComponent*, int>& a, const std::pair<PhysicsComponent*, int>& b) {
+		return std::less<PhysicsComponent*>()(a.first, b.first);
+	});
+
+	size_t i = 0;
+
+	while (i < pendingChanges.size()) {
+		PhysicsComponent* comp = pendingChanges.at(i).first;
+		int netChange = 0;
+
+		for (; i < pendingChanges.size() && pendingChanges.at(i).first == comp; i++) {
+			netChange += pendingChanges.at(i).second;
+		}
+
+		if (netChange > 0) {
+			overlaps.push_back(comp);
+
+			if (handler) {
+				handler->onEnter(screen, comp);
+			}
+		}
+		else if (netChange < 0) {
+			auto compLoc = std::find(overlaps.begin(), overlaps.end(), comp);
 
-	for (uint64_t i = 0; i < numCollisions; i++) {
-		PhysicsComponent* comp = static_cast<PhysicsComponent*>(ghost->getOverlappingObject(i)->getUserPointer());
+			if (compLoc != overlaps.end()) {
+				*compLoc = overlaps.back();
+				overlaps.pop_back();
+			}
 
-		if (comp != nullptr && comp != parent) {
-			out.push_back(comp);
+			if (handler) {
+				handler->onExit(screen, comp);
+			}
 		}
 	}
 
-	return out;
+	pendingChanges.clear();
 }
@@ -18,6 +18,10 @@
 
 #pragma once
 
+#include <vector>
+#include <memory>
+#include <utility>
+
 #include <glm/glm.hpp>
 
 #include "BulletCollision/CollisionDispatch/btGhostObject.h"
@@ -25,6 +29,28 @@
 #include "PhysicsObject.hpp"
 
 class PhysicsComponent;
+class PhysicsGhostObject;
+class Screen;
+
+//Receives events when objects enter or leave a ghost object.
+struct TriggerHandler {
+	virtual ~TriggerHandler() {}
+
+	/**
+	 * Called once when an object starts overlapping the ghost.
+	 * @param screen The parent screen.
+	 * @param other The object that entered.
+	 */
+	virtual void onEnter(Screen* screen, PhysicsComponent* other) {}
+
+	/**
+	 * Called once when an object stops overlapping the ghost, or
+	 * is removed from the world while overlapping it.
+	 * @param screen The parent screen.
+	 * @param other The object that left.
+	 */
+	virtual void onExit(Screen* screen, PhysicsComponent* other) {}
+};
 
 struct PhysicsGhostInfo {
 	//The shape for the ghost.
@@ -34,6 +60,26 @@ struct PhysicsGhostInfo {
 	Aabb<float> box;
 	//The starting position of the ghost, relative to the parent object. Note that for planes, this is an additional shift to the one for the box.
 	glm::vec3 pos;
+	//Optional handler for enter and exit events.
+	std::shared_ptr<TriggerHandler> handler;
+	//Collision group bits for the ghost, 0 puts it in the "sensor" layer.
+	uint32_t collisionGroup = 0;
+	//Groups the ghost overlaps with, 0 uses the manager's layer matrix for the ghost's group.
+	uint32_t collisionMask = 0;
+};
+
+//A ghost that tells its owner whenever bullet adds or removes one of its overlaps,
+//so overlaps don't need to be rescanned every tick.
+class TriggerGhost : public btPairCachingGhostObject {
+public:
+	TriggerGhost(PhysicsGhostObject* owner) : owner(owner) {}
+
+	void addOverlappingObjectInternal(btBroadphaseProxy* otherProxy, btBroadphaseProxy* thisProxy = nullptr) override;
+	void removeOverlappingObjectInternal(btBroadphaseProxy* otherProxy, btDispatcher* dispatcher, btBroadphaseProxy* thisProxy = nullptr) override;
+
+private:
+	//The ghost object this is a part of.
+	PhysicsGhostObject* owner;
 };
 
 class PhysicsGhostObject {
@@ -50,7 +96,6 @@ public:
 	 */
 	~PhysicsGhostObject() {
 		delete ghost;
-		delete shape;
 	}
 
 	/**
@@ -66,52 +111,72 @@ public:
 	glm::vec3 getOffset() const { return posOffset; }
 
 	/**
-	 * Finds all the physics components that are currently colliding with
-	 * this ghost object, excluding the parent object.
-	 * @return A list of colliding physics components.
+	 * Gets all the physics components that are currently overlapping with
+	 * this ghost object, excluding the parent object. This is updated once
+	 * per tick, after the world is stepped.
+	 * @return A list of overlapping physics components, in no particular order.
 	 */
-	std::vector<PhysicsComponent*> getCollisions();
+	const std::vector<PhysicsComponent*>& getCollisions() const { return overlaps; }
 
-private:
-	//The object.
-	btGhostObject* ghost;
-	//Shape used by the object for collisions.
-	btCollisionShape* shape;
-	//Relative position of the ghost from the parent object's center.
-	glm::vec3 posOffset;
-	//The parent of this ghost object.
-	PhysicsComponent* parent;
+	/**
+	 * Sets the list the ghost adds itself to when its overlaps change, so the
+	 * manager only needs to process changed ghosts. Only for PhysicsManager.
+	 * @param list The manager's list of changed ghosts, or nullptr when removed from the manager.
+	 */
+	void setChangeList(std::vector<PhysicsGhostObject*>* list) { changeList = list; }
 
 	/**
-	 * Creates a box collision object.
-	 * @param createInfo The creation info for the physics object.
-	 * @return The new box shape.
+	 * Records that the given object started or stopped overlapping with the ghost.
+	 * Only called from TriggerGhost.
+	 * @param other The collision object that changed.
+	 * @param entered Whether the object entered (true) or left (false).
 	 */
-	btBoxShape* createBoxObject(const PhysicsGhostInfo& createInfo) {
-		Aabb<float> box = createInfo.box;
+	void recordChange(const btCollisionObject* other, bool entered);
 
-		return new btBoxShape(btVector3(box.xLength() / 2.0f, box.yLength() / 2.0f, box.zLength() / 2.0f));
-	}
+	/**
+	 * Applies all changes since the last flush to the overlap list, and sends
+	 * the handler one enter or exit event for each object whose overlap state
+	 * actually changed. Only for PhysicsManager.
+	 * @param screen The screen to pass to the handler.
+	 */
+	void flushChanges(Screen* screen);
 
 	/**
-	 * Creates a capsule. The ends are always at the top and bottom for now.
-	 * @param createInfo The physics object creation info.
-	 * @return A new capsule shape.
+	 * Drops any changes that haven't been flushed yet. Used when the ghost is
+	 * removed from the world.
 	 */
-	btCapsuleShape* createCapsuleObject(const PhysicsGhostInfo& createInfo) {
-		Aabb<float> box = createInfo.box;
+	void discardChanges() { pendingChanges.clear(); }
 
-		return new btCapsuleShape(box.xLength() / 2.0f, box.yLength());
-	}
+	/**
+	 * Gets the collision group the ghost was created with.
+	 * @return The group bits, 0 for the default.
+	 */
+	uint32_t getCollisionGroup() const { return collisionGroup; }
 
 	/**
-	 * Creates a sphere. This assumes that the bounding box is a cube.
-	 * @param createInfo The physics object creation info.
-	 * @return A new sphere shape.
+	 * Gets the collision mask the ghost was created with.
+	 * @return The mask bits, 0 to use the layer matrix.
 	 */
-	btSphereShape* createSphereObject(const PhysicsGhostInfo& createInfo) {
-		Aabb<float> box = createInfo.box;
+	uint32_t getCollisionMask() const { return collisionMask; }
 
-		return new btSphereShape(box.xLength() / 2.0f);
-	}
+private:
+	//The object.
+	TriggerGhost* ghost;
+	//Shape used by the object for collisions, shared through the shape cache.
+	std::shared_ptr<btCollisionShape> shape;
+	//Relative position of the ghost from the parent object's center.
+	glm::vec3 posOffset;
+	//The parent of this ghost object.
+	PhysicsComponent* parent;
+	//Handler for enter / exit events, can be null.
+	std::shared_ptr<TriggerHandler> handler;
+	//Components currently overlapping the ghost, as of the last flush.
+	std::vector<PhysicsComponent*> overlaps;
+	//Overlap changes since the last flush, +1 for entering and -1 for leaving.
+	std::vector<std::pair<PhysicsComponent*, int>> pendingChanges;
+	//The list to add this ghost to when pendingChanges becomes non-empty.
+	std::vector<PhysicsGhostObject*>* changeList;
+	//Collision filtering, applied when added to the world.
+	uint32_t collisionGroup;
+	uint32_t collisionMask;
 };
@@ -16,7 +16,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 
-#include <thread>
+#include <algorithm>
+#include <cmath>
+
+#include <tbb/enumerable_thread_specific.h>
 
 #include "LinearMath/btThreads.h"
 #include "PhysicsManager.hpp"
@@ -26,93 +29,499 @@
 #include "Display/Camera.hpp"
 #include "TBBThreadHandlerBtCompat.hpp"
 
-void PhysicsManager::physicsTickCallback(btDynamicsWorld* world, btScalar timeStep) {
-	static_cast<PhysicsManager*>(world->getWorldUserInfo())->tickCallback();
+namespace {
+	//Number of components updated serially per task. Updates are pretty
+	//cheap, so this needs to be fairly large to outweigh the overhead.
+	constexpr size_t UPDATE_GRAIN_SIZE = 256;
+	//Number of queries run serially per task for batched queries.
+	//Queries are much more expensive than updates, so this is smaller.
+	constexpr size_t QUERY_GRAIN_SIZE = 32;
+
+	btVector3 toBtVec(const glm::vec3& vec) {
+		return btVector3(vec.x, vec.y, vec.z);
+	}
+
+	glm::vec3 toGlmVec(const btVector3& vec) {
+		return glm::vec3(vec.getX(), vec.getY(), vec.getZ());
+	}
+
+	//Number of cells a query can cover before it's faster to just check every cell.
+	constexpr int64_t MAX_QUERY_CELLS = 64;
+
+	//Gets the cell coordinate of a position along one axis.
+	int32_t cellCoord(float pos, float cellSize) {
+		return (int32_t) std::floor(pos / cellSize);
+	}
+
+	//Sets which collision groups a query can hit.
+	template<typename Callback>
+	void setQueryMask(Callback& callback, uint32_t mask) {
+		//Queries are in every group, so objects can't filter them out, only the query's mask matters.
+		callback.m_collisionFilterGroup = btBroadphaseProxy::AllFilter;
+		callback.m_collisionFilterMask = (mask != 0) ? (int) mask : btBroadphaseProxy::AllFilter;
+	}
+
+	//Packs a cell's coordinates into a single key.
+	uint64_t cellKey(int32_t x, int32_t z) {
+		return ((uint64_t) (uint32_t) x << 32) | (uint32_t) z;
+	}
 }
 
 PhysicsManager::PhysicsManager() :
 	ComponentManager(PHYSICS_COMPONENT_NAME),
-	conf(new btDefaultCollisionConfiguration()),
-	broadphase(new btDbvtBroadphase()),
-	solver(new btSequentialImpulseConstraintSolverMt()),
-	//Number of parallel solvers might need tweaking later, depending on other threads needed.
-	solverPool(new btConstraintSolverPoolMt(std::max(std::thread::hardware_concurrency(), 1u))),
-	ghostCallback(new btGhostPairCallback()) {
+	regionsEnabled(false),
+	regionConfig{},
+	gravity(0.0, -9.80665, 0.0),
+	layerMasks{},
+	cameraPos(0.0f),
+	lodEnabled(false),
+	lodConfig{},
+	substeps(0),
+	parallelDispatch(false),
+	asyncStepping(false),
+	stepping(false),
+	resultsPending(false),
+	snapshotStale(true) {
 
 	static TaskSchedulerTBB scheduler;
 
+	const size_t physicsThreads = Engine::instance->getConfig().physicsThreads;
+
+	if (physicsThreads != 0) {
+		scheduler.setNumThreads(physicsThreads);
+	}
+	else {
+		scheduler.setNumThreads(scheduler.getMaxNumThreads());
+	}
+
 	btSetTaskScheduler(&scheduler);
 
-	dispatcher = new btCollisionDispatcherMt(conf, 40);
-	world = new  btDiscreteDynamicsWorldMt(dispatcher, broadphase, solverPool, solver, conf);
-	world->setGravity(btVector3(0.0, -9.80665, 0.0));
-	world->setInternalTickCallback(physicsTickCallback, this, false);
-	world->getBroadphase()->getOverlappingPairCache()->setInternalGhostPairCallback(ghostCallback);
+	//Bullet's standard groups, with the same defaults it uses when adding bodies without a filter.
+	layerBits["default"] = 0;
+	layerBits["static"] = 1;
+	layerBits["kinematic"] = 2;
+	layerBits["debris"] = 3;
+	layerBits["sensor"] = 4;
+	layerBits["character"] = 5;
+	layerMasks.fill(0xFFFFFFFF);
+	layerMasks.at(1) &= ~(uint32_t) btBroadphaseProxy::StaticFilter;
+
+	mainWorld = std::make_unique<PhysicsWorld>(scheduler.getNumThreads(), gravity);
+	worlds.push_back(mainWorld.get());
 }
 
 PhysicsManager::~PhysicsManager() {
-	delete world;
-	delete solver;
-	delete broadphase;
-	delete dispatcher;
-	delete conf;
-	delete solverPool;
-	delete ghostCallback;
+	waitForStep();
+
+	//Proxies and terrain need to be out of their worlds before either is deleted.
+	for (std::unique_ptr<PhysicsTerrain>& terrain : terrains) {
+		for (size_t i = 0; i < terrain->getChunkCount(); i++) {
+			removeTerrainChunk(terrain.get(), i);
+		}
+	}
+
+	for (auto& proxies : staticProxies) {
+		for (BodyProxy& proxy : proxies.second) {
+			proxy.world->getWorld()->removeRigidBody(proxy.body.get());
+		}
+	}
+
+	for (std::vector<BodyProxy>& proxies : borderProxies) {
+		for (BodyProxy& proxy : proxies) {
+			proxy.world->unfollow(proxy.body.get());
+			proxy.world->getWorld()->removeRigidBody(proxy.body.get());
+		}
+	}
 }
 
-void PhysicsManager::update() {
-	for (std::shared_ptr<Component> comp : components) {
-		std::shared_ptr<PhysicsComponent> physics = std::static_pointer_cast<PhysicsComponent>(comp);
-		physics->update();
+void PhysicsManager::setGravity(float x, float y, float z) {
+	waitForStep();
+
+	gravity = btVector3(x, y, z);
+
+	for (PhysicsWorld* world : worlds) {
+		world->getWorld()->setGravity(gravity);
 	}
+}
 
-	world->stepSimulation(Engine::instance->getConfig().timestep / 1000.0, 20, Engine::instance->getConfig().physicsTimestep);
+void PhysicsManager::enableRegions(const PhysicsRegionConfig& config) {
+	if (!physicsComponents.empty() || !terrains.empty()) {
+		throw std::runtime_error("Regions must be enabled before adding physics components or terrain!");
+	}
+
+	if (config.cellSize <= 0.0f) {
+		throw std::runtime_error("Physics region cell size must be positive!");
+	}
+
+	waitForStep();
+
+	regionsEnabled = true;
+	regionConfig = config;
+	regionConfig.farStepInterval = std::max(regionConfig.farStepInterval, (uint32_t) 1);
+
+	worlds.clear();
+	mainWorld.reset();
 }
 
-RaytraceResult PhysicsManager::raytraceSingle(glm::vec3 start, glm::vec3 end) {
-	btVector3 from(start.x, start.y, start.z);
-	btVector3 to(end.x, end.y, end.z);
+PhysicsTerrain* PhysicsManager::addTerrain(const PhysicsTerrainInfo& info) {
+	waitForStep();
 
-	if (world->getDebugDrawer()) {
-		world->getDebugDrawer()->drawLine(from, to, btVector3(1.0, 1.0, 0.0));
+	terrains.push_back(std::make_unique<PhysicsTerrain>(info));
+	return terrains.back().get();
+}
+
+void PhysicsManager::removeTerrain(PhysicsTerrain* terrain) {
+	waitForStep();
+
+	auto terrainLoc = std::find_if(terrains.begin(), terrains.end(), [&](const std::unique_ptr<PhysicsTerrain>& ptr) {
+		return ptr.get() == terrain;
+	});
+
+	if (terrainLoc == terrains.end()) {
+		throw std::runtime_error("Attempt to remove non-present terrain");
 	}
 
-	btCollisionWorld::ClosestRayResultCallback closestResult(from, to);
+	for (size_t i = 0; i < terrain->getChunkCount(); i++) {
+		removeTerrainChunk(terrain, i);
+	}
 
-	world->rayTest(from, to, closestResult);
-	RaytraceResult out = {};
+	terrains.erase(terrainLoc);
+}
+
+uint32_t PhysicsManager::addCollisionLayer(const std::string& name) {
+	if (layerBits.count(name)) {
+		throw std::runtime_error("Collision layer \"" + name + "\" already exists!");
+	}
+
+	if (layerBits.size() >= layerMasks.size()) {
+		throw std::runtime_error("Out of collision layers for \"" + name + "\"!");
+	}
+
+	const uint32_t bit = layerBits.size();
+	layerBits[name] = bit;
 
-	if (closestResult.hasHit()) {
-		out.hitComp = (PhysicsComponent*) closestResult.m_collisionObject->getUserPointer();
-		out.hitPos = glm::vec3(closestResult.m_hitPointWorld.getX(), closestResult.m_hitPointWorld.getY(), closestResult.m_hitPointWorld.getZ());
-		out.hitNormal = glm::vec3(closestResult.m_hitNormalWorld.getX(), closestResult.m_hitNormalWorld.getY(), closestResult.m_hitNormalWorld.getZ());
+	return 1u << bit;
+}
+
+uint32_t PhysicsManager::getCollisionLayer(const std::string& name) const {
+	auto layerLoc = layerBits.find(name);
+
+	if (layerLoc == layerBits.end()) {
+		throw std::runtime_error("Collision layer \"" + name + "\" doesn't exist!");
+	}
+
+	return 1u << layerLoc->second;
+}
+
+void PhysicsManager::setLayersCollide(const std::string& first, const std::string& second, bool collide) {
+	const uint32_t firstGroup = getCollisionLayer(first);
+	const uint32_t secondGroup = getCollisionLayer(second);
+
+	uint32_t& firstMask = layerMasks.at(layerBits.at(first));
+	uint32_t& secondMask = layerMasks.at(layerBits.at(second));
+
+	if (collide) {
+		firstMask |= secondGroup;
+		secondMask |= firstGroup;
+	}
+	else {
+		firstMask &= ~secondGroup;
+		secondMask &= ~firstGroup;
+	}
+}
+
+uint32_t PhysicsManager::getLayerMask(uint32_t group) const {
+	uint32_t mask = 0;
+
+	for (size_t i = 0; i < layerMasks.size(); i++) {
+		if (group & (1u << i)) {
+			mask |= layerMasks[i];
+		}
+	}
+
+	return mask;
+}
+
+void PhysicsManager::enableLod(const PhysicsLodConfig& config) {
+	if (config.restoreDistance > config.freezeDistance) {
+		throw std::runtime_error("Physics restore distance can't be greater than freeze distance!");
+	}
+
+	lodEnabled = true;
+	lodConfig = config;
+}
+
+void PhysicsManager::disableLod() {
+	waitForStep();
+
+	for (size_t i = 0; i < lodStates.size(); i++) {
+		if (lodStates.at(i).frozen) {
+			restoreBody(i);
+		}
+	}
+
+	lodEnabled = false;
+}
+
+std::vector<btCollisionWorld*> PhysicsManager::getWorlds() const {
+	//The caller is going to read from the worlds, so they can't be stepping.
+	waitForStep();
+
+	std::vector<btCollisionWorld*> out;
+	out.reserve(worlds.size());
+
+	for (PhysicsWorld* world : worlds) {
+		out.push_back(world->getWorld());
 	}
 
 	return out;
 }
 
-std::vector<RaytraceResult> PhysicsManager::raytraceAll(glm::vec3 start, glm::vec3 end) {
+void PhysicsManager::update() {
+	if (asyncStepping) {
+		waitForStep();
+		acquireStepResults();
+
+		//Process results from the last step before anything can change the world again.
+		if (resultsPending) {
+			resultsPending = false;
+
+			if (snapshots.getReadBuffer().substeps > 0) {
+				generateCollisionEvents(snapshots.getReadBuffer().contacts);
+				dispatchCollisionEvents();
+			}
+
+			flushTriggers();
+		}
+
+		//Component indices changed since the last step, so the snapshot needs to be rebuilt.
+		if (snapshotStale) {
+			StepSnapshot& snapshot = snapshots.getWriteBuffer();
+			captureBodies(snapshot);
+			snapshot.contacts.clear();
+			snapshot.substeps = 0;
+
+			snapshots.publish();
+			snapshots.acquire();
+			snapshotStale = false;
+		}
+	}
+
+	//Each component only modifies its own body and ghosts, so this is safe to do in parallel.
+	Engine::parallelFor(0, physicsComponents.size(), [&](size_t i) {
+		PhysicsComponent* physics = physicsComponents[i];
+
+		if (physics->needsUpdate()) {
+			physics->update();
+		}
+	}, UPDATE_GRAIN_SIZE);
+
+	if (regionsEnabled || lodEnabled || !terrains.empty()) {
+		cameraPos = glm::vec3(glm::inverse(screen->getCamera()->getView())[3]);
+	}
+
+	if (!terrains.empty()) {
+		streamTerrain();
+	}
+
+	if (lodEnabled) {
+		updateLod();
+	}
+
+	if (regionsEnabled) {
+		migrateBodies();
+	}
+
+	if (asyncStepping) {
+		stepping = true;
+
+		stepTask.run([this]() {
+			stepWorld();
+
+			StepSnapshot& snapshot = snapshots.getWriteBuffer();
+			captureBodies(snapshot);
+			snapshot.substeps = substeps;
+
+			if (substeps > 0) {
+				mergeContacts(snapshot.contacts);
+			}
+
+			snapshots.publish();
+		});
+	}
+	else {
+		stepWorld();
+
+		//If no substeps ran, nothing moved, so the contacts from last tick are still valid.
+		if (substeps > 0) {
+			mergeContacts(currentContacts);
+			generateCollisionEvents(currentContacts);
+			dispatchCollisionEvents();
+		}
+
+		flushTriggers();
+	}
+}
+
+void PhysicsManager::setAsyncStepping(bool enable) {
+	if (enable == asyncStepping) {
+		return;
+	}
+
+	waitForStep();
+
+	//Deliver the events from the last background step now, the same way update would have,
+	//so nothing is lost when switching.
+	if (asyncStepping) {
+		acquireStepResults();
+
+		if (resultsPending) {
+			resultsPending = false;
+
+			if (snapshots.getReadBuffer().substeps > 0) {
+				//Synchronous steps that don't run any substeps reuse these
+				currentContacts = snapshots.getReadBuffer().contacts;
+				generateCollisionEvents(currentContacts);
+				dispatchCollisionEvents();
+			}
+
+			flushTriggers();
+		}
+	}
+
+	asyncStepping = enable;
+	snapshotStale = true;
+}
+
+void PhysicsManager::waitForStep() const {
+	if (stepping) {
+		std::lock_guard<std::mutex> lock(stepLock);
+
+		if (stepping) {
+			stepTask.wait();
+			stepping = false;
+		}
+	}
+}
+
+void PhysicsManager::runCommand(std::function<void()>&& command) {
+	if (stepping) {
+		commandQueue.push(std::move(command));
+	}
+	else {
+		command();
+	}
+}
+
+void PhysicsManager::stepWorld() {
+	const btScalar time = Engine::instance->getConfig().timestep / 1000.0;
+	const btScalar fixedStep = Engine::instance->getConfig().physicsTimestep;
+
+	if (!regionsEnabled) {
+		mainWorld->step(time, 20, fixedStep);
+		substeps = mainWorld->getSubsteps();
+		return;
+	}
+
+	const glm::vec2 camera(cameraPos.x, cameraPos.z);
+
+	//Cells don't share anything, so each one can be stepped on its own thread.
+	Engine::parallelFor(0, worlds.size(), [&](size_t i) {
+		PhysicsWorld* cell = worlds[i];
+
+		if (glm::distance(cell->getCenter(), camera) <= regionConfig.fullRateDistance ||
+			cell->getSkippedTicks() + 1 >= regionConfig.farStepInterval) {
+
+			cell->step(time, 20, fixedStep);
+		}
+		else {
+			cell->skipStep(time);
+		}
+	}, 1);
+
+	substeps = 0;
+
+	for (PhysicsWorld* cell : worlds) {
+		substeps += cell->getSubsteps();
+	}
+}
+
+void PhysicsManager::captureBodies(StepSnapshot& snapshot) {
+	snapshot.bodies.resize(physicsComponents.size());
+
+	Engine::parallelFor(0, physicsComponents.size(), [&](size_t i) {
+		PhysicsObject* physics = physicsComponents[i]->getBody().get();
+
+		physics->getMotionState()->getWorldTransform(snapshot.bodies[i].transform);
+		snapshot.bodies[i].linearVelocity = physics->getBody()->getLinearVelocity();
+	}, UPDATE_GRAIN_SIZE);
+}
+
+void PhysicsManager::acquireStepResults() {
+	if (snapshots.acquire()) {
+		resultsPending = true;
+	}
+
+	//Run anything that came in while the step was running. Done after the step is finished
+	//so nothing touches the world during the step, and before components are updated
+	//so they see the changes.
+	std::function<void()> command;
+
+	while (commandQueue.try_pop(command)) {
+		command();
+	}
+}
+
+RaytraceResult PhysicsManager::raytraceSingle(glm::vec3 start, glm::vec3 end, uint32_t mask) {
+	waitForStep();
+
 	btVector3 from(start.x, start.y, start.z);
 	btVector3 to(end.x, end.y, end.z);
 
-	if (world->getDebugDrawer()) {
-		world->getDebugDrawer()->drawLine(from, to, btVector3(1.0, 0.0, 0.0));
+	if (getDebugDrawer()) {
+		getDebugDrawer()->drawLine(from, to, btVector3(1.0, 1.0, 0.0));
 	}
 
-	btCollisionWorld::AllHitsRayResultCallback allResults(from, to);
+	return closestRayHit(from, to, mask);
+}
 
-	world->rayTest(from, to, allResults);
+std::vector<RaytraceResult> PhysicsManager::raytraceAll(glm::vec3 start, glm::vec3 end, uint32_t mask) {
+	waitForStep();
 
-	std::vector<RaytraceResult> out;
+	btVector3 from(start.x, start.y, start.z);
+	btVector3 to(end.x, end.y, end.z);
 
-	//Apparently bullet arrays can have negative sizes
-	for (size_t i = 0; i < (size_t) allResults.m_collisionObjects.size(); i++) {
-		out.emplace_back(RaytraceResult{});
-		out.back().hitComp = (PhysicsComponent*) allResults.m_collisionObjects.at(i)->getUserPointer();
-		out.back().hitPos = glm::vec3(allResults.m_hitPointWorld.at(i).getX(), allResults.m_hitPointWorld.at(i).getY(), allResults.m_hitPointWorld.at(i).getZ());
-		out.back().hitNormal = glm::vec3(allResults.m_hitNormalWorld.at(i).getX(), allResults.m_hitNormalWorld.at(i).getY(), allResults.m_hitNormalWorld.at(i).getZ());
+	if (getDebugDrawer()) {
+		getDebugDrawer()->drawLine(from, to, btVector3(1.0, 0.0, 0.0));
 	}
 
+	std::vector<RaytraceResult> out;
+
+	forEachWorld(from, to, [&](PhysicsWorld* world) {
+		btCollisionWorld::AllHitsRayResultCallback allResults(from, to);
+		setQueryMask(allResults, mask);
+
+		world->getWorld()->rayTest(from, to, allResults);
+
+		//Apparently bullet arrays can have negative sizes
+		for (size_t i = 0; i < (size_t) allResults.m_collisionObjects.size(); i++) {
+			RaytraceResult result = {};
+			result.hitComp = (PhysicsComponent*) allResults.m_collisionObjects.at(i)->getUserPointer();
+			result.hit = true;
+			result.hitPos = toGlmVec(allResults.m_hitPointWorld.at(i));
+			result.hitNormal = toGlmVec(allResults.m_hitNormalWorld.at(i));
+
+			//Static objects in multiple cells get hit once for each cell.
+			auto sameHit = [&](const RaytraceResult& other) {
+				return other.hitComp == result.hitComp && other.hitPos == result.hitPos;
+			};
+
+			if (!regionsEnabled || std::find_if(out.begin(), out.end(), sameHit) == out.end()) {
+				out.push_back(result);
+			}
+		}
+	});
+
 	return out;
 }
 
@@ -136,49 +545,719 @@ RaytraceResult PhysicsManager::raytraceUnderMouse() {
 	return raytraceSingle(nearFar.first, nearFar.second);
 }
 
+void PhysicsManager::raytraceBatch(const Ray* rays, size_t count, RaytraceResult* results) const {
+	waitForStep();
+
+	//The world's query functions are const, and the broadphase keeps separate
+	//traversal stacks for each thread, so this is safe as long as nothing is being stepped.
+	Engine::parallelFor(0, count, [&](size_t i) {
+		results[i] = closestRayHit(toBtVec(rays[i].start), toBtVec(rays[i].end), rays[i].mask);
+	}, QUERY_GRAIN_SIZE);
+}
+
+void PhysicsManager::sweepBatch(const SweepQuery* queries, size_t count, RaytraceResult* results) const {
+	waitForStep();
+
+	Engine::parallelFor(0, count, [&](size_t i) {
+		const SweepQuery& query = queries[i];
+		const btQuaternion rotation(query.rotation.x, query.rotation.y, query.rotation.z, query.rotation.w);
+		const btTransform from(rotation, toBtVec(query.start));
+		const btTransform to(rotation, toBtVec(query.end));
+
+		//Only check the worlds the swept shape could reach.
+		btVector3 center;
+		btScalar radius;
+		query.shape->getBoundingSphere(center, radius);
+
+		const btVector3 extent(radius, radius, radius);
+		btVector3 sweepMin = from.getOrigin();
+		btVector3 sweepMax = from.getOrigin();
+		sweepMin.setMin(to.getOrigin());
+		sweepMax.setMax(to.getOrigin());
+
+		RaytraceResult& out = results[i];
+		out = {};
+		btScalar closestFraction = 2.0;
+
+		forEachWorld(sweepMin - extent, sweepMax + extent, [&](PhysicsWorld* world) {
+			btCollisionWorld::ClosestConvexResultCallback closestResult(from.getOrigin(), to.getOrigin());
+			setQueryMask(closestResult, query.mask);
+			world->getWorld()->convexSweepTest(query.shape, from, to, closestResult);
+
+			if (closestResult.hasHit() && closestResult.m_closestHitFraction < closestFraction) {
+				closestFraction = closestResult.m_closestHitFraction;
+				out.hitComp = (PhysicsComponent*) closestResult.m_hitCollisionObject->getUserPointer();
+				out.hit = true;
+				out.hitPos = toGlmVec(closestResult.m_hitPointWorld);
+				out.hitNormal = toGlmVec(closestResult.m_hitNormalWorld);
+			}
+		});
+	}, QUERY_GRAIN_SIZE);
+}
+
+RaytraceResult PhysicsManager::closestRayHit(const btVector3& from, const btVector3& to, uint32_t mask) const {
+	RaytraceResult out = {};
+	btScalar closestFraction = 2.0;
+
+	forEachWorld(from, to, [&](PhysicsWorld* world) {
+		btCollisionWorld::ClosestRayResultCallback closestResult(from, to);
+		setQueryMask(closestResult, mask);
+		world->getWorld()->rayTest(from, to, closestResult);
+
+		if (closestResult.hasHit() && closestResult.m_closestHitFraction < closestFraction) {
+			closestFraction = closestResult.m_closestHitFraction;
+			out.hitComp = (PhysicsComponent*) closestResult.m_collisionObject->getUserPointer();
+			out.hit = true;
+			out.hitPos = toGlmVec(closestResult.m_hitPointWorld);
+			out.hitNormal = toGlmVec(closestResult.m_hitNormalWorld);
+		}
+	});
+
+	return out;
+}
+
+void PhysicsManager::forEachWorld(const btVector3& min, const btVector3& max, const std::function<void(PhysicsWorld*)>& func) const {
+	btVector3 boxMin = min;
+	btVector3 boxMax = max;
+	boxMin.setMin(max);
+	boxMax.setMax(min);
+
+	if (!regionsEnabled) {
+		func(mainWorld.get());
+		return;
+	}
+
+	const int32_t minX = cellCoord(boxMin.getX(), regionConfig.cellSize);
+	const int32_t maxX = cellCoord(boxMax.getX(), regionConfig.cellSize);
+	const int32_t minZ = cellCoord(boxMin.getZ(), regionConfig.cellSize);
+	const int32_t maxZ = cellCoord(boxMax.getZ(), regionConfig.cellSize);
+
+	//Bodies can be up to the migration margin outside their cell, so check one extra cell on each side.
+	const int32_t pad = (int32_t) std::ceil(regionConfig.migrationMargin / regionConfig.cellSize);
+	const int64_t cellCount = ((int64_t) maxX - minX + 1 + 2 * pad) * ((int64_t) maxZ - minZ + 1 + 2 * pad);
+
+	if (cellCount > MAX_QUERY_CELLS || cellCount > (int64_t) cells.size()) {
+		const glm::vec3 glmMin = toGlmVec(boxMin);
+		const glm::vec3 glmMax = toGlmVec(boxMax);
+
+		for (PhysicsWorld* world : worlds) {
+			if (world->overlaps(glmMin, glmMax, regionConfig.migrationMargin)) {
+				func(world);
+			}
+		}
+
+		return;
+	}
+
+	for (int32_t x = minX - pad; x <= maxX + pad; x++) {
+		for (int32_t z = minZ - pad; z <= maxZ + pad; z++) {
+			auto cellLoc = cells.find(cellKey(x, z));
+
+			if (cellLoc != cells.end()) {
+				func(cellLoc->second.get());
+			}
+		}
+	}
+}
+
 void PhysicsManager::drawDebugLine(glm::vec3 from, glm::vec3 to, glm::vec3 color) {
+	waitForStep();
+
 	btVector3 start(from.x, from.y, from.z);
 	btVector3 end(to.x, to.y, to.z);
 
-	if (world->getDebugDrawer()) {
-		world->getDebugDrawer()->drawLine(start, end, btVector3(color.x, color.y, color.z));
+	if (getDebugDrawer()) {
+		getDebugDrawer()->drawLine(start, end, btVector3(color.x, color.y, color.z));
 	}
 }
 
 void PhysicsManager::onComponentAdd(std::shared_ptr<Component> comp) {
 	std::shared_ptr<PhysicsComponent> physics = std::static_pointer_cast<PhysicsComponent>(comp);
 
-	//Looks stupid, but works. Oh well.
-	world->addRigidBody(physics->getBody()->getBody());
+	waitForStep();
+	snapshotStale = true;
 
-	for (std::shared_ptr<PhysicsGhostObject> ghost : physics->getGhosts()) {
-		world->addCollisionObject(ghost->getObject());
+	physics->setManager(this, physicsComponents.size());
+	physicsComponents.push_back(physics.get());
+
+	//Static components are skipped during updates, so position their ghosts now.
+	physics->updateGhosts();
+
+	PhysicsWorld* target = mainWorld.get();
+
+	if (regionsEnabled) {
+		btTransform transform;
+		physics->getBody()->getMotionState()->getWorldTransform(transform);
+		target = getCell(toGlmVec(transform.getOrigin()));
+
+		//Statics don't migrate, so put a copy in every other cell they reach.
+		if (physics->getControlMode() == PhysicsControlMode::STATIC) {
+			regionStatics.push_back(physics.get());
+
+			for (auto& cell : cells) {
+				if (cell.second.get() != target) {
+					addStaticProxy(physics.get(), cell.second.get());
+				}
+			}
+		}
+	}
+
+	componentWorlds.push_back(target);
+	lodStates.push_back(LodState{false, btVector3(0, 0, 0), btVector3(0, 0, 0)});
+	borderProxies.emplace_back();
+	addToWorld(physics.get(), target);
+
+	if (regionsEnabled && physics->getControlMode() != PhysicsControlMode::STATIC) {
+		updateBorderProxies(physicsComponents.size() - 1);
 	}
 }
 
 void PhysicsManager::onComponentRemove(std::shared_ptr<Component> comp) {
 	std::shared_ptr<PhysicsComponent> physics = std::static_pointer_cast<PhysicsComponent>(comp);
 
-	world->removeRigidBody(physics->getBody()->getBody());
+	waitForStep();
+	snapshotStale = true;
+
+	auto compLoc = std::find(physicsComponents.begin(), physicsComponents.end(), physics.get());
+
+	PhysicsWorld* source = nullptr;
+
+	if (compLoc != physicsComponents.end()) {
+		const size_t index = compLoc - physicsComponents.begin();
+		source = componentWorlds.at(index);
+
+		*compLoc = physicsComponents.back();
+		(*compLoc)->setManager(this, index);
+		physicsComponents.pop_back();
+		physics->setManager(nullptr, 0);
+
+		componentWorlds.at(index) = componentWorlds.back();
+		componentWorlds.pop_back();
+
+		lodStates.at(index) = lodStates.back();
+		lodStates.pop_back();
+
+		for (BodyProxy& proxy : borderProxies.at(index)) {
+			proxy.world->unfollow(proxy.body.get());
+			proxy.world->getWorld()->removeRigidBody(proxy.body.get());
+		}
+
+		borderProxies.at(index) = std::move(borderProxies.back());
+		borderProxies.pop_back();
+	}
+	else {
+		throw std::runtime_error("Attempt to remove non-present physics component");
+	}
+
+	//Forget any contacts with the removed component, it won't be around to receive end events
+	//and other objects shouldn't be handed a pointer to it.
+	auto hasRemoved = [&](const ContactPair& pair) {
+		return pair.first == physics.get() || pair.second == physics.get();
+	};
+
+	lastContacts.erase(std::remove_if(lastContacts.begin(), lastContacts.end(), hasRemoved), lastContacts.end());
+
+	//Worlds that skip steps keep their contacts around, so those need to go too.
+	for (PhysicsWorld* world : worlds) {
+		std::vector<ContactPair>& worldContacts = world->getContacts();
+		worldContacts.erase(std::remove_if(worldContacts.begin(), worldContacts.end(), hasRemoved), worldContacts.end());
+	}
+
+	//Same for the results of the last background step, which haven't been processed yet.
+	if (asyncStepping) {
+		acquireStepResults();
+
+		std::vector<ContactPair>& stepContacts = snapshots.getReadBuffer().contacts;
+		stepContacts.erase(std::remove_if(stepContacts.begin(), stepContacts.end(), hasRemoved), stepContacts.end());
+	}
+
+	removeFromWorld(physics.get(), source);
+
+	auto proxyLoc = staticProxies.find(physics.get());
+
+	if (proxyLoc != staticProxies.end()) {
+		for (BodyProxy& proxy : proxyLoc->second) {
+			proxy.world->getWorld()->removeRigidBody(proxy.body.get());
+		}
+
+		staticProxies.erase(proxyLoc);
+	}
+
+	regionStatics.erase(std::remove(regionStatics.begin(), regionStatics.end(), physics.get()), regionStatics.end());
+
+	for (std::shared_ptr<PhysicsGhostObject> ghost : physics->getGhosts()) {
+		ghost->discardChanges();
+		ghost->setChangeList(nullptr);
+
+		//The ghost might have moved between cells with changes still pending, so check every world.
+		for (PhysicsWorld* world : worlds) {
+			std::vector<PhysicsGhostObject*>& changedTriggers = world->getChangedTriggers();
+			changedTriggers.erase(std::remove(changedTriggers.begin(), changedTriggers.end(), ghost.get()), changedTriggers.end());
+		}
+	}
+
+	//Removing the body made it leave any ghosts it was in, send out the exit
+	//events now, as the component might not exist by the next update.
+	flushTriggers();
+}
+
+void PhysicsManager::mergeContacts(std::vector<ContactPair>& contacts) {
+	contacts.clear();
+
+	for (PhysicsWorld* world : worlds) {
+		contacts.insert(contacts.end(), world->getContacts().begin(), world->getContacts().end());
+	}
+
+	//Each world's list is already sorted, but pairs near cell borders can show up in more than one.
+	if (worlds.size() > 1) {
+		std::sort(contacts.begin(), contacts.end());
+		contacts.erase(std::unique(contacts.begin(), contacts.end()), contacts.end());
+	}
+}
+
+PhysicsWorld* PhysicsManager::getCell(const glm::vec3& pos) {
+	const int32_t x = cellCoord(pos.x, regionConfig.cellSize);
+	const int32_t z = cellCoord(pos.z, regionConfig.cellSize);
+
+	std::unique_ptr<PhysicsWorld>& cell = cells[cellKey(x, z)];
+
+	if (!cell) {
+		//Cells are stepped in parallel with each other, so each one only needs a single thread.
+		cell = std::make_unique<PhysicsWorld>(0, gravity);
+		cell->setBounds(glm::vec2(x, z) * regionConfig.cellSize, glm::vec2(x + 1, z + 1) * regionConfig.cellSize);
+		cell->getWorld()->setDebugDrawer(getDebugDrawer());
+		worlds.push_back(cell.get());
+
+		for (PhysicsComponent* physics : regionStatics) {
+			addStaticProxy(physics, cell.get());
+		}
+
+		//Components added before this cell existed might already be close enough to need a proxy in it.
+		//This can run while a component is being added, before it has a world, so only go up to those that do.
+		for (size_t i = 0; i < componentWorlds.size(); i++) {
+			PhysicsComponent* physics = physicsComponents[i];
+
+			if (physics->getControlMode() == PhysicsControlMode::STATIC) {
+				continue;
+			}
+
+			btRigidBody* original = physics->getBody()->getBody();
+
+			btVector3 aabbMin;
+			btVector3 aabbMax;
+			original->getCollisionShape()->getAabb(original->getWorldTransform(), aabbMin, aabbMax);
+
+			if (cell->overlaps(toGlmVec(aabbMin), toGlmVec(aabbMax), regionConfig.migrationMargin)) {
+				addBorderProxy(i, cell.get());
+			}
+		}
+	}
+
+	return cell.get();
+}
+
+void PhysicsManager::addToWorld(PhysicsComponent* physics, PhysicsWorld* target) {
+	//Looks stupid, but works. Oh well.
+	addFilteredBody(physics->getBody()->getBody(), physics->getBody().get(), target);
 
 	for (std::shared_ptr<PhysicsGhostObject> ghost : physics->getGhosts()) {
-		world->removeCollisionObject(ghost->getObject());
+		const uint32_t group = (ghost->getCollisionGroup() != 0) ? ghost->getCollisionGroup() : btBroadphaseProxy::SensorTrigger;
+		const uint32_t mask = (ghost->getCollisionMask() != 0) ? ghost->getCollisionMask() : getLayerMask(group);
+
+		ghost->setChangeList(&target->getChangedTriggers());
+		target->getWorld()->addCollisionObject(ghost->getObject(), (int) group, (int) mask);
+	}
+}
+
+void PhysicsManager::addFilteredBody(btRigidBody* body, uint32_t group, uint32_t mask, PhysicsWorld* world) const {
+	if (group == 0) {
+		group = body->isStaticOrKinematicObject() ? btBroadphaseProxy::StaticFilter : btBroadphaseProxy::DefaultFilter;
+	}
+
+	if (mask == 0) {
+		mask = getLayerMask(group);
+	}
+
+	world->getWorld()->addRigidBody(body, (int) group, (int) mask);
+}
+
+void PhysicsManager::removeFromWorld(PhysicsComponent* physics, PhysicsWorld* source) {
+	source->getWorld()->removeRigidBody(physics->getBody()->getBody());
+
+	for (std::shared_ptr<PhysicsGhostObject> ghost : physics->getGhosts()) {
+		source->getWorld()->removeCollisionObject(ghost->getObject());
+	}
+}
+
+void PhysicsManager::addStaticProxy(PhysicsComponent* physics, PhysicsWorld* cell) {
+	btRigidBody* original = physics->getBody()->getBody();
+
+	btVector3 aabbMin;
+	btVector3 aabbMax;
+	original->getCollisionShape()->getAabb(original->getWorldTransform(), aabbMin, aabbMax);
+
+	if (!cell->overlaps(toGlmVec(aabbMin), toGlmVec(aabbMax), regionConfig.migrationMargin)) {
+		return;
+	}
+
+	btRigidBody::btRigidBodyConstructionInfo info(0.0, nullptr, original->getCollisionShape());
+	info.m_startWorldTransform = original->getWorldTransform();
+	info.m_friction = original->getFriction();
+	info.m_rollingFriction = original->getRollingFriction();
+	info.m_restitution = original->getRestitution();
+
+	std::unique_ptr<btRigidBody> proxy = std::make_unique<btRigidBody>(info);
+	proxy->setUserPointer(physics);
+
+	addFilteredBody(proxy.get(), physics->getBody().get(), cell);
+	staticProxies[physics].push_back(BodyProxy{cell, std::move(proxy)});
+}
+
+void PhysicsManager::addBorderProxy(size_t index, PhysicsWorld* cell) {
+	PhysicsComponent* physics = physicsComponents[index];
+	btRigidBody* original = physics->getBody()->getBody();
+
+	btRigidBody::btRigidBodyConstructionInfo info(0.0, nullptr, original->getCollisionShape());
+	info.m_startWorldTransform = original->getWorldTransform();
+	info.m_friction = original->getFriction();
+	info.m_rollingFriction = original->getRollingFriction();
+	info.m_restitution = original->getRestitution();
+
+	std::unique_ptr<btRigidBody> proxy = std::make_unique<btRigidBody>(info);
+	proxy->setCollisionFlags(proxy->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+	proxy->forceActivationState(DISABLE_DEACTIVATION);
+	proxy->setUserPointer(physics);
+
+	//The proxy is kinematic, so it would get the static group by default, use the original's instead.
+	uint32_t group = physics->getBody()->getCollisionGroup();
+
+	if (group == 0) {
+		group = original->isStaticOrKinematicObject() ? btBroadphaseProxy::StaticFilter : btBroadphaseProxy::DefaultFilter;
+	}
+
+	addFilteredBody(proxy.get(), group, physics->getBody()->getCollisionMask(), cell);
+	cell->follow(proxy.get(), original->getWorldTransform(), original->getLinearVelocity(), original->getAngularVelocity());
+	borderProxies[index].push_back(BodyProxy{cell, std::move(proxy)});
+}
+
+void PhysicsManager::updateBorderProxies(size_t index) {
+	PhysicsComponent* physics = physicsComponents[index];
+	btRigidBody* original = physics->getBody()->getBody();
+	std::vector<BodyProxy>& proxies = borderProxies[index];
+
+	//Cells that should have a proxy, but don't yet.
+	std::vector<PhysicsWorld*> targets;
+
+	//Proxies of bodies that became static are all removed, regionStatics only covers those added as static.
+	if (physics->getControlMode() != PhysicsControlMode::STATIC) {
+		btVector3 aabbMin;
+		btVector3 aabbMax;
+		original->getCollisionShape()->getAabb(original->getWorldTransform(), aabbMin, aabbMax);
+
+		forEachWorld(aabbMin, aabbMax, [&](PhysicsWorld* world) {
+			if (world != componentWorlds[index] && world->overlaps(toGlmVec(aabbMin), toGlmVec(aabbMax), regionConfig.migrationMargin)) {
+				targets.push_back(world);
+			}
+		});
+	}
+
+	for (size_t i = 0; i < proxies.size();) {
+		auto targetLoc = std::find(targets.begin(), targets.end(), proxies[i].world);
+
+		if (targetLoc == targets.end()) {
+			proxies[i].world->unfollow(proxies[i].body.get());
+			proxies[i].world->getWorld()->removeRigidBody(proxies[i].body.get());
+			proxies[i] = std::move(proxies.back());
+			proxies.pop_back();
+			continue;
+		}
+
+		targets.erase(targetLoc);
+
+		proxies[i].world->follow(proxies[i].body.get(), original->getWorldTransform(), original->getLinearVelocity(), original->getAngularVelocity());
+		i++;
+	}
+
+	for (PhysicsWorld* world : targets) {
+		addBorderProxy(index, world);
+	}
+}
+
+void PhysicsManager::streamTerrain() {
+	std::vector<size_t> loads;
+	std::vector<size_t> unloads;
+
+	for (std::unique_ptr<PhysicsTerrain>& terrain : terrains) {
+		loads.clear();
+		unloads.clear();
+
+		terrain->findChanges(cameraPos, loads, unloads);
+
+		for (size_t chunk : unloads) {
+			removeTerrainChunk(terrain.get(), chunk);
+		}
+
+		for (size_t chunk : loads) {
+			addTerrainChunk(terrain.get(), chunk);
+		}
+	}
+}
+
+void PhysicsManager::addTerrainChunk(PhysicsTerrain* terrain, size_t index) {
+	terrain->loadChunk(index);
+
+	const PhysicsTerrain::Chunk& chunk = terrain->getChunk(index);
+	const uint32_t group = terrain->getInfo().collisionGroup;
+	const uint32_t mask = terrain->getInfo().collisionMask;
+
+	if (!regionsEnabled) {
+		addFilteredBody(terrain->createBody(index, mainWorld.get()), group, mask, mainWorld.get());
+		return;
+	}
+
+	//Every cell a body could be touching the chunk from needs a copy of it. This also creates
+	//the cells, so cells created later never overlap an already loaded chunk.
+	const float margin = regionConfig.migrationMargin;
+	const int32_t minX = cellCoord(chunk.min.x - margin, regionConfig.cellSize);
+	const int32_t maxX = cellCoord(chunk.max.x + margin, regionConfig.cellSize);
+	const int32_t minZ = cellCoord(chunk.min.z - margin, regionConfig.cellSize);
+	const int32_t maxZ = cellCoord(chunk.max.z + margin, regionConfig.cellSize);
+
+	for (int32_t x = minX; x <= maxX; x++) {
+		for (int32_t z = minZ; z <= maxZ; z++) {
+			PhysicsWorld* cell = getCell(glm::vec3(x + 0.5f, 0.0f, z + 0.5f) * regionConfig.cellSize);
+			addFilteredBody(terrain->createBody(index, cell), group, mask, cell);
+		}
+	}
+}
+
+void PhysicsManager::removeTerrainChunk(PhysicsTerrain* terrain, size_t index) {
+	for (auto& body : terrain->getChunk(index).bodies) {
+		body.first->getWorld()->removeRigidBody(body.second.get());
+	}
+
+	terrain->unloadChunk(index);
+}
+
+void PhysicsManager::updateLod() {
+	//Candidates for freezing and unfreezing, with their squared distance from the camera.
+	tbb::enumerable_thread_specific<std::vector<std::pair<float, size_t>>> threadFreezes;
+	tbb::enumerable_thread_specific<std::vector<std::pair<float, size_t>>> threadRestores;
+
+	const float freezeDistSq = lodConfig.freezeDistance * lodConfig.freezeDistance;
+	const float restoreDistSq = lodConfig.restoreDistance * lodConfig.restoreDistance;
+
+	Engine::parallelFor(0, physicsComponents.size(), [&](size_t i) {
+		PhysicsComponent* physics = physicsComponents[i];
+		const bool dynamic = physics->getControlMode() == PhysicsControlMode::DYNAMIC;
+
+		//Only check things that can change state, most bodies in a large world will be asleep or frozen.
+		if (!lodStates[i].frozen && !(dynamic && physics->getBody()->getBody()->isActive())) {
+			return;
+		}
+
+		btTransform transform;
+		physics->getBody()->getMotionState()->getWorldTransform(transform);
+
+		const glm::vec3 offset = toGlmVec(transform.getOrigin()) - cameraPos;
+		const float distSq = glm::dot(offset, offset);
+
+		if (lodStates[i].frozen) {
+			//Bodies that stopped being dynamic are always unfrozen, so they can be moved again.
+			if (distSq < restoreDistSq || !dynamic) {
+				threadRestores.local().push_back({dynamic ? distSq : 0.0f, i});
+			}
+		}
+		else if (distSq > freezeDistSq) {
+			threadFreezes.local().push_back({distSq, i});
+		}
+	}, UPDATE_GRAIN_SIZE);
+
+	std::vector<std::pair<float, size_t>> restores;
+	std::vector<std::pair<float, size_t>> freezes;
+
+	for (const std::vector<std::pair<float, size_t>>& list : threadRestores) {
+		restores.insert(restores.end(), list.begin(), list.end());
+	}
+
+	for (const std::vector<std::pair<float, size_t>>& list : threadFreezes) {
+		freezes.insert(freezes.end(), list.begin(), list.end());
+	}
+
+	//Unfreezing takes priority, as those bodies are close to the camera.
+	size_t budget = lodConfig.maxChangesPerTick;
+	const size_t restoreCount = std::min(budget, restores.size());
+	std::partial_sort(restores.begin(), restores.begin() + restoreCount, restores.end());
+
+	for (size_t i = 0; i < restoreCount; i++) {
+		restoreBody(restores.at(i).second);
+	}
+
+	budget -= restoreCount;
+
+	const size_t freezeCount = std::min(budget, freezes.size());
+	std::partial_sort(freezes.begin(), freezes.begin() + freezeCount, freezes.end(), std::greater<std::pair<float, size_t>>());
+
+	for (size_t i = 0; i < freezeCount; i++) {
+		freezeBody(freezes.at(i).second);
 	}
 }
 
-void PhysicsManager::tickCallback() {
-	int manifoldCount = world->getDispatcher()->getNumManifolds();
+void PhysicsManager::freezeBody(size_t index) {
+	btRigidBody* body = physicsComponents.at(index)->getBody()->getBody();
+	LodState& state = lodStates.at(index);
+
+	state.frozen = true;
+	state.linearVelocity = body->getLinearVelocity();
+	state.angularVelocity = body->getAngularVelocity();
+
+	body->setLinearVelocity(btVector3(0, 0, 0));
+	body->setAngularVelocity(btVector3(0, 0, 0));
+	body->forceActivationState(DISABLE_SIMULATION);
+}
+
+void PhysicsManager::restoreBody(size_t index) {
+	PhysicsComponent* physics = physicsComponents.at(index);
+	btRigidBody* body = physics->getBody()->getBody();
+	LodState& state = lodStates.at(index);
+
+	state.frozen = false;
+
+	//The control mode can change while frozen, and setting it can't override DISABLE_SIMULATION.
+	switch (physics->getControlMode()) {
+		case PhysicsControlMode::DYNAMIC: {
+			body->forceActivationState(ACTIVE_TAG);
+			body->setDeactivationTime(0);
+			//Frozen bodies start with no velocity, so anything they have now came
+			//from impulses applied while frozen, and is added to the saved velocity.
+			body->setLinearVelocity(state.linearVelocity + body->getLinearVelocity());
+			body->setAngularVelocity(state.angularVelocity + body->getAngularVelocity());
+		}; break;
+		case PhysicsControlMode::KINEMATIC: body->forceActivationState(DISABLE_DEACTIVATION); break;
+		case PhysicsControlMode::STATIC: body->forceActivationState(ACTIVE_TAG); break;
+		default: throw std::runtime_error("Somehow static, dynamic, and kinematic weren't enough!");
+	}
+}
+
+void PhysicsManager::migrateBodies() {
+	tbb::enumerable_thread_specific<std::vector<size_t>> threadMigrations;
+	tbb::enumerable_thread_specific<std::vector<size_t>> threadProxyUpdates;
+
+	//Sleeping bodies don't move, so only active ones need to be checked.
+	Engine::parallelFor(0, physicsComponents.size(), [&](size_t i) {
+		PhysicsComponent* physics = physicsComponents[i];
+
+		//Bodies with proxies are updated even when they aren't active, since falling asleep or
+		//freezing stops them, and bodies that became static need their proxies removed.
+		if (physics->needsUpdate() || !borderProxies[i].empty()) {
+			threadProxyUpdates.local().push_back(i);
+		}
+
+		if (!physics->needsUpdate()) {
+			return;
+		}
+
+		btTransform transform;
+		physics->getBody()->getMotionState()->getWorldTransform(transform);
+
+		if (!componentWorlds[i]->contains(toGlmVec(transform.getOrigin()), regionConfig.migrationMargin)) {
+			threadMigrations.local().push_back(i);
+		}
+	}, UPDATE_GRAIN_SIZE);
+
+	for (const std::vector<size_t>& migrations : threadMigrations) {
+		for (size_t i : migrations) {
+			PhysicsComponent* physics = physicsComponents[i];
 
-	Engine::instance->parallelFor(0, manifoldCount, [&](size_t i) {
-		btPersistentManifold* manifold = world->getDispatcher()->getManifoldByIndexInternal(i);
+			btTransform transform;
+			physics->getBody()->getMotionState()->getWorldTransform(transform);
 
-		PhysicsComponent* object1 = static_cast<PhysicsComponent*>(manifold->getBody0()->getUserPointer());
-		PhysicsComponent* object2 = static_cast<PhysicsComponent*>(manifold->getBody1()->getUserPointer());
+			PhysicsWorld* target = getCell(toGlmVec(transform.getOrigin()));
 
-		//Ghost objects don't have a user pointer
-		if (object1 != nullptr && object2 != nullptr) {
-			object1->onCollide(screen, object2);
-			object2->onCollide(screen, object1);
+			removeFromWorld(physics, componentWorlds[i]);
+			addToWorld(physics, target);
+			componentWorlds[i] = target;
 		}
+	}
+
+	//Adding and removing proxies changes the worlds, so this can't be done in parallel.
+	for (const std::vector<size_t>& proxyUpdates : threadProxyUpdates) {
+		for (size_t i : proxyUpdates) {
+			updateBorderProxies(i);
+		}
+	}
+}
+
+void PhysicsManager::generateCollisionEvents(const std::vector<ContactPair>& contacts) {
+	//Both lists are sorted, so they can be compared in a single pass
+	pendingEvents.clear();
+
+	auto current = contacts.begin();
+	auto last = lastContacts.begin();
+
+	while (current != contacts.end() || last != lastContacts.end()) {
+		if (last == lastContacts.end() || (current != contacts.end() && *current < *last)) {
+			addEvent(current->first, current->second, CollisionEventType::BEGIN);
+			addEvent(current->second, current->first, CollisionEventType::BEGIN);
+			current++;
+		}
+		else if (current == contacts.end() || *last < *current) {
+			addEvent(last->first, last->second, CollisionEventType::END);
+			addEvent(last->second, last->first, CollisionEventType::END);
+			last++;
+		}
+		else {
+			addEvent(current->first, current->second, CollisionEventType::PERSIST);
+			addEvent(current->second, current->first, CollisionEventType::PERSIST);
+			current++;
+			last++;
+		}
+	}
+
+	lastContacts.assign(contacts.begin(), contacts.end());
+
+	//Group events by receiver
+	std::sort(pendingEvents.begin(), pendingEvents.end(), [](const std::pair<PhysicsComponent*, CollisionEvent>& a, const std::pair<PhysicsComponent*, CollisionEvent>& b) {
+		return std::less<PhysicsComponent*>()(a.first, b.first);
 	});
+
+	eventList.clear();
+	eventGroups.clear();
+
+	for (const std::pair<PhysicsComponent*, CollisionEvent>& event : pendingEvents) {
+		if (eventGroups.empty() || eventGroups.back().first != event.first) {
+			eventGroups.push_back({event.first, eventList.size()});
+		}
+
+		eventList.push_back(event.second);
+	}
+}
+
+void PhysicsManager::flushTriggers() {
+	//Handlers can't add or remove objects directly, so the lists won't change while iterating.
+	for (PhysicsWorld* world : worlds) {
+		for (PhysicsGhostObject* ghost : world->getChangedTriggers()) {
+			ghost->flushChanges(screen);
+		}
+
+		world->getChangedTriggers().clear();
+	}
+}
+
+void PhysicsManager::dispatchCollisionEvents() {
+	auto dispatchGroup = [&](size_t group) {
+		const size_t start = eventGroups.at(group).second;
+		const size_t end = (group + 1 < eventGroups.size()) ? eventGroups.at(group + 1).second : eventList.size();
+
+		eventGroups.at(group).first->onCollide(screen, &eventList.at(start), end - start);
+	};
+
+	if (parallelDispatch) {
+		Engine::parallelFor(0, eventGroups.size(), dispatchGroup);
+	}
+	else {
+		for (size_t i = 0; i < eventGroups.size(); i++) {
+			dispatchGroup(i);
+		}
+	}
 }
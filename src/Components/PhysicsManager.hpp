@@ -18,20 +18,93 @@
 
 #pragma once
 
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <array>
+#include <string>
+
+#include <tbb/task_group.h>
+#include <tbb/concurrent_queue.h>
+
 #include "btBulletDynamicsCommon.h"
-#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
-#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
-#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
 #include "ComponentManager.hpp"
 #include "PhysicsComponent.hpp"
+#include "PhysicsWorld.hpp"
+#include "PhysicsTerrain.hpp"
+#include "TripleBuffer.hpp"
 
 struct RaytraceResult {
-	//The physics component of the object that was hit, nullptr if nothing was hit.
+	//The physics component of the object that was hit, nullptr if nothing
+	//was hit or if the hit was on terrain.
 	PhysicsComponent* hitComp;
 	//The world position of the hit.
 	glm::vec3 hitPos;
 	//The normal of the face that was hit.
 	glm::vec3 hitNormal;
+	//Whether anything was hit, including terrain.
+	bool hit;
+};
+
+//A ray for batched raytracing.
+struct Ray {
+	//Where the ray starts.
+	glm::vec3 start;
+	//Where the ray ends.
+	glm::vec3 end;
+	//Collision groups the ray can hit, 0 to hit everything.
+	uint32_t mask = 0;
+};
+
+//A convex shape swept through the world for batched sweep tests.
+struct SweepQuery {
+	//The shape to sweep. Must not be modified while the query is running.
+	const btConvexShape* shape;
+	//The position of the shape at the start of the sweep.
+	glm::vec3 start;
+	//The position of the shape at the end of the sweep.
+	glm::vec3 end;
+	//The rotation of the shape, which stays the same for the entire sweep.
+	glm::quat rotation;
+	//Collision groups the shape can hit, 0 to hit everything.
+	uint32_t mask = 0;
+};
+
+//The state of a body at the end of a step, for reading while the next step runs.
+struct BodySnapshot {
+	btTransform transform;
+	btVector3 linearVelocity;
+};
+
+//Settings for splitting the world into regions.
+struct PhysicsRegionConfig {
+	//The size of each grid cell on the x and z axes.
+	float cellSize;
+	//How far a body can go outside its cell before being moved to the cell it's in.
+	//Bodies within this distance of another cell get a copy in that cell, which moves along
+	//with the original during each step, so bodies in different cells can collide. Each side only
+	//pushes the other's copy around, so this should be at least as large as most dynamic objects.
+	float migrationMargin;
+	//Cells with a center within this distance of the camera are stepped every tick.
+	float fullRateDistance;
+	//Cells further away than fullRateDistance are only stepped once every this many ticks.
+	uint32_t farStepInterval;
+};
+
+//Settings for freezing bodies far away from the camera.
+struct PhysicsLodConfig {
+	//Dynamic bodies further than this from the camera are frozen in place.
+	float freezeDistance;
+	//Frozen bodies closer than this to the camera are unfrozen. Should be less than
+	//freezeDistance, so bodies near the edge don't keep switching back and forth.
+	float restoreDistance;
+	//The maximum number of bodies frozen or unfrozen per tick. Bodies closer to the
+	//camera are unfrozen first, and bodies further away are frozen first.
+	size_t maxChangesPerTick;
 };
 
 class PhysicsManager : public ComponentManager {
@@ -49,25 +122,41 @@ public:
 	 * Sets the gravity for the world.
 	 * @param x, y, z The force vector to be applied.
 	 */
-	void setGravity(float x, float y, float z) { world->setGravity(btVector3(x, y, z)); }
+	void setGravity(float x, float y, float z);
+
+	/**
+	 * Splits the world into a grid of cells on the x and z axes, each with its own bullet
+	 * world. Cells are created as objects move into them, and are stepped in parallel,
+	 * with cells far from the camera being stepped less often. Dynamic objects move between
+	 * cells as they go outside their current one, while static objects are added to every cell
+	 * they overlap. This helps with large worlds where most objects are far apart, but objects
+	 * in different cells only interact near the borders, see PhysicsRegionConfig. Static
+	 * objects are only placed in cells when added, so they shouldn't be moved or made dynamic.
+	 * Must be called before any components are added.
+	 * @param config The region settings.
+	 * @throw std::runtime_error if components have already been added.
+	 */
+	void enableRegions(const PhysicsRegionConfig& config);
 
 	/**
 	 * Raytraces through the world and returns the first physics object in the path.
 	 * Note that if the ray starts inside an object, that object will be missed.
 	 * @param start Where the raytrace starts.
 	 * @param end Where the raytrace ends.
+	 * @param mask Collision groups the ray can hit, 0 to hit everything.
 	 * @return The first hit, or blank if nothing were hit.
 	 */
-	RaytraceResult raytraceSingle(glm::vec3 start, glm::vec3 end);
+	RaytraceResult raytraceSingle(glm::vec3 start, glm::vec3 end, uint32_t mask = 0);
 
 	/**
 	 * Raytraces through the world and returns all physics object in the path.
 	 * Also see the note on raytraceSingle above.
 	 * @param start Where the raytrace starts.
 	 * @param end Where the raytrace ends.
+	 * @param mask Collision groups the ray can hit, 0 to hit everything.
 	 * @return A list of objects found on the path, with hit information for each.
 	 */
-	std::vector<RaytraceResult> raytraceAll(glm::vec3 start, glm::vec3 end);
+	std::vector<RaytraceResult> raytraceAll(glm::vec3 start, glm::vec3 end, uint32_t mask = 0);
 
 	/**
 	 * Raytraces from the mouse position projected into 3d space using the
@@ -76,6 +165,28 @@ public:
 	 */
 	RaytraceResult raytraceUnderMouse();
 
+	/**
+	 * Raytraces a batch of rays, splitting them across worker threads. Each result is
+	 * the same as what raytraceSingle would return for the corresponding ray, but
+	 * nothing is drawn to the debug renderer. This only reads from the world, so it
+	 * must not be called while the world is being stepped, such as from a collision
+	 * handler, but is fine to call from component updates.
+	 * @param rays The rays to trace.
+	 * @param count The number of rays.
+	 * @param results Where to write the results, must have room for count results.
+	 */
+	void raytraceBatch(const Ray* rays, size_t count, RaytraceResult* results) const;
+
+	/**
+	 * Sweeps a batch of convex shapes through the world, splitting them across worker
+	 * threads, and finds the first object each one hits. Has the same restrictions as
+	 * raytraceBatch above. Objects the shape overlaps at its starting position are missed.
+	 * @param queries The shapes to sweep.
+	 * @param count The number of queries.
+	 * @param results Where to write the results, must have room for count results.
+	 */
+	void sweepBatch(const SweepQuery* queries, size_t count, RaytraceResult* results) const;
+
 	/**
 	 * If using a physics debug renderer, draws a line of the given color at the
 	 * specified positions. Does nothing if debug drawing is disabled.
@@ -86,25 +197,240 @@ public:
 	void drawDebugLine(glm::vec3 from, glm::vec3 to, glm::vec3 color);
 
 	/**
-	 * Returns the physics world, for use in things like debug drawing.
-	 * @return The physics world.
+	 * Adds heightfield terrain made from a render mesh. The terrain is split into chunks, which are
+	 * added to the world when the camera gets close to them and removed once it moves away. The
+	 * chunks read their heights from the mesh itself, so the mesh must not be modified while the
+	 * terrain exists. Terrain doesn't have a physics component, so it doesn't receive collision
+	 * events, and raytraces that hit it have a null hitComp.
+	 * @param info The terrain settings.
+	 * @return The terrain, which is owned by the manager.
+	 * @throw std::runtime_error if the mesh isn't a valid grid.
 	 */
-	btCollisionWorld* getWorld() const { return world; }
+	PhysicsTerrain* addTerrain(const PhysicsTerrainInfo& info);
+
+	/**
+	 * Removes terrain added with addTerrain.
+	 * @param terrain The terrain to remove, which is deleted.
+	 */
+	void removeTerrain(PhysicsTerrain* terrain);
+
+	/**
+	 * Creates a new named collision layer, which collides with every other layer until changed
+	 * with setLayersCollide. Bullet's standard filter groups are already registered as "default",
+	 * "static", "kinematic", "debris", "sensor", and "character", which leaves room for 26 more.
+	 * @param name The name of the layer.
+	 * @return The group bit for the layer, for use in PhysicsInfo and raytrace masks.
+	 * @throw std::runtime_error if the layer already exists or there are no layers left.
+	 */
+	uint32_t addCollisionLayer(const std::string& name);
+
+	/**
+	 * Gets the group bit for a named collision layer.
+	 * @param name The name of the layer.
+	 * @return The layer's group bit.
+	 * @throw std::runtime_error if the layer doesn't exist.
+	 */
+	uint32_t getCollisionLayer(const std::string& name) const;
+
+	/**
+	 * Sets whether objects in two layers collide with each other. Objects and ghosts
+	 * created without a collision mask get theirs from this when they're added to the
+	 * manager, so this should be set up before adding anything.
+	 * @param first The first layer.
+	 * @param second The second layer, can be the same as the first.
+	 * @param collide Whether the layers should collide.
+	 * @throw std::runtime_error if either layer doesn't exist.
+	 */
+	void setLayersCollide(const std::string& first, const std::string& second, bool collide);
+
+	/**
+	 * Gets the collision mask for objects in the given groups, from the layer matrix.
+	 * @param group The group bits.
+	 * @return Every group that collides with at least one of the given groups.
+	 */
+	uint32_t getLayerMask(uint32_t group) const;
 
-private:
 	/**
-	 * Only called from bullet.
+	 * Enables freezing of dynamic bodies far away from the camera. Frozen bodies keep their
+	 * transform and stop being simulated, but can still be hit by other objects, raytraces,
+	 * and ghosts. When they get close enough again, they continue with the velocity they had
+	 * when frozen, plus any impulses applied while frozen. Forces and torques applied while
+	 * frozen are dropped, as the body isn't simulated to integrate them. Frozen bodies also
+	 * aren't updated, so their objects stay where they are. Can be called again to change the settings.
+	 * @param config The freezing settings.
+	 * @throw std::runtime_error if restoreDistance is greater than freezeDistance.
 	 */
-	static void physicsTickCallback(btDynamicsWorld* world, btScalar timeStep);
+	void enableLod(const PhysicsLodConfig& config);
 
-	//Misc. bullet junk.
-	btDiscreteDynamicsWorldMt* world;
-	btDefaultCollisionConfiguration* conf;
-	btCollisionDispatcherMt* dispatcher;
-	btBroadphaseInterface* broadphase;
-	btSequentialImpulseConstraintSolverMt* solver;
-	btConstraintSolverPoolMt* solverPool;
-	btGhostPairCallback* ghostCallback;
+	/**
+	 * Disables freezing of far away bodies, and immediately unfreezes all frozen bodies.
+	 */
+	void disableLod();
+
+	/**
+	 * Returns all the bullet worlds, for use in things like debug drawing. This is
+	 * a single world, unless the manager is split into regions. Waits for any running
+	 * step first, but the worlds are only safe to use until the next update starts another.
+	 * @return The physics worlds.
+	 */
+	std::vector<btCollisionWorld*> getWorlds() const;
+
+	/**
+	 * Sets whether collision handlers for different objects are run in parallel.
+	 * Each handler still only receives its own events, so handlers that only
+	 * modify their parent object don't need any locking either way. Defaults to off.
+	 * @param enable Whether to dispatch collision events in parallel.
+	 */
+	void setParallelCollisionDispatch(bool enable) { parallelDispatch = enable; }
+
+	/**
+	 * Sets whether the world is stepped asynchronously. When enabled, each update starts a
+	 * step in the background and returns immediately, so the step overlaps with the other
+	 * managers and rendering. The results are picked up at the start of the next update, so
+	 * objects lag one tick behind. While a step is running, physics components report the
+	 * state from the end of the last step, and changes to bodies are queued until the step
+	 * finishes. Raytraces and ghost queries wait for the running step. When switching,
+	 * collision and trigger events from the last background step are delivered before
+	 * returning. Defaults to off.
+	 * @param enable Whether to step asynchronously.
+	 */
+	void setAsyncStepping(bool enable);
+
+	/**
+	 * Returns whether a step is currently running in the background.
+	 * @return Whether the world is being stepped.
+	 */
+	bool isStepping() const { return stepping; }
+
+	/**
+	 * Waits for the background step to finish, if one is running. After this, the world can
+	 * be accessed directly until the next update.
+	 */
+	void waitForStep() const;
+
+	/**
+	 * Runs a function that modifies the world or a body in it. If a step is running, the function
+	 * is queued and run once the step finishes, otherwise it is run immediately.
+	 * @param command The function to run.
+	 */
+	void runCommand(std::function<void()>&& command);
+
+	/**
+	 * Gets the state of the body of the component at the given index at the end of the
+	 * last step. Only for PhysicsComponent.
+	 * @param index The component's index, from PhysicsComponent::getManagerIndex.
+	 * @return The snapshot, or nullptr if the world should be read directly instead.
+	 */
+	const BodySnapshot* getBodySnapshot(size_t index) const {
+		if (!asyncStepping || snapshotStale) {
+			return nullptr;
+		}
+
+		return &snapshots.getReadBuffer().bodies.at(index);
+	}
+
+private:
+	typedef PhysicsContactPair ContactPair;
+
+	//Results of a single step, published by the stepping task.
+	struct StepSnapshot {
+		//Body states, by component index.
+		std::vector<BodySnapshot> bodies;
+		//Sorted, deduplicated contacts found during the step.
+		std::vector<ContactPair> contacts;
+		//Number of substeps run, if zero the contacts weren't updated.
+		size_t substeps;
+	};
+
+	//A copy of a body placed in a cell other than the one holding the original.
+	//Copies of static bodies are static, copies of anything else are kinematic.
+	struct BodyProxy {
+		PhysicsWorld* world;
+		std::unique_ptr<btRigidBody> body;
+	};
+
+	//The world used when not split into regions.
+	std::unique_ptr<PhysicsWorld> mainWorld;
+	//Region cells, by packed cell coordinate.
+	std::unordered_map<uint64_t, std::unique_ptr<PhysicsWorld>> cells;
+	//Every world being stepped, either just the main world or all of the cells.
+	std::vector<PhysicsWorld*> worlds;
+	//Whether the world is split into regions.
+	bool regionsEnabled;
+	//Settings for the regions, if enabled.
+	PhysicsRegionConfig regionConfig;
+	//Gravity for all worlds, kept for creating new cells.
+	btVector3 gravity;
+	//Camera position for the current tick, used for regions and freezing.
+	glm::vec3 cameraPos;
+
+	//Saved state of a frozen body.
+	struct LodState {
+		//Whether the body is frozen.
+		bool frozen;
+		//Velocity of the body when it was frozen.
+		btVector3 linearVelocity;
+		btVector3 angularVelocity;
+	};
+
+	//Names of the collision layers, mapped to their bit index.
+	std::unordered_map<std::string, uint32_t> layerBits;
+	//The layers each layer collides with, by bit index.
+	std::array<uint32_t, 32> layerMasks;
+
+	//All terrain in the world.
+	std::vector<std::unique_ptr<PhysicsTerrain>> terrains;
+
+	//Whether far away bodies are frozen.
+	bool lodEnabled;
+	//Settings for freezing bodies.
+	PhysicsLodConfig lodConfig;
+	//Freezing state for each component, by component index.
+	std::vector<LodState> lodStates;
+
+	//Densely packed copy of the component set, so updates can be split
+	//across threads without chasing hash set nodes.
+	std::vector<PhysicsComponent*> physicsComponents;
+	//The world each component's body is in, by component index.
+	std::vector<PhysicsWorld*> componentWorlds;
+	//Static components in region mode, for placing in newly created cells.
+	std::vector<PhysicsComponent*> regionStatics;
+	//Proxies for each static component in region mode.
+	std::unordered_map<PhysicsComponent*, std::vector<BodyProxy>> staticProxies;
+	//Proxies for each non-static component near a cell border, by component index.
+	std::vector<std::vector<BodyProxy>> borderProxies;
+
+	//Sorted, deduplicated contacts from the previous tick.
+	std::vector<ContactPair> lastContacts;
+	//Sorted, deduplicated contacts from the current tick.
+	std::vector<ContactPair> currentContacts;
+	//Collision events for the current tick, paired with the component receiving them.
+	std::vector<std::pair<PhysicsComponent*, CollisionEvent>> pendingEvents;
+	//Events from pendingEvents, grouped by receiving component.
+	std::vector<CollisionEvent> eventList;
+	//The receiver of each group of events in eventList, with the index of the group's first event.
+	std::vector<std::pair<PhysicsComponent*, size_t>> eventGroups;
+	//Number of simulation substeps run during the current tick.
+	size_t substeps;
+	//Whether to run collision handlers in parallel.
+	bool parallelDispatch;
+
+	//Whether asynchronous stepping is enabled.
+	bool asyncStepping;
+	//Whether a step is currently running in the background.
+	mutable std::atomic<bool> stepping;
+	//Runs the background step.
+	mutable tbb::task_group stepTask;
+	//Makes sure only one thread waits on stepTask.
+	mutable std::mutex stepLock;
+	//Results from the background step.
+	TripleBuffer<StepSnapshot> snapshots;
+	//Set when the acquired snapshot has contacts that haven't been turned into events yet.
+	bool resultsPending;
+	//Set when components are added or removed, which invalidates the indices in the current snapshot.
+	bool snapshotStale;
+	//Commands issued while the world was being stepped.
+	tbb::concurrent_queue<std::function<void()>> commandQueue;
 
 	/**
 	 * Overridden from ComponentManager.
@@ -117,7 +443,182 @@ private:
 	void onComponentRemove(std::shared_ptr<Component> comp) override;
 
 	/**
-	 * Called from bullet, used for collision callbacks in physics objects.
+	 * Steps all worlds, without processing any of the results.
+	 */
+	void stepWorld();
+
+	/**
+	 * Merges the contacts from every world into a single list.
+	 * @param contacts Where to store the sorted, deduplicated contacts.
+	 */
+	void mergeContacts(std::vector<ContactPair>& contacts);
+
+	/**
+	 * Gets the cell containing the given position, creating it if it doesn't exist yet.
+	 * @param pos The position to get the cell for.
+	 * @return The cell's world.
+	 */
+	PhysicsWorld* getCell(const glm::vec3& pos);
+
+	/**
+	 * Adds a component's body and ghosts to a world.
+	 * @param physics The component to add.
+	 * @param target The world to add it to.
+	 */
+	void addToWorld(PhysicsComponent* physics, PhysicsWorld* target);
+
+	/**
+	 * Removes a component's body and ghosts from a world.
+	 * @param physics The component to remove.
+	 * @param source The world it's currently in.
+	 */
+	void removeFromWorld(PhysicsComponent* physics, PhysicsWorld* source);
+
+	/**
+	 * Adds a proxy for a static component to a cell.
+	 * @param physics The static component.
+	 * @param cell The cell to add the proxy to.
+	 */
+	void addStaticProxy(PhysicsComponent* physics, PhysicsWorld* cell);
+
+	/**
+	 * Adds a kinematic proxy for a non-static component to a cell.
+	 * @param index The index of the component.
+	 * @param cell The cell to add the proxy to.
+	 */
+	void addBorderProxy(size_t index, PhysicsWorld* cell);
+
+	/**
+	 * Adds and removes a non-static component's proxies so there's one in every cell other than
+	 * its own that it's within the migration margin of, and moves the rest to match the original.
+	 * @param index The index of the component.
+	 */
+	void updateBorderProxies(size_t index);
+
+	/**
+	 * Adds and removes terrain chunks based on their distance from the camera.
+	 */
+	void streamTerrain();
+
+	/**
+	 * Adds a terrain chunk to every world it overlaps.
+	 * @param terrain The terrain the chunk is part of.
+	 * @param index The chunk's index.
+	 */
+	void addTerrainChunk(PhysicsTerrain* terrain, size_t index);
+
+	/**
+	 * Removes a terrain chunk from all worlds it's in.
+	 * @param terrain The terrain the chunk is part of.
+	 * @param index The chunk's index.
+	 */
+	void removeTerrainChunk(PhysicsTerrain* terrain, size_t index);
+
+	/**
+	 * Freezes and unfreezes bodies based on their distance from the camera, within the per-tick budget.
+	 */
+	void updateLod();
+
+	/**
+	 * Freezes a body in place, saving its velocity.
+	 * @param index The index of the body's component.
+	 */
+	void freezeBody(size_t index);
+
+	/**
+	 * Unfreezes a frozen body, restoring its velocity along with anything applied while it was frozen.
+	 * @param index The index of the body's component.
+	 */
+	void restoreBody(size_t index);
+
+	/**
+	 * Moves any dynamic bodies that went too far outside their cell to the cell they're in,
+	 * then updates the proxies of bodies near cell borders. Moving a body re-adds it to the
+	 * new cell, which drops its contact manifolds, so its contacts lose warm starting for a
+	 * step. They're found again in the same step, so collision events aren't interrupted.
+	 */
+	void migrateBodies();
+
+	/**
+	 * Runs a function on every world whose bounds overlap the given box.
+	 * @param min The minimum corner of the box.
+	 * @param max The maximum corner of the box.
+	 * @param func The function to run.
+	 */
+	void forEachWorld(const btVector3& min, const btVector3& max, const std::function<void(PhysicsWorld*)>& func) const;
+
+	/**
+	 * Adds a rigid body to a world with its collision filter.
+	 * @param body The body to add.
+	 * @param object The object with the body's filter settings.
+	 * @param world The world to add the body to.
+	 */
+	void addFilteredBody(btRigidBody* body, const PhysicsObject* object, PhysicsWorld* world) const {
+		addFilteredBody(body, object->getCollisionGroup(), object->getCollisionMask(), world);
+	}
+
+	/**
+	 * Adds a rigid body to a world with the given collision filter.
+	 * @param body The body to add.
+	 * @param group The body's collision group, 0 for the default.
+	 * @param mask The body's collision mask, 0 to use the layer matrix.
+	 * @param world The world to add the body to.
+	 */
+	void addFilteredBody(btRigidBody* body, uint32_t group, uint32_t mask, PhysicsWorld* world) const;
+
+	/**
+	 * Finds the closest object hit by a ray in any world.
+	 * @param from The start of the ray.
+	 * @param to The end of the ray.
+	 * @param mask Collision groups the ray can hit, 0 to hit everything.
+	 * @return The closest hit, or blank if nothing was hit.
+	 */
+	RaytraceResult closestRayHit(const btVector3& from, const btVector3& to, uint32_t mask) const;
+
+	/**
+	 * Gets the debug drawer, if debug drawing is enabled.
+	 * @return The debug drawer, or nullptr.
+	 */
+	btIDebugDraw* getDebugDrawer() const { return worlds.empty() ? nullptr : worlds.front()->getWorld()->getDebugDrawer(); }
+
+	/**
+	 * Compares the contacts from this tick to those from the previous tick to
+	 * generate the collision events for each object.
+	 * @param contacts The sorted contacts from this tick.
+	 */
+	void generateCollisionEvents(const std::vector<ContactPair>& contacts);
+
+	/**
+	 * Copies the state of every body into the snapshot.
+	 * @param snapshot The snapshot to write to.
+	 */
+	void captureBodies(StepSnapshot& snapshot);
+
+	/**
+	 * Picks up the results of the last background step, if there are any.
+	 */
+	void acquireStepResults();
+
+	/**
+	 * Passes all generated collision events to their objects' collision handlers.
+	 */
+	void dispatchCollisionEvents();
+
+	/**
+	 * Updates the overlaps of all ghosts that changed, and sends out their enter / exit events.
+	 */
+	void flushTriggers();
+
+	/**
+	 * Adds an event for the given receiver to the pending event list, if it
+	 * will actually do something with it.
+	 * @param receiver The component receiving the event.
+	 * @param other The other component involved in the collision.
+	 * @param type The type of the event.
 	 */
-	void tickCallback();
+	void addEvent(PhysicsComponent* receiver, PhysicsComponent* other, CollisionEventType type) {
+		if (receiver->hasCollisionHandler()) {
+			pendingEvents.push_back({receiver, CollisionEvent{type, other}});
+		}
+	}
 };
@@ -18,24 +18,20 @@
 
 #include <memory>
 
+#include "BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h"
+
 #include "PhysicsObject.hpp"
 #include "Models/Mesh.hpp"
 #include "Engine.hpp"
 
 PhysicsObject::PhysicsObject(const PhysicsInfo& createInfo) :
 	body(nullptr),
-	shape(nullptr),
 	state(nullptr),
-	mesh(nullptr),
-	startingMass(createInfo.mass) {
-
-	switch (createInfo.shape) {
-		case PhysicsShape::PLANE: shape = createPlaneObject(createInfo); break;
-		case PhysicsShape::BOX: shape = createBoxObject(createInfo); break;
-		case PhysicsShape::CAPSULE: shape = createCapsuleObject(createInfo); break;
-		case PhysicsShape::SPHERE: shape = createSphereObject(createInfo); break;
-		default: throw std::runtime_error("Missing physics shape!");
-	}
+	startingMass(createInfo.mass),
+	collisionGroup(createInfo.collisionGroup),
+	collisionMask(createInfo.collisionMask) {
+
+	shape = Engine::instance->getPhysicsShapeCache().getShape(createInfo.shape, createInfo.box);
 
 	state = new btDefaultMotionState();
 
@@ -52,7 +48,7 @@ PhysicsObject::PhysicsObject(const PhysicsInfo& createInfo) :
 	initialTransform.setOrigin(btVector3(origin.x, origin.y, origin.z));
 	state->setWorldTransform(initialTransform);
 
-	btRigidBody::btRigidBodyConstructionInfo info(createInfo.mass, state, shape, localInertia);
+	btRigidBody::btRigidBodyConstructionInfo info(createInfo.mass, state, shape.get(), localInertia);
 	info.m_friction = createInfo.friction;
 
 	body = new btRigidBody(info);
@@ -62,43 +58,23 @@ PhysicsObject::PhysicsObject(const PhysicsInfo& createInfo) :
 	}
 }
 
-PhysicsObject::PhysicsObject(const std::string& meshName, const glm::vec3& pos) :
+PhysicsObject::PhysicsObject(const std::string& meshName, const glm::vec3& pos, const glm::vec3& scale) :
 	body(nullptr),
-	shape(nullptr),
 	state(nullptr),
-	mesh(nullptr),
-	startingMass(0) {
+	startingMass(0),
+	collisionGroup(0),
+	collisionMask(0) {
 
-	std::shared_ptr<const MeshRef> meshRef = Engine::instance->getModelManager().getMesh(meshName, CacheLevel::MEMORY);
-	const VertexFormat* format = meshRef->getMesh()->getFormat();
+	meshShape = Engine::instance->getPhysicsShapeCache().getMeshShape(meshName);
 
-	if (!format->hasElement(VERTEX_ELEMENT_POSITION)) {
-		throw std::runtime_error("Attempt to generate physics shape from mesh without positions!");
+	if (scale == glm::vec3(1.0, 1.0, 1.0)) {
+		shape = meshShape;
 	}
-
-	const size_t vertexSize = format->getVertexSize();
-	const size_t posOffset = format->getElementOffset(VERTEX_ELEMENT_POSITION);
-
-	const auto meshData = meshRef->getMesh()->getMeshData();
-	mesh = new btTriangleMesh();
-
-	//Create physics mesh
-	for (size_t i = posOffset; i < std::get<1>(meshData); i += vertexSize) {
-		glm::vec3 vertPos = *(glm::vec3*)(std::get<0>(meshData) + i);
-		mesh->findOrAddVertex(btVector3(vertPos.x, vertPos.y, vertPos.z), false);
+	else {
+		//Scaled shapes only hold a pointer to the mesh shape, so they're cheap to make per object.
+		shape.reset(new btScaledBvhTriangleMeshShape(meshShape.get(), btVector3(scale.x, scale.y, scale.z)));
 	}
 
-	const std::vector<uint32_t>& indexData = std::get<2>(meshData);
-
-	//Add indices
-	for (size_t i = 0; i < indexData.size(); i += 3) {
-		mesh->addTriangleIndices(indexData.at(i), indexData.at(i + 1), indexData.at(i + 2));
-	}
-
-	//Second parameter is "useQuantizedAabbCompression" - not sure what that does, but
-	//it sounds good
-	shape = new btBvhTriangleMeshShape(mesh, true);
-
 	state = new btDefaultMotionState();
 
 	btTransform initialTransform;
@@ -106,22 +82,7 @@ PhysicsObject::PhysicsObject(const std::string& meshName, const glm::vec3& pos)
 	initialTransform.setOrigin(btVector3(pos.x, pos.y, pos.z));
 	state->setWorldTransform(initialTransform);
 
-	btRigidBody::btRigidBodyConstructionInfo info(0.0, state, shape);
+	btRigidBody::btRigidBodyConstructionInfo info(0.0, state, shape.get());
 
 	body = new btRigidBody(info);
 }
-
-btStaticPlaneShape* PhysicsObject::createPlaneObject(const PhysicsInfo& createInfo) {
-	glm::vec3 normal(createInfo.box.max - createInfo.box.min);
-	glm::normalize(normal);
-
-	//Point on the plane
-	glm::vec3 point = createInfo.box.min;
-
-	//'d' from the plane equation: ax + by + cz + d = 0. Normally distance uses
-	//absolute value and divides by length, but here that is fortunately not
-	//necessary.
-	float offset = glm::dot(normal, point);
-
-	return new btStaticPlaneShape(btVector3(normal.x, normal.y, normal.z), offset);
-}
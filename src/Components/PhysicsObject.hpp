@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include "btBulletDynamicsCommon.h"
 
 #include "AxisAlignedBB.hpp"
@@ -33,7 +35,10 @@ enum class PhysicsShape {
 	//A cylinder with half-spheres at the ends
 	CAPSULE,
 	//A sphere
-	SPHERE
+	SPHERE,
+	//A grid of heights read from a render mesh. These can't be used in PhysicsInfo,
+	//terrain is created with PhysicsManager::addTerrain instead.
+	HEIGHTFIELD
 };
 
 //TODO: expose all of btRigidBodyConstructionInfo.
@@ -52,6 +57,11 @@ struct PhysicsInfo {
 	float friction;
 	//Disables rotation of the created object, suitable for character controllers.
 	bool disableRotation;
+	//Collision group bits for the object, usually from PhysicsManager::getCollisionLayer.
+	//0 puts the object in the "default" layer, or "static" if it has no mass.
+	uint32_t collisionGroup = 0;
+	//Groups the object collides with. 0 uses the manager's layer matrix for the object's group.
+	uint32_t collisionMask = 0;
 };
 
 //A wrapper for bullet physics objects for easier deletion.
@@ -66,23 +76,20 @@ public:
 
 	/**
 	 * Creates a static concave triangle bvh from the given mesh, offset
-	 * by the given position.
+	 * by the given position. The bvh is shared with all other objects
+	 * using the same mesh.
 	 * @param modelName The name of the model to generate the object from.
 	 * @param pos The offset for the object.
+	 * @param scale The scale of the object.
 	 */
-	PhysicsObject(const std::string& modelName, const glm::vec3& pos = glm::vec3(0.0, 0.0, 0.0));
+	PhysicsObject(const std::string& modelName, const glm::vec3& pos = glm::vec3(0.0, 0.0, 0.0), const glm::vec3& scale = glm::vec3(1.0, 1.0, 1.0));
 
 	/**
 	 * Deletes the objects.
 	 */
 	~PhysicsObject() {
 		delete body;
-		delete shape;
 		delete state;
-
-		if (mesh != nullptr) {
-			delete mesh;
-		}
 	}
 
 	/**
@@ -103,52 +110,28 @@ public:
 	 */
 	 float getInitialMass() const { return startingMass; }
 
-private:
-	btRigidBody* body;
-	btCollisionShape* shape;
-	btMotionState* state;
-	//Only used for static mesh objects.
-	btTriangleMesh* mesh;
-	//Stored for switching between kinematic/dynamic/static.
-	float startingMass;
-
-	/**
-	 * Creates a plane collision object from the creation info.
-	 * @param createInfo The creation info for the physics object.
-	 * @return A plane shape.
-	 */
-	btStaticPlaneShape* createPlaneObject(const PhysicsInfo& createInfo);
-
-	/**
-	 * Creates a box collision object.
-	 * @param createInfo The creation info for the physics object.
-	 * @return The new box shape.
-	 */
-	btBoxShape* createBoxObject(const PhysicsInfo& createInfo) {
-		Aabb<float> box = createInfo.box;
-
-		return new btBoxShape(btVector3(box.xLength() / 2.0f, box.yLength() / 2.0f, box.zLength() / 2.0f));
-	}
-
 	/**
-	 * Creates a capsule. The ends are always at the top and bottom for now.
-	 * @param createInfo The physics object creation info.
-	 * @return A new capsule shape.
+	 * Gets the collision group the object was created with.
+	 * @return The group bits, 0 for the default.
 	 */
-	btCapsuleShape* createCapsuleObject(const PhysicsInfo& createInfo) {
-		Aabb<float> box = createInfo.box;
-
-		return new btCapsuleShape(box.xLength() / 2.0f, box.yLength());
-	}
+	uint32_t getCollisionGroup() const { return collisionGroup; }
 
 	/**
-	 * Creates a sphere. This assumes that the bounding box is a cube.
-	 * @param createInfo The physics object creation info.
-	 * @return A new sphere shape.
+	 * Gets the collision mask the object was created with.
+	 * @return The mask bits, 0 to use the layer matrix.
 	 */
-	btSphereShape* createSphereObject(const PhysicsInfo& createInfo) {
-		Aabb<float> box = createInfo.box;
+	uint32_t getCollisionMask() const { return collisionMask; }
 
-		return new btSphereShape(box.xLength() / 2.0f);
-	}
+private:
+	btRigidBody* body;
+	//Shared with other objects through the shape cache, unless this is a scaled mesh.
+	std::shared_ptr<btCollisionShape> shape;
+	btMotionState* state;
+	//Only used for static mesh objects, keeps the shared mesh alive for scaled shapes.
+	std::shared_ptr<btBvhTriangleMeshShape> meshShape;
+	//Stored for switching between kinematic/dynamic/static.
+	float startingMass;
+	//Collision filtering, applied when added to the world.
+	uint32_t collisionGroup;
+	uint32_t collisionMask;
 };
@@ -0,0 +1,330 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include <stdexcept>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+
+#include "PhysicsShapeCache.hpp"
+#include "Models/Mesh.hpp"
+#include "Engine.hpp"
+
+namespace {
+	//Identifies bvh cache files, "SBVH".
+	constexpr uint32_t BVH_CACHE_MAGIC = 0x48564253;
+	//Increment whenever the cache file format changes.
+	constexpr uint32_t BVH_CACHE_VERSION = 1;
+
+	struct BvhCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		//Bullet can use either floats or doubles, which changes the bvh's layout.
+		uint32_t scalarSize;
+		//Size of the serialized bvh following the header.
+		uint32_t bvhSize;
+		//Hash of the mesh the bvh was built from, to detect collisions in the file name.
+		uint64_t meshHash;
+	};
+
+	/**
+	 * Continues a 64-bit FNV-1a hash with the given data.
+	 * @param hash The hash so far.
+	 * @param data The data to add to the hash.
+	 * @param size The size of the data, in bytes.
+	 * @return The new hash.
+	 */
+	uint64_t fnvHash(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3;
+		}
+
+		return hash;
+	}
+
+	//A triangle mesh shape that owns its mesh, and possibly the buffer its bvh was loaded into.
+	class CachedMeshShape : public btBvhTriangleMeshShape {
+	public:
+		/**
+		 * Creates the shape.
+		 * @param mesh The triangle mesh, now owned by the shape.
+		 * @param bvh A bvh loaded from the cache for the mesh, or nullptr to build a new one.
+		 * @param bvhBuffer The buffer bvh was deserialized into, allocated with btAlignedAlloc.
+		 *     Owned by the shape.
+		 */
+		CachedMeshShape(btTriangleMesh* mesh, btOptimizedBvh* bvh, void* bvhBuffer) :
+			btBvhTriangleMeshShape(mesh, true, bvh == nullptr),
+			mesh(mesh),
+			bvhBuffer(bvhBuffer) {
+
+			if (bvh != nullptr) {
+				//Bvh was constructed inside the buffer, so it doesn't need to be deleted separately.
+				setOptimizedBvh(bvh);
+			}
+		}
+
+		~CachedMeshShape() {
+			if (bvhBuffer != nullptr) {
+				btAlignedFree(bvhBuffer);
+			}
+		}
+
+	private:
+		std::unique_ptr<btTriangleMesh> mesh;
+		void* bvhBuffer;
+	};
+
+	/**
+	 * Attempts to load a serialized bvh from the cache.
+	 * @param filename The cache file.
+	 * @param meshHash The hash of the mesh the bvh is for.
+	 * @param bufferOut Set to the buffer allocated with btAlignedAlloc holding the bvh, if it was loaded.
+	 * @return The loaded bvh, or nullptr if it couldn't be loaded.
+	 */
+	btOptimizedBvh* loadCachedBvh(const std::string& filename, uint64_t meshHash, void*& bufferOut) {
+		std::ifstream inFile(filename, std::ios::binary);
+		BvhCacheHeader header = {};
+
+		if (!inFile.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+			return nullptr;
+		}
+
+		if (header.magic != BVH_CACHE_MAGIC || header.version != BVH_CACHE_VERSION ||
+			header.scalarSize != sizeof(btScalar) || header.meshHash != meshHash || header.bvhSize == 0) {
+			return nullptr;
+		}
+
+		//Bullet requires 16 byte alignment for in-place deserialization.
+		void* buffer = btAlignedAlloc(header.bvhSize, 16);
+
+		if (!inFile.read(static_cast<char*>(buffer), header.bvhSize)) {
+			btAlignedFree(buffer);
+			return nullptr;
+		}
+
+		btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(buffer, header.bvhSize, false);
+
+		if (bvh == nullptr) {
+			btAlignedFree(buffer);
+			return nullptr;
+		}
+
+		bufferOut = buffer;
+		return bvh;
+	}
+
+	/**
+	 * Saves a shape's bvh to the cache. Failures are ignored, the bvh will
+	 * just be built again next time.
+	 * @param filename The cache file.
+	 * @param meshHash The hash of the mesh the bvh is for.
+	 * @param bvh The bvh to save.
+	 */
+	void saveCachedBvh(const std::string& filename, uint64_t meshHash, const btOptimizedBvh* bvh) {
+		const uint32_t bvhSize = bvh->calculateSerializeBufferSize();
+		void* buffer = btAlignedAlloc(bvhSize, 16);
+
+		//serializeInPlace is non-destructive, it just writes to the buffer.
+		if (!bvh->serializeInPlace(buffer, bvhSize, false)) {
+			btAlignedFree(buffer);
+			return;
+		}
+
+		const BvhCacheHeader header = {BVH_CACHE_MAGIC, BVH_CACHE_VERSION, sizeof(btScalar), bvhSize, meshHash};
+
+		//Write to a temporary file first, so a crash never leaves a partial cache file behind.
+		const std::string tempName = filename + ".tmp";
+
+		{
+			std::ofstream outFile(tempName, std::ios::binary | std::ios::trunc);
+			outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			outFile.write(static_cast<const char*>(buffer), bvhSize);
+
+			if (!outFile) {
+				btAlignedFree(buffer);
+				std::remove(tempName.c_str());
+				return;
+			}
+		}
+
+		btAlignedFree(buffer);
+		std::rename(tempName.c_str(), filename.c_str());
+	}
+}
+
+std::shared_ptr<btCollisionShape> PhysicsShapeCache::getShape(PhysicsShape type, const Aabb<float>& box) {
+	const ShapeKey key = makeKey(type, box);
+
+	std::lock_guard<std::mutex> lock(cacheLock);
+
+	std::weak_ptr<btCollisionShape>& entry = shapes[key];
+	std::shared_ptr<btCollisionShape> shape = entry.lock();
+
+	if (!shape) {
+		//The deleter only removes the entry if it hasn't been replaced, as a new shape can
+		//be requested after the old one expires but before the deleter runs.
+		shape = std::shared_ptr<btCollisionShape>(createShape(key), [this, key](btCollisionShape* oldShape) {
+			{
+				std::lock_guard<std::mutex> deleteLock(cacheLock);
+				auto shapeLoc = shapes.find(key);
+
+				if (shapeLoc != shapes.end() && shapeLoc->second.expired()) {
+					shapes.erase(shapeLoc);
+				}
+			}
+
+			delete oldShape;
+		});
+
+		entry = shape;
+	}
+
+	return shape;
+}
+
+std::shared_ptr<btBvhTriangleMeshShape> PhysicsShapeCache::getMeshShape(const std::string& meshName) {
+	std::lock_guard<std::mutex> lock(meshLock);
+
+	std::weak_ptr<btBvhTriangleMeshShape>& entry = meshShapes[meshName];
+	std::shared_ptr<btBvhTriangleMeshShape> shape = entry.lock();
+
+	if (!shape) {
+		//See getShape for deleter explanation.
+		shape = std::shared_ptr<btBvhTriangleMeshShape>(createMeshShape(meshName), [this, meshName](btBvhTriangleMeshShape* oldShape) {
+			{
+				std::lock_guard<std::mutex> deleteLock(meshLock);
+				auto shapeLoc = meshShapes.find(meshName);
+
+				if (shapeLoc != meshShapes.end() && shapeLoc->second.expired()) {
+					meshShapes.erase(shapeLoc);
+				}
+			}
+
+			delete oldShape;
+		});
+
+		entry = shape;
+	}
+
+	return shape;
+}
+
+size_t PhysicsShapeCache::size() {
+	std::lock_guard<std::mutex> lock(cacheLock);
+	std::lock_guard<std::mutex> otherLock(meshLock);
+	return shapes.size() + meshShapes.size();
+}
+
+PhysicsShapeCache::ShapeKey PhysicsShapeCache::makeKey(PhysicsShape type, const Aabb<float>& box) {
+	switch (type) {
+		case PhysicsShape::PLANE: {
+			glm::vec3 normal(box.max - box.min);
+			glm::normalize(normal);
+
+			//Point on the plane
+			glm::vec3 point = box.min;
+
+			//'d' from the plane equation: ax + by + cz + d = 0. Normally distance uses
+			//absolute value and divides by length, but here that is fortunately not
+			//necessary.
+			float offset = glm::dot(normal, point);
+
+			return ShapeKey{type, {normal.x, normal.y, normal.z, offset}};
+		}
+		case PhysicsShape::BOX: return ShapeKey{type, {box.xLength() / 2.0f, box.yLength() / 2.0f, box.zLength() / 2.0f, 0.0f}};
+		//The ends are always at the top and bottom for now.
+		case PhysicsShape::CAPSULE: return ShapeKey{type, {box.xLength() / 2.0f, box.yLength(), 0.0f, 0.0f}};
+		//This assumes that the bounding box is a cube.
+		case PhysicsShape::SPHERE: return ShapeKey{type, {box.xLength() / 2.0f, 0.0f, 0.0f, 0.0f}};
+		case PhysicsShape::HEIGHTFIELD: throw std::runtime_error("Heightfields must be created with PhysicsManager::addTerrain!");
+		default: throw std::runtime_error("Missing physics shape!");
+	}
+}
+
+btCollisionShape* PhysicsShapeCache::createShape(const ShapeKey& key) {
+	const std::array<float, 4>& dims = key.dims;
+
+	switch (key.type) {
+		case PhysicsShape::PLANE: return new btStaticPlaneShape(btVector3(dims[0], dims[1], dims[2]), dims[3]);
+		case PhysicsShape::BOX: return new btBoxShape(btVector3(dims[0], dims[1], dims[2]));
+		case PhysicsShape::CAPSULE: return new btCapsuleShape(dims[0], dims[1]);
+		case PhysicsShape::SPHERE: return new btSphereShape(dims[0]);
+		default: throw std::runtime_error("Missing physics shape!");
+	}
+}
+
+btBvhTriangleMeshShape* PhysicsShapeCache::createMeshShape(const std::string& meshName) {
+	std::shared_ptr<const MeshRef> meshRef = Engine::instance->getModelManager().getMesh(meshName, CacheLevel::MEMORY);
+	const VertexFormat* format = meshRef->getMesh()->getFormat();
+
+	if (!format->hasElement(VERTEX_ELEMENT_POSITION)) {
+		throw std::runtime_error("Attempt to generate physics shape from mesh without positions!");
+	}
+
+	const size_t vertexSize = format->getVertexSize();
+	const size_t posOffset = format->getElementOffset(VERTEX_ELEMENT_POSITION);
+
+	const auto meshData = meshRef->getMesh()->getMeshData();
+	std::unique_ptr<btTriangleMesh> mesh(new btTriangleMesh());
+	uint64_t meshHash = 0xcbf29ce484222325;
+
+	//Create physics mesh
+	for (size_t i = posOffset; i < std::get<1>(meshData); i += vertexSize) {
+		glm::vec3 vertPos = *(glm::vec3*)(std::get<0>(meshData) + i);
+		mesh->findOrAddVertex(btVector3(vertPos.x, vertPos.y, vertPos.z), false);
+		meshHash = fnvHash(meshHash, &vertPos, sizeof(vertPos));
+	}
+
+	const std::vector<uint32_t>& indexData = std::get<2>(meshData);
+
+	//Add indices
+	for (size_t i = 0; i < indexData.size(); i += 3) {
+		mesh->addTriangleIndices(indexData.at(i), indexData.at(i + 1), indexData.at(i + 2));
+	}
+
+	meshHash = fnvHash(meshHash, indexData.data(), indexData.size() * sizeof(uint32_t));
+
+	const std::string& cacheDir = Engine::instance->getConfig().physicsCacheDir;
+
+	if (cacheDir.empty()) {
+		return new CachedMeshShape(mesh.release(), nullptr, nullptr);
+	}
+
+	std::ostringstream nameStream;
+	nameStream << cacheDir << std::hex << std::setw(16) << std::setfill('0') << meshHash << ".bvh";
+	const std::string cacheFile = nameStream.str();
+
+	void* bvhBuffer = nullptr;
+	btOptimizedBvh* bvh = loadCachedBvh(cacheFile, meshHash, bvhBuffer);
+
+	CachedMeshShape* shape = new CachedMeshShape(mesh.release(), bvh, bvhBuffer);
+
+	if (bvh == nullptr) {
+		saveCachedBvh(cacheFile, meshHash, shape->getOptimizedBvh());
+	}
+
+	return shape;
+}
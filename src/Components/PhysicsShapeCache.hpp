@@ -0,0 +1,118 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <array>
+#include <string>
+
+#include "btBulletDynamicsCommon.h"
+
+#include "PhysicsObject.hpp"
+
+//Hands out collision shapes for physics objects, so objects with the same
+//shape and dimensions, or the same mesh, share a single bullet shape. Shapes
+//are reference counted, and are deleted once the last object using them is gone.
+//All functions are threadsafe.
+class PhysicsShapeCache {
+public:
+	/**
+	 * Gets a shape of the given type, creating it if no object is currently using an identical one.
+	 * Returned shapes are shared, so they must not be modified (scaling, margins, etc.).
+	 * @param type The type of shape to get.
+	 * @param box The bounding box for the shape, see PhysicsInfo.
+	 * @return The shape.
+	 * @throw std::runtime_error if the shape type isn't a primitive.
+	 */
+	std::shared_ptr<btCollisionShape> getShape(PhysicsShape type, const Aabb<float>& box);
+
+	/**
+	 * Gets a static triangle mesh shape for the given mesh, creating it if no object is currently
+	 * using it. If a physics cache directory is set in the engine config, the shape's bvh is
+	 * loaded from there if it was saved before, and saved there after being built otherwise.
+	 * As with getShape, returned shapes must not be modified - use btScaledBvhTriangleMeshShape
+	 * for scaling.
+	 * @param meshName The name of the mesh to create the shape from.
+	 * @return The shape.
+	 * @throw std::runtime_error if the mesh has no positions.
+	 */
+	std::shared_ptr<btBvhTriangleMeshShape> getMeshShape(const std::string& meshName);
+
+	/**
+	 * Returns the number of distinct shapes currently in use, for debugging.
+	 * @return The number of shapes.
+	 */
+	size_t size();
+
+private:
+	struct ShapeKey {
+		PhysicsShape type;
+		//Shape dimensions, see createShape. Unused values are zero.
+		std::array<float, 4> dims;
+
+		bool operator==(const ShapeKey& other) const { return type == other.type && dims == other.dims; }
+	};
+
+	struct ShapeKeyHash {
+		size_t operator()(const ShapeKey& key) const {
+			size_t hash = std::hash<int>()(static_cast<int>(key.type));
+
+			for (float dim : key.dims) {
+				hash = hash * 31 + std::hash<float>()(dim);
+			}
+
+			return hash;
+		}
+	};
+
+	//Protects shapes, objects can be created and destroyed from any thread.
+	std::mutex cacheLock;
+	//Every shape currently in use. Entries are removed by the shapes' deleters.
+	std::unordered_map<ShapeKey, std::weak_ptr<btCollisionShape>, ShapeKeyHash> shapes;
+	//Protects meshShapes. Separate from cacheLock because building mesh shapes can take a
+	//long time, and primitive shapes shouldn't need to wait for it.
+	std::mutex meshLock;
+	//Every mesh shape currently in use, by mesh name.
+	std::unordered_map<std::string, std::weak_ptr<btBvhTriangleMeshShape>> meshShapes;
+
+	/**
+	 * Creates the key for a shape.
+	 * @param type The type of shape.
+	 * @param box The shape's bounding box.
+	 * @return The key for the shape.
+	 */
+	static ShapeKey makeKey(PhysicsShape type, const Aabb<float>& box);
+
+	/**
+	 * Creates a new bullet shape from its key.
+	 * @param key The key from makeKey.
+	 * @return The new shape.
+	 */
+	static btCollisionShape* createShape(const ShapeKey& key);
+
+	/**
+	 * Creates a new triangle mesh shape from the given mesh, using a cached bvh if possible.
+	 * @param meshName The name of the mesh.
+	 * @return The new shape.
+	 */
+	static btBvhTriangleMeshShape* createMeshShape(const std::string& meshName);
+};
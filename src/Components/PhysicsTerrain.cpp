@@ -0,0 +1,202 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <string>
+
+#include "PhysicsTerrain.hpp"
+#include "Engine.hpp"
+
+namespace {
+	//How far a vertex can be from its grid point, as a fraction of the spacing, for rounding error in the mesh.
+	constexpr float GRID_TOLERANCE = 0.01f;
+	//Marks grid points that don't have a vertex yet.
+	constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+}
+
+MeshHeightfieldShape::MeshHeightfieldShape(const unsigned char* vertexData, size_t vertexSize, size_t heightOffset, const uint32_t* gridIndices, size_t rowLength,
+										   size_t startX, size_t startZ, int width, int length, btScalar minHeight, btScalar maxHeight) :
+	//The data pointer is never used, as getRawHeightFieldValue is overridden.
+	btHeightfieldTerrainShape(width, length, vertexData, 1.0, minHeight, maxHeight, 1, PHY_FLOAT, false),
+	vertexData(vertexData),
+	vertexSize(vertexSize),
+	heightOffset(heightOffset),
+	gridIndices(gridIndices),
+	rowLength(rowLength),
+	startX(startX),
+	startZ(startZ) {
+
+}
+
+PhysicsTerrain::PhysicsTerrain(const PhysicsTerrainInfo& info) :
+	info(info),
+	meshRef(Engine::instance->getModelManager().getMesh(info.meshName, CacheLevel::MEMORY)),
+	vertexData(nullptr),
+	vertexSize(0),
+	posOffset(0),
+	origin(0.0f),
+	spacing(0.0f) {
+
+	const VertexFormat* format = meshRef->getMesh()->getFormat();
+
+	if (!format->hasElement(VERTEX_ELEMENT_POSITION)) {
+		throw std::runtime_error("Attempt to generate terrain from mesh without positions!");
+	}
+
+	if (info.width < 2 || info.length < 2 || info.chunkSize == 0) {
+		throw std::runtime_error("Invalid terrain dimensions for \"" + info.meshName + "\"!");
+	}
+
+	const auto meshData = meshRef->getMesh()->getMeshData();
+	vertexData = std::get<0>(meshData);
+	vertexSize = format->getVertexSize();
+	posOffset = format->getElementOffset(VERTEX_ELEMENT_POSITION);
+
+	buildGrid(std::get<1>(meshData) / vertexSize);
+	origin += info.pos;
+
+	//Neighbouring chunks share their edge vertices, so there aren't any gaps.
+	for (size_t z = 0; z < info.length - 1; z += info.chunkSize) {
+		for (size_t x = 0; x < info.width - 1; x += info.chunkSize) {
+			Chunk chunk = {};
+			chunk.startX = x;
+			chunk.startZ = z;
+			chunk.width = std::min<size_t>(info.chunkSize, info.width - 1 - x) + 1;
+			chunk.length = std::min<size_t>(info.chunkSize, info.length - 1 - z) + 1;
+			chunk.center = glm::vec2(origin.x, origin.z) + spacing * glm::vec2(x + (chunk.width - 1) / 2.0f, z + (chunk.length - 1) / 2.0f);
+
+			chunks.push_back(std::move(chunk));
+		}
+	}
+}
+
+void PhysicsTerrain::findChanges(const glm::vec3& camera, std::vector<size_t>& loads, std::vector<size_t>& unloads) const {
+	const glm::vec2 cameraPos(camera.x, camera.z);
+
+	for (size_t i = 0; i < chunks.size(); i++) {
+		const float distance = glm::distance(chunks.at(i).center, cameraPos);
+
+		if (!chunks.at(i).shape && distance <= info.loadDistance) {
+			loads.push_back(i);
+		}
+		else if (chunks.at(i).shape && distance > info.unloadDistance) {
+			unloads.push_back(i);
+		}
+	}
+}
+
+void PhysicsTerrain::loadChunk(size_t index) {
+	Chunk& chunk = chunks.at(index);
+
+	if (chunk.shape) {
+		return;
+	}
+
+	float minHeight = getVertex(chunk.startX, chunk.startZ).y;
+	float maxHeight = minHeight;
+
+	for (size_t z = chunk.startZ; z < chunk.startZ + chunk.length; z++) {
+		for (size_t x = chunk.startX; x < chunk.startX + chunk.width; x++) {
+			const float height = getVertex(x, z).y;
+			minHeight = std::min(minHeight, height);
+			maxHeight = std::max(maxHeight, height);
+		}
+	}
+
+	chunk.shape = std::make_shared<MeshHeightfieldShape>(vertexData, vertexSize, posOffset + sizeof(float), gridIndices.data(), info.width,
+														 chunk.startX, chunk.startZ, chunk.width, chunk.length, minHeight, maxHeight);
+	chunk.shape->setLocalScaling(btVector3(spacing.x, 1.0, spacing.y));
+
+	const glm::vec2 halfSize = spacing * glm::vec2(chunk.width - 1, chunk.length - 1) / 2.0f;
+	chunk.min = glm::vec3(chunk.center.x - halfSize.x, minHeight + info.pos.y, chunk.center.y - halfSize.y);
+	chunk.max = glm::vec3(chunk.center.x + halfSize.x, maxHeight + info.pos.y, chunk.center.y + halfSize.y);
+}
+
+btRigidBody* PhysicsTerrain::createBody(size_t index, PhysicsWorld* world) {
+	Chunk& chunk = chunks.at(index);
+
+	//Bullet centers heightfields on their bounding box, including the height.
+	const glm::vec3 center = (chunk.min + chunk.max) / 2.0f;
+
+	btRigidBody::btRigidBodyConstructionInfo bodyInfo(0.0, nullptr, chunk.shape.get());
+	bodyInfo.m_startWorldTransform.setIdentity();
+	bodyInfo.m_startWorldTransform.setOrigin(btVector3(center.x, center.y, center.z));
+
+	chunk.bodies.emplace_back(world, std::make_unique<btRigidBody>(bodyInfo));
+
+	return chunk.bodies.back().second.get();
+}
+
+void PhysicsTerrain::buildGrid(size_t vertexCount) {
+	if (vertexCount < (size_t) info.width * info.length) {
+		throw std::runtime_error("Terrain mesh \"" + info.meshName + "\" has fewer vertices than the given dimensions!");
+	}
+
+	//Mesh loading can reorder vertices, so the grid's position and size come from the bounds instead of the first few.
+	glm::vec3 min = getMeshVertex(0);
+	glm::vec3 max = min;
+
+	for (size_t i = 1; i < vertexCount; i++) {
+		min = glm::min(min, getMeshVertex(i));
+		max = glm::max(max, getMeshVertex(i));
+	}
+
+	origin = glm::vec3(min.x, 0.0f, min.z);
+	spacing = glm::vec2(max.x - min.x, max.z - min.z) / glm::vec2(info.width - 1, info.length - 1);
+
+	if (spacing.x <= 0.0f || spacing.y <= 0.0f) {
+		throw std::runtime_error("Terrain mesh \"" + info.meshName + "\" is flat on the x or z axis!");
+	}
+
+	gridIndices.assign((size_t) info.width * info.length, NO_VERTEX);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		const glm::vec3 pos = getMeshVertex(i);
+		const glm::vec2 gridPos = (glm::vec2(pos.x, pos.z) - glm::vec2(origin.x, origin.z)) / spacing;
+		const glm::vec2 rounded = glm::round(gridPos);
+
+		if (glm::any(glm::greaterThan(glm::abs(gridPos - rounded), glm::vec2(GRID_TOLERANCE)))) {
+			throw std::runtime_error("Vertex " + std::to_string(i) + " of terrain mesh \"" + info.meshName + "\" isn't on the grid!");
+		}
+
+		const size_t x = rounded.x;
+		const size_t z = rounded.y;
+		uint32_t& index = gridIndices.at(z * info.width + x);
+
+		if (index == NO_VERTEX) {
+			index = i;
+		}
+		else if (getMeshVertex(index).y != pos.y) {
+			throw std::runtime_error("Terrain mesh \"" + info.meshName + "\" has more than one height at grid point (" +
+									 std::to_string(x) + ", " + std::to_string(z) + ")!");
+		}
+	}
+
+	if (std::find(gridIndices.begin(), gridIndices.end(), NO_VERTEX) != gridIndices.end()) {
+		throw std::runtime_error("Terrain mesh \"" + info.meshName + "\" is missing vertices for some grid points!");
+	}
+}
+
+void PhysicsTerrain::unloadChunk(size_t index) {
+	Chunk& chunk = chunks.at(index);
+
+	chunk.bodies.clear();
+	chunk.shape.reset();
+}
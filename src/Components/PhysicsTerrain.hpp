@@ -0,0 +1,217 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+
+#include "Models/Mesh.hpp"
+
+class PhysicsWorld;
+
+struct PhysicsTerrainInfo {
+	//The render mesh to take the heights from, kept in memory for as long as the terrain exists.
+	//Every vertex must lie on a regular grid of width by length points on the x and z axes, with
+	//a vertex at every point. Vertices can be in any order, and a point can have more than one
+	//vertex (like along texture seams) as long as they have the same height. A subdivided plane
+	//that's only been displaced along y, loaded through the model manager as usual, works.
+	std::string meshName;
+	//Number of vertices along the x axis.
+	uint32_t width;
+	//Number of vertices along the z axis.
+	uint32_t length;
+	//Number of grid squares along each side of a chunk.
+	uint32_t chunkSize;
+	//Offset of the terrain from the mesh's coordinates.
+	glm::vec3 pos;
+	//Chunks with a center within this distance of the camera on the x and z axes are added to the world.
+	float loadDistance;
+	//Chunks further away than this are removed. Should be larger than loadDistance, so chunks
+	//near the edge don't keep getting added and removed.
+	float unloadDistance;
+	//Collision group and mask, see PhysicsInfo. The default group is "static".
+	uint32_t collisionGroup;
+	uint32_t collisionMask;
+};
+
+//A heightfield shape covering part of a mesh, which reads heights directly
+//from the mesh's vertex data instead of keeping its own copy.
+class MeshHeightfieldShape : public btHeightfieldTerrainShape {
+public:
+	/**
+	 * Creates the shape.
+	 * @param vertexData The mesh's vertex data.
+	 * @param vertexSize The size of each vertex.
+	 * @param heightOffset The offset of the height (position y) in each vertex.
+	 * @param gridIndices The index of the vertex at each grid point, in rows of increasing x.
+	 * @param rowLength The number of points in each row of the grid.
+	 * @param startX, startZ The grid position of the first vertex in the shape.
+	 * @param width, length The number of vertices in the shape along each axis.
+	 * @param minHeight, maxHeight The height range of the shape.
+	 */
+	MeshHeightfieldShape(const unsigned char* vertexData, size_t vertexSize, size_t heightOffset, const uint32_t* gridIndices, size_t rowLength,
+						 size_t startX, size_t startZ, int width, int length, btScalar minHeight, btScalar maxHeight);
+
+protected:
+	/**
+	 * Overridden from btHeightfieldTerrainShape, reads the height from the vertex data.
+	 */
+	btScalar getRawHeightFieldValue(int x, int y) const override {
+		const size_t vertex = gridIndices[(startZ + y) * rowLength + startX + x];
+		return *(const float*)(vertexData + vertex * vertexSize + heightOffset);
+	}
+
+private:
+	const unsigned char* vertexData;
+	size_t vertexSize;
+	size_t heightOffset;
+	const uint32_t* gridIndices;
+	size_t rowLength;
+	size_t startX;
+	size_t startZ;
+};
+
+//Terrain made from a render mesh, split into heightfield chunks that are added
+//to the world around the camera. Managed by PhysicsManager.
+class PhysicsTerrain {
+public:
+	struct Chunk {
+		//Grid position of the chunk's first vertex.
+		size_t startX;
+		size_t startZ;
+		//Number of vertices in the chunk along each axis.
+		int width;
+		int length;
+		//World position of the chunk's center on the x and z axes.
+		glm::vec2 center;
+		//World bounds of the chunk, only valid while loaded.
+		glm::vec3 min;
+		glm::vec3 max;
+		//Shape for the chunk, shared by all its bodies. Null when not loaded.
+		std::shared_ptr<MeshHeightfieldShape> shape;
+		//Bodies for the chunk, one for each world it's in.
+		std::vector<std::pair<PhysicsWorld*, std::unique_ptr<btRigidBody>>> bodies;
+	};
+
+	/**
+	 * Creates the terrain. No chunks are loaded until the manager streams them in.
+	 * @param info The terrain settings.
+	 * @throw std::runtime_error if the mesh isn't a valid grid.
+	 */
+	PhysicsTerrain(const PhysicsTerrainInfo& info);
+
+	/**
+	 * Finds chunks that need to be loaded or unloaded for the given camera position.
+	 * @param camera The camera position.
+	 * @param loads Filled with the indices of chunks to load.
+	 * @param unloads Filled with the indices of chunks to unload.
+	 */
+	void findChanges(const glm::vec3& camera, std::vector<size_t>& loads, std::vector<size_t>& unloads) const;
+
+	/**
+	 * Creates the shape for a chunk and calculates its bounds, if it isn't loaded yet.
+	 * @param index The chunk to load.
+	 */
+	void loadChunk(size_t index);
+
+	/**
+	 * Creates a new body for a loaded chunk, which is added to the chunk's body list.
+	 * @param index The chunk.
+	 * @param world The world the body will be added to.
+	 * @return The new body.
+	 */
+	btRigidBody* createBody(size_t index, PhysicsWorld* world);
+
+	/**
+	 * Frees a chunk's shape. All of its bodies need to have been removed from their worlds first.
+	 * @param index The chunk to unload.
+	 */
+	void unloadChunk(size_t index);
+
+	/**
+	 * Gets a chunk.
+	 * @param index The chunk's index.
+	 * @return The chunk.
+	 */
+	Chunk& getChunk(size_t index) { return chunks.at(index); }
+
+	/**
+	 * Gets the number of chunks.
+	 * @return The chunk count.
+	 */
+	size_t getChunkCount() const { return chunks.size(); }
+
+	/**
+	 * Gets the terrain settings.
+	 * @return The info the terrain was created with.
+	 */
+	const PhysicsTerrainInfo& getInfo() const { return info; }
+
+private:
+	//The terrain settings.
+	PhysicsTerrainInfo info;
+	//Keeps the mesh data in memory.
+	std::shared_ptr<const MeshRef> meshRef;
+	//Start of the mesh's vertex data.
+	const unsigned char* vertexData;
+	//Size of each vertex.
+	size_t vertexSize;
+	//Offset of the position in each vertex.
+	size_t posOffset;
+	//World position of the grid's first point on the x and z axes, y is unused.
+	glm::vec3 origin;
+	//Distance between vertices on the x and z axes.
+	glm::vec2 spacing;
+	//Index of the vertex at each grid point, in rows of increasing x.
+	std::vector<uint32_t> gridIndices;
+	//All chunks in the terrain.
+	std::vector<Chunk> chunks;
+
+	/**
+	 * Places every vertex of the mesh on the grid, filling in gridIndices, origin, and spacing.
+	 * @param vertexCount The number of vertices in the mesh.
+	 * @throw std::runtime_error if the vertices don't form a complete grid of the given dimensions.
+	 */
+	void buildGrid(size_t vertexCount);
+
+	/**
+	 * Gets the position of a vertex in the mesh.
+	 * @param vertex The vertex's index.
+	 * @return The vertex position, without the terrain offset.
+	 */
+	glm::vec3 getMeshVertex(size_t vertex) const {
+		return *(const glm::vec3*)(vertexData + vertex * vertexSize + posOffset);
+	}
+
+	/**
+	 * Gets the position of the vertex at a grid point.
+	 * @param x, z The grid position.
+	 * @return The vertex position, without the terrain offset.
+	 */
+	glm::vec3 getVertex(size_t x, size_t z) const {
+		return getMeshVertex(gridIndices[z * info.width + x]);
+	}
+};
@@ -0,0 +1,182 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <limits>
+
+#include "BulletCollision/CollisionDispatch/btGhostObject.h"
+#include "LinearMath/btTransformUtil.h"
+
+#include "PhysicsWorld.hpp"
+#include "Engine.hpp"
+
+PhysicsWorld::PhysicsWorld(int solverThreads, const btVector3& gravity) :
+	conf(new btDefaultCollisionConfiguration()),
+	dispatcher(nullptr),
+	broadphase(new btDbvtBroadphase()),
+	solver(nullptr),
+	solverPool(nullptr),
+	world(nullptr),
+	ghostCallback(new btGhostPairCallback()),
+	multithreaded(solverThreads > 0),
+	boundsMin(-std::numeric_limits<float>::infinity()),
+	boundsMax(std::numeric_limits<float>::infinity()),
+	substeps(0),
+	pendingTime(0),
+	skippedTicks(0),
+	followTime(0) {
+
+	if (multithreaded) {
+		btSequentialImpulseConstraintSolverMt* solverMt = new btSequentialImpulseConstraintSolverMt();
+		solver = solverMt;
+		//One solver per thread, more would never be used at once.
+		solverPool = new btConstraintSolverPoolMt(solverThreads);
+		dispatcher = new btCollisionDispatcherMt(conf, 40);
+		world = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, solverPool, solverMt, conf);
+	}
+	else {
+		solver = new btSequentialImpulseConstraintSolver();
+		dispatcher = new btCollisionDispatcher(conf);
+		world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, conf);
+	}
+
+	world->setGravity(gravity);
+	world->setInternalTickCallback(physicsTickCallback, this, false);
+	world->setInternalTickCallback(physicsPreTickCallback, this, true);
+	world->getBroadphase()->getOverlappingPairCache()->setInternalGhostPairCallback(ghostCallback);
+}
+
+PhysicsWorld::~PhysicsWorld() {
+	delete world;
+	delete solver;
+	delete broadphase;
+	delete dispatcher;
+	delete conf;
+	delete solverPool;
+	delete ghostCallback;
+}
+
+void PhysicsWorld::step(btScalar time, int maxSubsteps, btScalar fixedStep) {
+	const btScalar totalTime = time + pendingTime;
+	const int totalSubsteps = maxSubsteps * (skippedTicks + 1);
+
+	followTime = -pendingTime;
+	pendingTime = 0;
+	skippedTicks = 0;
+	substeps = 0;
+
+	world->stepSimulation(totalTime, totalSubsteps, fixedStep);
+
+	//If no substeps ran, nothing moved, so the contacts from last time are still valid.
+	if (substeps > 0) {
+		contacts.clear();
+
+		for (std::vector<PhysicsContactPair>& threadList : threadContacts) {
+			contacts.insert(contacts.end(), threadList.begin(), threadList.end());
+			threadList.clear();
+		}
+
+		//Remove pairs found on more than one substep
+		std::sort(contacts.begin(), contacts.end());
+		contacts.erase(std::unique(contacts.begin(), contacts.end()), contacts.end());
+	}
+}
+
+void PhysicsWorld::follow(btRigidBody* body, const btTransform& start, const btVector3& linearVelocity, const btVector3& angularVelocity) {
+	//Bullet works out the velocity of kinematic bodies from how far they moved since the last
+	//step, so keep both transforms the same and set the velocity before each substep instead.
+	body->setWorldTransform(start);
+	body->setInterpolationWorldTransform(start);
+
+	auto followerLoc = std::find_if(followers.begin(), followers.end(), [&](const Follower& follower) {
+		return follower.body == body;
+	});
+
+	if (followerLoc != followers.end()) {
+		*followerLoc = Follower{body, start, linearVelocity, angularVelocity};
+	}
+	else {
+		followers.push_back(Follower{body, start, linearVelocity, angularVelocity});
+	}
+}
+
+void PhysicsWorld::unfollow(btRigidBody* body) {
+	auto followerLoc = std::find_if(followers.begin(), followers.end(), [&](const Follower& follower) {
+		return follower.body == body;
+	});
+
+	if (followerLoc != followers.end()) {
+		*followerLoc = followers.back();
+		followers.pop_back();
+	}
+}
+
+void PhysicsWorld::physicsPreTickCallback(btDynamicsWorld* world, btScalar timeStep) {
+	static_cast<PhysicsWorld*>(world->getWorldUserInfo())->preTickCallback(timeStep);
+}
+
+void PhysicsWorld::preTickCallback(btScalar timeStep) {
+	for (Follower& follower : followers) {
+		btTransform transform;
+		btTransformUtil::integrateTransform(follower.start, follower.linearVelocity, follower.angularVelocity, followTime, transform);
+
+		follower.body->setWorldTransform(transform);
+		follower.body->setInterpolationWorldTransform(transform);
+		follower.body->setLinearVelocity(follower.linearVelocity);
+		follower.body->setAngularVelocity(follower.angularVelocity);
+	}
+
+	followTime += timeStep;
+}
+
+void PhysicsWorld::physicsTickCallback(btDynamicsWorld* world, btScalar timeStep) {
+	static_cast<PhysicsWorld*>(world->getWorldUserInfo())->tickCallback();
+}
+
+void PhysicsWorld::tickCallback() {
+	const size_t manifoldCount = world->getDispatcher()->getNumManifolds();
+
+	auto recordManifold = [&](size_t i) {
+		btPersistentManifold* manifold = world->getDispatcher()->getManifoldByIndexInternal(i);
+
+		//Manifolds exist for all overlapping bounding boxes, only count actual contacts.
+		if (manifold->getNumContacts() == 0) {
+			return;
+		}
+
+		PhysicsComponent* object1 = static_cast<PhysicsComponent*>(manifold->getBody0()->getUserPointer());
+		PhysicsComponent* object2 = static_cast<PhysicsComponent*>(manifold->getBody1()->getUserPointer());
+
+		//Ghost objects don't have a user pointer
+		if (object1 != nullptr && object2 != nullptr) {
+			threadContacts.local().push_back(std::minmax(object1, object2));
+		}
+	};
+
+	//Single threaded worlds are already being stepped in parallel with other worlds.
+	if (multithreaded) {
+		Engine::parallelFor(0, manifoldCount, recordManifold);
+	}
+	else {
+		for (size_t i = 0; i < manifoldCount; i++) {
+			recordManifold(i);
+		}
+	}
+
+	substeps++;
+}
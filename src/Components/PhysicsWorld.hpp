@@ -0,0 +1,226 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <tbb/enumerable_thread_specific.h>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+
+class PhysicsComponent;
+class PhysicsGhostObject;
+
+//Two components that are touching, ordered by address so each pair only has one representation.
+typedef std::pair<PhysicsComponent*, PhysicsComponent*> PhysicsContactPair;
+
+//A single bullet world, along with everything needed to run it. The physics manager
+//normally has one of these, or one per grid cell when partitioned into regions.
+class PhysicsWorld {
+public:
+	/**
+	 * Creates a world.
+	 * @param solverThreads The number of threads to split stepping across. If 0, a
+	 *     single-threaded world is created, for when multiple worlds are stepped in parallel.
+	 * @param gravity The gravity for the world.
+	 */
+	PhysicsWorld(int solverThreads, const btVector3& gravity);
+
+	/**
+	 * Deletes all the bullet objects. Any bodies still in the world need to be removed first.
+	 */
+	~PhysicsWorld();
+
+	//Bullet objects reference each other by pointer, so this can't be moved.
+	PhysicsWorld(const PhysicsWorld&) = delete;
+	PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+	/**
+	 * Gets the bullet world, for adding objects and queries.
+	 * @return The world.
+	 */
+	btDiscreteDynamicsWorld* getWorld() const { return world; }
+
+	/**
+	 * Steps the world, and records the contacts from the step if any substeps ran.
+	 * Any time skipped since the last step is stepped as well.
+	 * @param time The time to step, in seconds.
+	 * @param maxSubsteps The maximum number of substeps to run for each tick being stepped.
+	 * @param fixedStep The length of each substep.
+	 */
+	void step(btScalar time, int maxSubsteps, btScalar fixedStep);
+
+	/**
+	 * Skips stepping the world for a tick, for worlds that step at a reduced rate. The
+	 * time is added on to the next step, and the contacts from the last step are kept.
+	 * @param time The time that would have been stepped, in seconds.
+	 */
+	void skipStep(btScalar time) {
+		pendingTime += time;
+		skippedTicks++;
+		substeps = 0;
+	}
+
+	/**
+	 * Gets the number of ticks skipped since the world was last stepped.
+	 * @return The number of skipped ticks.
+	 */
+	uint32_t getSkippedTicks() const { return skippedTicks; }
+
+	/**
+	 * Gets the number of substeps run during the last call to step.
+	 * @return The number of substeps.
+	 */
+	size_t getSubsteps() const { return substeps; }
+
+	/**
+	 * Gets the sorted, deduplicated contacts from the last step that ran any substeps.
+	 * @return The world's contacts.
+	 */
+	std::vector<PhysicsContactPair>& getContacts() { return contacts; }
+
+	/**
+	 * Gets the list of ghosts in this world whose overlaps changed since the last flush.
+	 * Ghosts add themselves to this, as it's only modified by the thread stepping the world.
+	 * @return The changed ghost list.
+	 */
+	std::vector<PhysicsGhostObject*>& getChangedTriggers() { return changedTriggers; }
+
+	/**
+	 * Makes a kinematic body in this world follow a body in another world. The body is moved at the
+	 * start of every substep, extrapolating from the other body's state at the start of the tick.
+	 * Calling this again for the same body replaces its state, it needs to be called every tick.
+	 * @param body The kinematic body, which must already be in this world.
+	 * @param start The other body's transform at the start of the tick.
+	 * @param linearVelocity The other body's linear velocity.
+	 * @param angularVelocity The other body's angular velocity.
+	 */
+	void follow(btRigidBody* body, const btTransform& start, const btVector3& linearVelocity, const btVector3& angularVelocity);
+
+	/**
+	 * Stops moving a body added with follow. Needs to be called before it's removed from the world.
+	 * @param body The body to stop moving.
+	 */
+	void unfollow(btRigidBody* body);
+
+	/**
+	 * Sets the area of the world covered by this world, on the x and z axes. Only used
+	 * for region cells, the default bounds cover everything.
+	 * @param min The minimum corner.
+	 * @param max The maximum corner.
+	 */
+	void setBounds(const glm::vec2& min, const glm::vec2& max) { boundsMin = min; boundsMax = max; }
+
+	/**
+	 * Checks whether the given position is within this world's bounds.
+	 * @param pos The position to check.
+	 * @param margin Extra distance outside the bounds that still counts as inside.
+	 * @return Whether the position is inside.
+	 */
+	bool contains(const glm::vec3& pos, float margin) const {
+		return pos.x >= boundsMin.x - margin && pos.x <= boundsMax.x + margin &&
+			   pos.z >= boundsMin.y - margin && pos.z <= boundsMax.y + margin;
+	}
+
+	/**
+	 * Checks whether the given box overlaps this world's bounds, on the x and z axes.
+	 * @param min The minimum corner of the box.
+	 * @param max The maximum corner of the box.
+	 * @param margin Extra distance to grow the bounds by.
+	 * @return Whether the box overlaps.
+	 */
+	bool overlaps(const glm::vec3& min, const glm::vec3& max, float margin) const {
+		return max.x >= boundsMin.x - margin && min.x <= boundsMax.x + margin &&
+			   max.z >= boundsMin.y - margin && min.z <= boundsMax.y + margin;
+	}
+
+	/**
+	 * Gets the center of the world's bounds, on the x and z axes.
+	 * @return The center.
+	 */
+	glm::vec2 getCenter() const { return (boundsMin + boundsMax) / 2.0f; }
+
+private:
+	//A kinematic body moved along with a body in another world.
+	struct Follower {
+		btRigidBody* body;
+		//State of the body being followed at the start of the tick.
+		btTransform start;
+		btVector3 linearVelocity;
+		btVector3 angularVelocity;
+	};
+
+	btDefaultCollisionConfiguration* conf;
+	btCollisionDispatcher* dispatcher;
+	btBroadphaseInterface* broadphase;
+	btConstraintSolver* solver;
+	btConstraintSolverPoolMt* solverPool;
+	btDiscreteDynamicsWorld* world;
+	btGhostPairCallback* ghostCallback;
+	//Whether the world splits its own work across threads.
+	bool multithreaded;
+
+	//Area covered by the world.
+	glm::vec2 boundsMin;
+	glm::vec2 boundsMax;
+
+	//Number of substeps run during the last step.
+	size_t substeps;
+	//Time that has passed without this world being stepped.
+	btScalar pendingTime;
+	//Number of ticks since this world was last stepped.
+	uint32_t skippedTicks;
+	//Contacts found by each thread during the current step's substeps, possibly with duplicates.
+	tbb::enumerable_thread_specific<std::vector<PhysicsContactPair>> threadContacts;
+	//Contacts from the last step.
+	std::vector<PhysicsContactPair> contacts;
+	//Ghosts that had overlaps change.
+	std::vector<PhysicsGhostObject*> changedTriggers;
+	//Bodies following bodies in other worlds.
+	std::vector<Follower> followers;
+	//Time from the start of the current tick to the start of the next substep. Negative
+	//while catching up on skipped ticks, as followers only know where things are now.
+	btScalar followTime;
+
+	/**
+	 * Only called from bullet.
+	 */
+	static void physicsTickCallback(btDynamicsWorld* world, btScalar timeStep);
+
+	/**
+	 * Only called from bullet.
+	 */
+	static void physicsPreTickCallback(btDynamicsWorld* world, btScalar timeStep);
+
+	/**
+	 * Called from bullet before each substep, moves followers to where the bodies they follow should be.
+	 * @param timeStep The length of the substep.
+	 */
+	void preTickCallback(btScalar timeStep);
+
+	/**
+	 * Called from bullet after each substep, records all touching pairs of objects.
+	 */
+	void tickCallback();
+};
@@ -16,25 +16,40 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 
+#include <algorithm>
+
 #include "RenderComponent.hpp"
 #include "Engine.hpp"
 #include "RenderManager.hpp"
+#include "PhysicsComponent.hpp"
 
 RenderComponent::RenderComponent(const std::string& material, const std::string& mesh, glm::vec3 renderScale) :
 	model(Engine::instance->getModel(material, mesh)),
 	scale(renderScale),
-	visible(false),
 	hidden(false),
-	manager(nullptr) {
+	manager(nullptr),
+	hasSnapshot(false),
+	prevTranslation(0.0, 0.0, 0.0),
+	prevRotation(1.0, 0.0, 0.0, 0.0),
+	currentTranslation(0.0, 0.0, 0.0),
+	currentRotation(1.0, 0.0, 0.0, 0.0),
+	renderTranslation(0.0, 0.0, 0.0),
+	renderRotation(1.0, 0.0, 0.0, 0.0) {
 
 }
 
 RenderComponent::RenderComponent(Model model, glm::vec3 renderScale) :
 	model(model),
 	scale(renderScale),
-	visible(false),
 	hidden(false),
-	manager(nullptr) {
+	manager(nullptr),
+	hasSnapshot(false),
+	prevTranslation(0.0, 0.0, 0.0),
+	prevRotation(1.0, 0.0, 0.0, 0.0),
+	currentTranslation(0.0, 0.0, 0.0),
+	currentRotation(1.0, 0.0, 0.0, 0.0),
+	renderTranslation(0.0, 0.0, 0.0),
+	renderRotation(1.0, 0.0, 0.0, 0.0) {
 
 }
 
@@ -47,3 +62,43 @@ void RenderComponent::setModel(Model newModel) {
 		manager->reloadComponent(this, oldModel);
 	}
 }
+
+void RenderComponent::snapshotTransform() const {
+	std::shared_ptr<Object> parent = lockParent();
+
+	prevTranslation = currentTranslation;
+	prevRotation = currentRotation;
+	currentTranslation = parent->getPhysics()->getTranslation();
+	currentRotation = parent->getPhysics()->getRotation();
+
+	//Don't interpolate from the origin for new objects.
+	if (!hasSnapshot) {
+		prevTranslation = currentTranslation;
+		prevRotation = currentRotation;
+		renderTranslation = currentTranslation;
+		renderRotation = currentRotation;
+		hasSnapshot = true;
+	}
+}
+
+void RenderComponent::interpolateTransform(float partialTicks) const {
+	renderTranslation = glm::mix(prevTranslation, currentTranslation, partialTicks);
+	renderRotation = glm::slerp(prevRotation, currentRotation, partialTicks);
+}
+
+Aabb<float> RenderComponent::getTickBounds() const {
+	const float radius = model.mesh->getRadius() * std::max({scale.x, scale.y, scale.z});
+	const glm::vec3 radiusVec(radius, radius, radius);
+
+	return Aabb<float>(Aabb<float>(prevTranslation - radiusVec, prevTranslation + radiusVec), Aabb<float>(currentTranslation - radiusVec, currentTranslation + radiusVec));
+}
+
+bool RenderComponent::isStatic() const {
+	if (!model.material->viewCull) {
+		return false;
+	}
+
+	std::shared_ptr<const PhysicsComponent> physics = lockParent()->getComponent<PhysicsComponent>();
+
+	return !physics || physics->getControlMode() == PhysicsControlMode::STATIC;
+}
@@ -26,6 +26,7 @@
 #include "Models/Material.hpp"
 #include "Display/Object.hpp"
 #include "Models/ModelManager.hpp"
+#include "AxisAlignedBB.hpp"
 
 class RenderManager;
 
@@ -53,16 +54,44 @@ public:
 	RenderComponent(Model model, glm::vec3 renderScale = glm::vec3(1.0, 1.0, 1.0));
 
 	/**
-	 * Returns the translation of this object.
+	 * Returns the translation of this object, interpolated between the last two ticks.
 	 * @return A translation vector for this object.
 	 */
-	glm::vec3 getTranslation() const { return lockParent()->getPhysics()->getTranslation(); }
+	glm::vec3 getTranslation() const { return renderTranslation; }
 
 	/**
-	 * Returns the rotation of this object.
+	 * Returns the rotation of this object, interpolated between the last two ticks.
 	 * @return A quaternion for this object's rotation.
 	 */
-	glm::quat getRotation() const { return  lockParent()->getPhysics()->getRotation(); }
+	glm::quat getRotation() const { return renderRotation; }
+
+	/**
+	 * Stores the parent's current position and rotation, keeping the previous ones for
+	 * interpolation. Called by the render manager at the end of every tick.
+	 */
+	void snapshotTransform() const;
+
+	/**
+	 * Calculates the translation and rotation to render the object with, based on how far
+	 * the renderer is between the last tick and the next one. Called by the rendering
+	 * engine before each frame.
+	 * @param partialTicks The fraction of a tick that has passed since the last one, [0, 1).
+	 */
+	void interpolateTransform(float partialTicks) const;
+
+	/**
+	 * Gets a box containing the component's bounding sphere at every position it can be
+	 * interpolated to before the next tick, used to cull objects that rarely move.
+	 * @return The bounding box.
+	 */
+	Aabb<float> getTickBounds() const;
+
+	/**
+	 * Checks whether the component is expected to stay in place, which is when its object
+	 * either has no physics or has static physics. Components that aren't view culled never are.
+	 * @return Whether the component is static.
+	 */
+	bool isStatic() const;
 
 	/**
 	 * Returns the scale of this object.
@@ -111,21 +140,6 @@ public:
 	 */
 	std::shared_ptr<const ObjectState> getParentState() const { return lockParent()->getState(); }
 
-	/**
-	 * Sets the cached visibility value for the component.
-	 * Internal only! For disabling rendering of objects,
-	 * see setHidden.
-	 * @param vis Whether the component is visible.
-	 */
-	void setVisible(bool vis) const { visible = vis; }
-
-	/**
-	 * Gets whether the component was marked as visible, to determine
-	 * whether it should be rendered.
-	 * @return Whether the component can be seen by the camera.
-	 */
-	bool isVisible() const { return visible; }
-
 	/**
 	 * Sets whether the RenderComponent should currently be rendered.
 	 * @param newHidden The new hidden state.
@@ -143,10 +157,20 @@ private:
 	Model model;
 	//The scale of the object's model.
 	glm::vec3 scale;
-	//Whether the RenderComponent was visible in the last frame, cached for the rendering engine.
-	mutable bool visible;
 	//Whether the RenderComponent should be rendered, for external use.
 	bool hidden;
+	//Whether a transform has been snapshotted yet. If not, the next snapshot
+	//is used for both the previous and current transform.
+	mutable bool hasSnapshot;
+	//The parent's position and rotation as of the tick before last.
+	mutable glm::vec3 prevTranslation;
+	mutable glm::quat prevRotation;
+	//The parent's position and rotation as of the last tick.
+	mutable glm::vec3 currentTranslation;
+	mutable glm::quat currentRotation;
+	//The interpolated position and rotation for the current frame.
+	mutable glm::vec3 renderTranslation;
+	mutable glm::quat renderRotation;
 	//The manager for this component, null if none.
 	RenderManager* manager;
 };
@@ -17,6 +17,9 @@
  ******************************************************************************/
 
 #include <algorithm>
+#include <atomic>
+
+#include <tbb/enumerable_thread_specific.h>
 
 #include "RenderManager.hpp"
 #include "Engine.hpp"
@@ -25,20 +28,99 @@
 void RenderManager::onComponentAdd(std::shared_ptr<Component> comp) {
 	std::shared_ptr<RenderComponent> renderComp = std::static_pointer_cast<RenderComponent>(comp);
 
-	getComponentSet(renderComp->getModel()).push_back(renderComp.get());
 	renderComponentSet.push_back(renderComp.get());
+	componentBatches.push_back(acquireBatch(renderComp->getModel()));
+	componentStatic.push_back(false);
+	componentSlots.push_back(0);
+	componentLods.push_back(0);
 	renderComp->setManager(this);
+
+	//Start from the object's current position, otherwise it would be drawn at
+	//the origin until the end of the tick.
+	renderComp->snapshotTransform();
+
+	addCullSlot(renderComponentSet.size() - 1);
+}
+
+void RenderManager::snapshotTransforms() {
+	//Physics control modes can change at any time, which changes whether components are static.
+	tbb::enumerable_thread_specific<std::vector<uint32_t>> threadMoved;
+
+	Engine::parallelFor(0, renderComponentSet.size(), [&](size_t i) {
+		renderComponentSet[i]->snapshotTransform();
+
+		if (renderComponentSet[i]->isStatic() != componentStatic[i]) {
+			threadMoved.local().push_back(i);
+		}
+	});
+
+	for (const std::vector<uint32_t>& moved : threadMoved) {
+		for (uint32_t index : moved) {
+			removeCullSlot(index);
+			addCullSlot(index);
+		}
+	}
+
+	//Static components can still be moved manually, or have their model or scale changed.
+	std::atomic<bool> moved(false);
+
+	Engine::parallelFor(0, staticComponents.size(), [&](size_t i) {
+		const Aabb<float> bounds = renderComponentSet[staticComponents[i]]->getTickBounds();
+
+		if (bounds.min != staticBounds[i].min || bounds.max != staticBounds[i].max) {
+			staticBounds[i] = bounds;
+			moved = true;
+		}
+	});
+
+	if (moved) {
+		boundsChanged = true;
+	}
+}
+
+const BoundingVolumeHierarchy& RenderManager::getStaticHierarchy() const {
+	if (hierarchyChanged) {
+		staticHierarchy.build(staticBounds);
+		hierarchyChanged = false;
+		boundsChanged = false;
+	}
+	else if (boundsChanged) {
+		staticHierarchy.refit(staticBounds);
+		boundsChanged = false;
+	}
+
+	return staticHierarchy;
 }
 
 void RenderManager::onComponentRemove(std::shared_ptr<Component> comp) {
 	std::shared_ptr<RenderComponent> renderComp = std::static_pointer_cast<RenderComponent>(comp);
 
-	removeComponent(renderComp.get(), renderComp->getModel());
 	auto compLoc = std::find(renderComponentSet.begin(), renderComponentSet.end(), comp.get());
 
 	if (compLoc != renderComponentSet.end()) {
-		*compLoc = renderComponentSet.back();
+		const size_t index = compLoc - renderComponentSet.begin();
+		const size_t last = renderComponentSet.size() - 1;
+
+		releaseBatch(componentBatches.at(index));
+		removeCullSlot(index);
+
+		//Move the last component into the removed one's place
+		if (index != last) {
+			renderComponentSet.at(index) = renderComponentSet.at(last);
+			componentBatches.at(index) = componentBatches.at(last);
+			componentStatic.at(index) = componentStatic.at(last);
+			componentSlots.at(index) = componentSlots.at(last);
+			componentLods.at(index) = componentLods.at(last);
+
+			std::vector<uint32_t>& cullList = componentStatic.at(index) ? staticComponents : dynamicComponents;
+			cullList.at(componentSlots.at(index)) = index;
+		}
+
 		renderComponentSet.pop_back();
+		componentBatches.pop_back();
+		componentStatic.pop_back();
+		componentSlots.pop_back();
+		componentLods.pop_back();
 	}
 	else {
 		throw std::runtime_error("Attempt to remove non-present render component");
@@ -48,48 +130,96 @@ void RenderManager::onComponentRemove(std::shared_ptr<Component> comp) {
 }
 
 void RenderManager::reloadComponent(const RenderComponent* renderComp, const Model& oldModel) {
-	const Model& model = renderComp->getModel();
+	auto compLoc = std::find(renderComponentSet.begin(), renderComponentSet.end(), renderComp);
+
+	if (compLoc == renderComponentSet.end()) {
+		throw std::runtime_error("Attempt to reload non-present render component");
+	}
+
+	const size_t index = compLoc - renderComponentSet.begin();
+	uint32_t& batch = componentBatches.at(index);
+
+	//Acquire first, so the batch isn't freed and recreated if the buffer and material didn't change.
+	const uint32_t newBatch = acquireBatch(renderComp->getModel());
+	releaseBatch(batch);
+	batch = newBatch;
+
+	//The new model might not have as many levels
+	componentLods.at(index) = 0;
 
-	removeComponent(renderComp, oldModel);
-	getComponentSet(model).push_back(renderComp);
+	//New materials might not be view culled, which static components need to be
+	if (renderComp->isStatic() != componentStatic.at(index)) {
+		removeCullSlot(index);
+		addCullSlot(index);
+	}
 }
 
-void RenderManager::removeComponent(const RenderComponent* comp, const Model& oldModel) {
-	std::vector<const RenderComponent*>& compSet = getComponentSet(oldModel);
+uint32_t RenderManager::acquireBatch(const Model& model) {
+	const Buffer* buffer = model.mesh->getBufferInfo().vertex;
+	auto& materialMap = batchIndices[buffer];
+	auto batchLoc = materialMap.find(model.material);
 
-	auto compLoc = std::find(compSet.begin(), compSet.end(), comp);
+	if (batchLoc != materialMap.end()) {
+		batches.at(batchLoc->second).users++;
+		return batchLoc->second;
+	}
 
-	if (compLoc != compSet.end()) {
-		*compLoc = compSet.back();
-		compSet.pop_back();
+	uint32_t batch = 0;
+
+	if (!freeBatches.empty()) {
+		batch = freeBatches.back();
+		freeBatches.pop_back();
 	}
 	else {
-		throw std::runtime_error("Attempt to remove non-present render component");
+		batch = batches.size();
+		batches.emplace_back();
 	}
 
-	if (compSet.empty()) {
-		const Buffer* buffer = oldModel.mesh->getBufferInfo().vertex;
-		const std::string& shader = oldModel.material->shader;
+	batches.at(batch) = RenderBatch{buffer, model.material, 1};
+	materialMap.emplace(model.material, batch);
 
-		renderComponents.at(buffer).at(shader).erase(oldModel.material);
-	}
+	return batch;
 }
 
-std::vector<const RenderComponent*>& RenderManager::getComponentSet(const Model& model) {
-	const Buffer* buffer = model.mesh->getBufferInfo().vertex;
-	const std::string& shader = model.material->shader;
+void RenderManager::releaseBatch(uint32_t batch) {
+	RenderBatch& renderBatch = batches.at(batch);
+	renderBatch.users--;
 
-	if (!renderComponents.count(buffer)) {
-		//It was inevitable.
-		renderComponents.emplace(buffer, std::unordered_map<std::string, std::unordered_map<const Material*, std::vector<const RenderComponent*>>>());
+	if (renderBatch.users == 0) {
+		batchIndices.at(renderBatch.buffer).erase(renderBatch.material);
+		freeBatches.push_back(batch);
 	}
+}
 
-	auto& shaderMap = renderComponents.at(buffer);
-	auto& modelMap = shaderMap[shader];
+void RenderManager::addCullSlot(size_t index) {
+	const RenderComponent* comp = renderComponentSet.at(index);
 
-	if (!modelMap.count(model.material)) {
-		modelMap.emplace(model.material, std::vector<const RenderComponent*>());
+	componentStatic.at(index) = comp->isStatic();
+
+	if (componentStatic.at(index)) {
+		componentSlots.at(index) = staticComponents.size();
+		staticComponents.push_back(index);
+		staticBounds.push_back(comp->getTickBounds());
+		hierarchyChanged = true;
+	}
+	else {
+		componentSlots.at(index) = dynamicComponents.size();
+		dynamicComponents.push_back(index);
 	}
+}
+
+void RenderManager::removeCullSlot(size_t index) {
+	const uint32_t slot = componentSlots.at(index);
+	std::vector<uint32_t>& cullList = componentStatic.at(index) ? staticComponents : dynamicComponents;
 
-	return modelMap.at(model.material);
+	//Swap with the last component in the list
+	cullList.at(slot) = cullList.back();
+	componentSlots.at(cullList.at(slot)) = slot;
+	cullList.pop_back();
+
+	if (componentStatic.at(index)) {
+		staticBounds.at(slot) = staticBounds.back();
+		staticBounds.pop_back();
+		hierarchyChanged = true;
+	}
 }
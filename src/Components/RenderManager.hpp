@@ -20,19 +20,29 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include <utility>
 
 #include "ComponentManager.hpp"
 #include "RenderComponent.hpp"
+#include "Renderer/BoundingVolumeHierarchy.hpp"
+
+//A group of render components that use the same buffer and material, and so can be drawn without rebinding anything.
+struct RenderBatch {
+	//The vertex buffer the meshes in the batch are in.
+	const Buffer* buffer;
+	//The material used by the batch.
+	const Material* material;
+	//Number of components in the batch, the batch is free for reuse when this is zero.
+	size_t users;
+};
 
 class RenderManager : public ComponentManager {
 public:
-	//Sorts the RenderComponents by buffer, then shader, then material.
-	typedef std::unordered_map<const Buffer*, std::unordered_map<std::string, std::unordered_map<const Material*, std::vector<const RenderComponent*>>>> RenderPassList;
-
 	/**
 	 * Constructor, sets name.
 	 */
-	RenderManager() : ComponentManager(RENDER_COMPONENT_NAME) {}
+	RenderManager() : ComponentManager(RENDER_COMPONENT_NAME), hierarchyChanged(false), boundsChanged(false) {}
 
 	/**
 	 * RenderComponents don't update.
@@ -40,10 +50,12 @@ public:
 	void update() override {}
 
 	/**
-	 * Gets a sorted list of all render components (by buffer, then shader, then model).
-	 * @return A sorted list of render components.
+	 * Stores the current transform of every render component, for interpolation
+	 * during rendering. Called by the screen once all other managers have updated.
+	 * Also updates the bounds of static components, and moves components whose physics
+	 * changed between the static and dynamic lists.
 	 */
-	const RenderPassList& getComponentList() const { return renderComponents; }
+	void snapshotTransforms();
 
 	/**
 	 * Returns an unsorted set of all render components.
@@ -52,17 +64,84 @@ public:
 	const std::vector<const RenderComponent*>& getComponentSet() const { return renderComponentSet; }
 
 	/**
-	 * Removes and readds the component to the render component list.
+	 * Gets the batch of each render component, in the same order as getComponentSet.
+	 * @return The batch index of each component.
+	 */
+	const std::vector<uint32_t>& getComponentBatches() const { return componentBatches; }
+
+	/**
+	 * Gets the level of detail each render component was last drawn with, in the same order as
+	 * getComponentSet. Written by the renderer while culling, by whichever thread culls the component.
+	 * @return The level of each component, 0 for the full mesh, otherwise 1 + the index into the model's lods.
+	 */
+	std::vector<uint32_t>& getComponentLods() { return componentLods; }
+
+	/**
+	 * Gets all batches, indexed by the values in getComponentBatches. Batches with
+	 * no users are unused, and might be reused for a different buffer and material later.
+	 * @return The batch list.
+	 */
+	const std::vector<RenderBatch>& getBatches() const { return batches; }
+
+	/**
+	 * Gets the indices in getComponentSet of components that are culled one at a time,
+	 * because they might move at any time.
+	 * @return The dynamic component indices.
+	 */
+	const std::vector<uint32_t>& getDynamicComponents() const { return dynamicComponents; }
+
+	/**
+	 * Gets the indices in getComponentSet of components that are culled with the static
+	 * hierarchy, indexed by the ids returned from the hierarchy.
+	 * @return The static component indices.
+	 */
+	const std::vector<uint32_t>& getStaticComponents() const { return staticComponents; }
+
+	/**
+	 * Gets the bounding volume hierarchy for static components, up to date as of the last tick.
+	 * The hierarchy is rebuilt or refit here if static components were added, removed, or
+	 * moved since it was last retrieved, so its ids always match getStaticComponents.
+	 * @return The static hierarchy.
+	 */
+	const BoundingVolumeHierarchy& getStaticHierarchy() const;
+
+	/**
+	 * Moves the component to the batch for its new model.
 	 * @param renderComp The component to reload.
 	 * @param oldModel The model the component previously used.
 	 */
 	void reloadComponent(const RenderComponent* renderComp, const Model& oldModel);
 
 private:
-	//Sorts all RenderComponents by their shader for less context switching.
-	RenderPassList renderComponents;
 	//A set of all RenderComponents, to avoid unneccessary casting.
 	std::vector<const RenderComponent*> renderComponentSet;
+	//The batch of each component in renderComponentSet.
+	std::vector<uint32_t> componentBatches;
+	//The level of detail chosen by the renderer for each component in renderComponentSet, kept between
+	//frames so it only changes once the component's size is clearly past a level's threshold.
+	std::vector<uint32_t> componentLods;
+	//All batches, used or not.
+	std::vector<RenderBatch> batches;
+	//Unused batch indices.
+	std::vector<uint32_t> freeBatches;
+	//Batch index for each buffer and material pair currently in use.
+	std::unordered_map<const Buffer*, std::unordered_map<const Material*, uint32_t>> batchIndices;
+	//Whether each component in renderComponentSet is static, see RenderComponent::isStatic.
+	std::vector<bool> componentStatic;
+	//Index of each component in either staticComponents or dynamicComponents.
+	std::vector<uint32_t> componentSlots;
+	//Indices of static and dynamic components in renderComponentSet.
+	std::vector<uint32_t> staticComponents;
+	std::vector<uint32_t> dynamicComponents;
+	//Bounds of each static component as of the last tick.
+	std::vector<Aabb<float>> staticBounds;
+	//Hierarchy over the static components, for culling. Only updated when retrieved,
+	//as components can be removed after the tick's snapshot.
+	mutable BoundingVolumeHierarchy staticHierarchy;
+	//Whether static components were added or removed since the hierarchy was last built.
+	mutable bool hierarchyChanged;
+	//Whether any static bounds changed since the hierarchy was last built or refit.
+	mutable bool boundsChanged;
 
 	/**
 	 * Adds the component to one of the internal lists based on its model.
@@ -77,18 +156,27 @@ private:
 	void onComponentRemove(std::shared_ptr<Component> comp) override;
 
 	/**
-	 * Removes a render component from the manager, and clears its model
-	 * if it is not used by anything else.
-	 * @param comp The component to remove.
-	 * @param oldModel The old model of the render component, or just the
-	 *     model if the component is being removed completely.
+	 * Gets the batch for the given model, creating it if needed, and adds a user to it.
+	 * @param model The model to get the batch for.
+	 * @return The batch's index.
+	 */
+	uint32_t acquireBatch(const Model& model);
+
+	/**
+	 * Removes a user from a batch, freeing it if it has no more users.
+	 * @param batch The batch's index.
+	 */
+	void releaseBatch(uint32_t batch);
+
+	/**
+	 * Adds a component to the static or dynamic list, depending on whether it's static.
+	 * @param index The component's index in renderComponentSet.
 	 */
-	void removeComponent(const RenderComponent* comp, const Model& oldModel);
+	void addCullSlot(size_t index);
 
 	/**
-	 * Helper function to get the set a component belongs in.
-	 * @param model The model of the render component to fetch the set for.
-	 * @return The set the component belongs in.
+	 * Removes a component from the static or dynamic list.
+	 * @param index The component's index in renderComponentSet.
 	 */
-	std::vector<const RenderComponent*>& getComponentSet(const Model& model);
+	void removeCullSlot(size_t index);
 };
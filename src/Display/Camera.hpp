@@ -20,11 +20,14 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "Events/EventListener.hpp"
 
 class Camera : public EventListener {
 public:
+	Camera() : hasSnapshot(false), renderView(1.0f) {}
+
 	virtual ~Camera() {}
 
 	/**
@@ -57,4 +60,60 @@ public:
 	 * Updates the camera.
 	 */
 	virtual void update() = 0;
+
+	/**
+	 * Stores the camera's current position and rotation for interpolation.
+	 * Called by the screen after the camera is updated each tick.
+	 */
+	void snapshotView() {
+		const glm::mat4 world = glm::inverse(getView());
+
+		prevPos = currentPos;
+		prevRotation = currentRotation;
+		currentPos = glm::vec3(world[3]);
+		currentRotation = glm::quat_cast(glm::mat3(world));
+
+		//Don't interpolate from wherever the camera was before it was first snapshotted.
+		if (!hasSnapshot) {
+			prevPos = currentPos;
+			prevRotation = currentRotation;
+			hasSnapshot = true;
+		}
+	}
+
+	/**
+	 * Calculates the view matrix to render with, based on how far the renderer is between
+	 * the last tick and the next one. Called by the rendering engine before each frame.
+	 * Views are assumed to only rotate and translate, like ones made with glm::lookAt.
+	 * @param partialTicks The fraction of a tick that has passed since the last one, [0, 1).
+	 */
+	void interpolateView(float partialTicks) const {
+		if (!hasSnapshot) {
+			renderView = getView();
+			return;
+		}
+
+		const glm::vec3 pos = glm::mix(prevPos, currentPos, partialTicks);
+		const glm::quat rotation = glm::slerp(prevRotation, currentRotation, partialTicks);
+
+		renderView = glm::inverse(glm::translate(glm::mat4(1.0f), pos) * glm::mat4_cast(rotation));
+	}
+
+	/**
+	 * Gets the view matrix for the current frame, as calculated by interpolateView.
+	 * @return The interpolated view matrix.
+	 */
+	const glm::mat4& getRenderView() const { return renderView; }
+
+private:
+	//Whether the view has been snapshotted yet.
+	bool hasSnapshot;
+	//The camera's position and rotation as of the tick before last.
+	glm::vec3 prevPos;
+	glm::quat prevRotation;
+	//The camera's position and rotation as of the last tick.
+	glm::vec3 currentPos;
+	glm::quat currentRotation;
+	//The interpolated view for the current frame.
+	mutable glm::mat4 renderView;
 };
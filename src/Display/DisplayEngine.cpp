@@ -130,7 +130,7 @@ void DisplayEngine::render(float partialTicks) {
 
 	//Render all screens in the overlay stack from bottom to top.
 	for (std::shared_ptr<Screen> screen : screenStack.back()) {
-		renderer->render(screen.get());
+		renderer->render(screen.get(), partialTicks);
 	}
 
 	renderer->present();
@@ -66,6 +66,23 @@ public:
 		}
 	}
 
+	/**
+	 * Same as above, but for const objects.
+	 * @param name The name of the component.
+	 * @return A pointer to the component for this object, will be null if the component isn't found.
+	 */
+	template <typename T>
+	std::shared_ptr<const T> getComponent(const std::string& name = T::getName()) const {
+		static_assert(std::is_base_of<Component, T>::value, "Object::getComponent called with non-component type");
+
+		if (components.count(name)) {
+			return std::static_pointer_cast<const T>(components.at(name));
+		}
+		else {
+			return std::shared_ptr<const T>();
+		}
+	}
+
 	/**
 	 * Constructs a pointer to a component and adds it to the object.
 	 * @param args The arguments to one of the constructors of T.
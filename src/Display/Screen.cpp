@@ -44,6 +44,13 @@ Screen::Screen(DisplayEngine& display, bool hideMouse) :
 void Screen::update() {
 	//Skip update if paused
 	if (paused) {
+		//Still need to catch up with the last tick, or paused objects would keep moving between their last two positions.
+		if (renderManager) {
+			renderManager->snapshotTransforms();
+		}
+
+		camera->snapshotView();
+
 		return;
 	}
 
@@ -60,8 +67,14 @@ void Screen::update() {
 		manager->update();
 	}
 
-	//Update camera
+	//Update camera, and store its new position for interpolation
 	camera->update();
+	camera->snapshotView();
+
+	//Store the new object positions for interpolation
+	if (renderManager) {
+		renderManager->snapshotTransforms();
+	}
 
 	//Remove queued objects
 	std::shared_ptr<Object> toRemove;
@@ -56,6 +56,7 @@ Engine* Engine::instance = nullptr;
 Engine::Engine(const EngineConfig& config) :
 	config(config),
 	logger(config.generalLog),
+	shapeCache(),
 	display(),
 	modelManager(config.modelLog),
 	modelLoader(config.modelLog, modelManager),
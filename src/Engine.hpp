@@ -28,6 +28,7 @@
 #include "FontManager.hpp"
 #include "Renderer/WindowSystemInterface.hpp"
 #include "Models/ModelLoader.hpp"
+#include "Components/PhysicsShapeCache.hpp"
 
 class RenderingEngine;
 class GameInterface;
@@ -116,6 +117,12 @@ public:
 	 */
 	FontManager& getFontManager() { return fontManager; }
 
+	/**
+	 * Gets the cache used to share collision shapes between physics objects.
+	 * @return The physics shape cache.
+	 */
+	PhysicsShapeCache& getPhysicsShapeCache() { return shapeCache; }
+
 	/**
 	 * Execute for loop in parallel.
 	 * @param begin The starting value.
@@ -138,6 +145,9 @@ private:
 	const EngineConfig config;
 	//The place the engine logs messages to.
 	Logger logger;
+	//Shared collision shapes for physics objects. Needs to be destroyed after
+	//the display, as the screens' physics objects reference it.
+	PhysicsShapeCache shapeCache;
 	//The display manager. Handles rendering, updating, and input for multiple "screens" (game world, huds, menus, etc) at once.
 	//Name seems a bit misleading.
 	DisplayEngine display;
@@ -76,4 +76,9 @@ struct EngineConfig {
 	LogConfig modelLog;
 	//Logger for components.
 	LogConfig componentLog;
+	//Maximum number of threads the physics engine uses for simulation, 0 to use all available.
+	size_t physicsThreads;
+	//Directory to store generated physics data in, such as triangle mesh bvhs, so it doesn't
+	//need to be rebuilt every launch (this should include the final '/'). Leave empty to disable.
+	std::string physicsCacheDir;
 };
@@ -19,7 +19,7 @@
 #include "Material.hpp"
 #include "ModelManager.hpp"
 
-Material::Material(const std::string& name, const std::string& shader, const std::string& uniformSet, const UniformSet& uniformSetLayout, bool viewCull)  :
+Material::Material(const std::string& name, const std::string& shader, const std::string& uniformSet, const UniformSet& uniformSetLayout, bool viewCull, bool occluder)  :
 	name(name),
 	shader(shader),
 	uniformSet(uniformSet),
@@ -27,6 +27,7 @@ Material::Material(const std::string& name, const std::string& shader, const std
 	hasBufferedUniforms(!uniformSetLayout.getBufferedUniforms().empty()),
 	textures(),
 	viewCull(viewCull),
+	occluder(occluder),
 	references(0) {
 
 }
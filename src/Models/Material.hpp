@@ -36,8 +36,9 @@ public:
 	 * @param uniformSet The name of the uniform set used in the material.
 	 * @param uniformData Values for the buffered uniforms in the material.
 	 * @param viewCull Whether to use view culling with this material.
+	 * @param occluder Whether objects using this material hide other objects during occlusion culling.
 	 */
-	Material(const std::string& name, const std::string& shader, const std::string& uniformSet, const UniformSet& uniformSetLayout, bool viewCull = true);
+	Material(const std::string& name, const std::string& shader, const std::string& uniformSet, const UniformSet& uniformSetLayout, bool viewCull = true, bool occluder = false);
 
 	//Name of the material.
 	std::string name;
@@ -53,6 +54,9 @@ public:
 	std::vector<std::string> textures;
 	//Whether to use view culling with the material.
 	bool viewCull;
+	//Whether meshes with this material are drawn into the occlusion buffer. Best used for
+	//large, solid, low-poly objects like walls and terrain.
+	bool occluder;
 
 	//Amount of references this material has.
 	size_t references;
@@ -136,6 +136,15 @@ private:
 	int32_t vertexOffset;
 };
 
+//A simplified version of a mesh, used for objects that cover little of the screen.
+struct MeshLod {
+	//The simplified mesh, stored in the same buffers as the full mesh.
+	Mesh mesh;
+	//The object's projected diameter, as a fraction of the screen's height,
+	//below which this level is used.
+	float screenSize;
+};
+
 class MeshRef {
 public:
 	/**
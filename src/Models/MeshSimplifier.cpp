@@ -0,0 +1,292 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <unordered_map>
+#include <queue>
+#include <cstring>
+#include <cmath>
+
+#include "MeshSimplifier.hpp"
+
+namespace {
+	typedef std::array<double, 3> Vec3d;
+
+	Vec3d subtract(const Vec3d& a, const Vec3d& b) {
+		return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+	}
+
+	Vec3d cross(const Vec3d& a, const Vec3d& b) {
+		return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+	}
+
+	double dot(const Vec3d& a, const Vec3d& b) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	/**
+	 * Gets the unnormalized normal of a triangle, which has a length of twice its area.
+	 */
+	Vec3d triangleNormal(const Vec3d& p0, const Vec3d& p1, const Vec3d& p2) {
+		return cross(subtract(p1, p0), subtract(p2, p0));
+	}
+
+	/**
+	 * Adds the vertices of a vertex's undeleted triangles, other than itself, to a list.
+	 */
+	void getNeighbours(uint32_t vertex, const std::vector<uint32_t>& vertexTriangles, const std::vector<uint32_t>& triangles, const std::vector<bool>& removed, std::vector<uint32_t>& out) {
+		out.clear();
+
+		for (uint32_t tri : vertexTriangles) {
+			if (removed[tri]) {
+				continue;
+			}
+
+			for (size_t i = 0; i < 3; i++) {
+				if (triangles[3 * tri + i] != vertex) {
+					out.push_back(triangles[3 * tri + i]);
+				}
+			}
+		}
+
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+}
+
+MeshSimplifier::MeshSimplifier(const unsigned char* positionData, size_t stride, size_t vertexCount, const std::vector<uint32_t>& indices) :
+	positions(vertexCount),
+	indices(indices),
+	quadrics(vertexCount),
+	locked(vertexCount, false) {
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		float pos[3];
+		std::memcpy(pos, positionData + i * stride, sizeof(pos));
+
+		positions[i] = {pos[0], pos[1], pos[2]};
+	}
+
+	//Every triangle adds its plane to its vertices, weighted by its area so tiny triangles don't dominate
+	for (size_t tri = 0; tri < indices.size() / 3; tri++) {
+		const uint32_t* vertices = &indices[3 * tri];
+		const Vec3d normal = triangleNormal(positions[vertices[0]], positions[vertices[1]], positions[vertices[2]]);
+		const double length = std::sqrt(dot(normal, normal));
+
+		if (length <= 0.0) {
+			continue;
+		}
+
+		const double area = length / 2.0;
+		const double a = normal[0] / length;
+		const double b = normal[1] / length;
+		const double c = normal[2] / length;
+		const double d = -dot({a, b, c}, positions[vertices[0]]);
+		const Quadric plane = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+
+		for (size_t i = 0; i < 3; i++) {
+			Quadric& quadric = quadrics[vertices[i]];
+
+			for (size_t j = 0; j < quadric.size(); j++) {
+				quadric[j] += plane[j] * area;
+			}
+		}
+	}
+
+	//Edges that don't have exactly two triangles are open or non-manifold
+	std::unordered_map<uint64_t, uint32_t> edgeUsers;
+
+	for (size_t i = 0; i < indices.size(); i++) {
+		const uint64_t v0 = indices[i];
+		const uint64_t v1 = indices[i - i % 3 + (i + 1) % 3];
+
+		edgeUsers[(std::min(v0, v1) << 32) | std::max(v0, v1)]++;
+	}
+
+	for (const std::pair<const uint64_t, uint32_t>& edge : edgeUsers) {
+		if (edge.second != 2) {
+			locked[edge.first >> 32] = true;
+			locked[edge.first & 0xFFFFFFFF] = true;
+		}
+	}
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(size_t targetTriangles) const {
+	const size_t vertexCount = positions.size();
+
+	std::vector<uint32_t> triangles(indices);
+	std::vector<bool> removed(triangles.size() / 3, false);
+	size_t triangleCount = removed.size();
+
+	std::vector<Quadric> vertexQuadrics(quadrics);
+	std::vector<bool> collapsed(vertexCount, false);
+	//Incremented whenever a vertex's quadric changes, to find outdated collapses.
+	std::vector<uint32_t> versions(vertexCount, 0);
+	std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+
+	for (size_t i = 0; i < triangles.size(); i++) {
+		vertexTriangles[triangles[i]].push_back(i / 3);
+	}
+
+	std::priority_queue<Collapse> queue;
+
+	auto addCollapse = [&](uint32_t from, uint32_t to) {
+		if (locked[from]) {
+			return;
+		}
+
+		Quadric sum = vertexQuadrics[from];
+
+		for (size_t i = 0; i < sum.size(); i++) {
+			sum[i] += vertexQuadrics[to][i];
+		}
+
+		queue.push({getError(sum, positions[to]), from, to, versions[from], versions[to]});
+	};
+
+	for (size_t i = 0; i < triangles.size(); i++) {
+		const uint32_t v0 = triangles[i];
+		const uint32_t v1 = triangles[i - i % 3 + (i + 1) % 3];
+
+		addCollapse(v0, v1);
+		addCollapse(v1, v0);
+	}
+
+	std::vector<uint32_t> fromNeighbours;
+	std::vector<uint32_t> toNeighbours;
+	std::vector<uint32_t> sharedNeighbours;
+
+	while (triangleCount > targetTriangles && !queue.empty()) {
+		const Collapse collapse = queue.top();
+		queue.pop();
+
+		const uint32_t from = collapse.from;
+		const uint32_t to = collapse.to;
+
+		//A vertex changed since this was queued, and a newer version of it was queued when it did
+		if (collapsed[from] || collapsed[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) {
+			continue;
+		}
+
+		//Collapsing an edge removes its two triangles. If the vertices have any other neighbours in common,
+		//the collapse would fold the surface onto itself.
+		getNeighbours(from, vertexTriangles[from], triangles, removed, fromNeighbours);
+		getNeighbours(to, vertexTriangles[to], triangles, removed, toNeighbours);
+
+		sharedNeighbours.clear();
+		std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(sharedNeighbours));
+
+		size_t sharedTriangles = 0;
+		bool flips = false;
+
+		for (uint32_t tri : vertexTriangles[from]) {
+			if (removed[tri]) {
+				continue;
+			}
+
+			const uint32_t* vertices = &triangles[3 * tri];
+
+			if (vertices[0] == to || vertices[1] == to || vertices[2] == to) {
+				sharedTriangles++;
+				continue;
+			}
+
+			//Triangles that stay can't flip over or become degenerate
+			std::array<Vec3d, 3> moved = {positions[vertices[0]], positions[vertices[1]], positions[vertices[2]]};
+			const Vec3d oldNormal = triangleNormal(moved[0], moved[1], moved[2]);
+
+			for (size_t i = 0; i < 3; i++) {
+				if (vertices[i] == from) {
+					moved[i] = positions[to];
+				}
+			}
+
+			const Vec3d newNormal = triangleNormal(moved[0], moved[1], moved[2]);
+
+			if (dot(oldNormal, newNormal) <= 0.0 || dot(newNormal, newNormal) <= 0.0) {
+				flips = true;
+				break;
+			}
+		}
+
+		if (flips || sharedTriangles == 0 || sharedNeighbours.size() != sharedTriangles) {
+			continue;
+		}
+
+		//Move everything from the removed vertex onto the other one
+		for (uint32_t tri : vertexTriangles[from]) {
+			if (removed[tri]) {
+				continue;
+			}
+
+			uint32_t* vertices = &triangles[3 * tri];
+
+			if (vertices[0] == to || vertices[1] == to || vertices[2] == to) {
+				removed[tri] = true;
+				triangleCount--;
+				continue;
+			}
+
+			std::replace(vertices, vertices + 3, from, to);
+			vertexTriangles[to].push_back(tri);
+		}
+
+		vertexTriangles[from].clear();
+		collapsed[from] = true;
+
+		for (size_t i = 0; i < vertexQuadrics[to].size(); i++) {
+			vertexQuadrics[to][i] += vertexQuadrics[from][i];
+		}
+
+		versions[to]++;
+
+		//Every collapse involving the merged vertex has a new cost
+		getNeighbours(to, vertexTriangles[to], triangles, removed, toNeighbours);
+
+		for (uint32_t neighbour : toNeighbours) {
+			versions[neighbour]++;
+		}
+
+		for (uint32_t neighbour : toNeighbours) {
+			addCollapse(neighbour, to);
+			addCollapse(to, neighbour);
+		}
+	}
+
+	std::vector<uint32_t> out;
+	out.reserve(triangleCount * 3);
+
+	for (size_t tri = 0; tri < removed.size(); tri++) {
+		if (!removed[tri]) {
+			out.insert(out.end(), triangles.begin() + 3 * tri, triangles.begin() + 3 * tri + 3);
+		}
+	}
+
+	return out;
+}
+
+double MeshSimplifier::getError(const Quadric& q, const std::array<double, 3>& pos) {
+	const double x = pos[0];
+	const double y = pos[1];
+	const double z = pos[2];
+
+	return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+		+ q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+		+ q[7] * z * z + 2.0 * q[8] * z
+		+ q[9];
+}
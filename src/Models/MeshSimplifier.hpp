@@ -0,0 +1,90 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+//Reduces the triangle count of an indexed triangle mesh using quadric error metrics (Garland and Heckbert).
+//Vertices are only ever collapsed onto one of their neighbours, so the simplified mesh uses a subset of
+//the original vertices and keeps all of their other attributes. Vertices on open edges, which includes
+//seams where vertices were split for different normals or texture coordinates, never move, so holes
+//don't grow and seams don't tear. Only positions are read, so any vertex format works.
+class MeshSimplifier {
+public:
+	/**
+	 * Prepares a mesh for simplification. The provided data must stay valid for the simplifier's lifetime.
+	 * @param positions Pointer to the first vertex's position, three floats.
+	 * @param stride The distance between positions, in bytes.
+	 * @param vertexCount The number of vertices.
+	 * @param indices The mesh's triangle list.
+	 */
+	MeshSimplifier(const unsigned char* positions, size_t stride, size_t vertexCount, const std::vector<uint32_t>& indices);
+
+	/**
+	 * Collapses edges, cheapest first, until the mesh has at most the given number of triangles or
+	 * nothing else can be collapsed without flipping a triangle. Safe to call from multiple threads.
+	 * @param targetTriangles The number of triangles to stop at.
+	 * @return The triangle list of the simplified mesh, using the original vertex indices.
+	 */
+	std::vector<uint32_t> simplify(size_t targetTriangles) const;
+
+private:
+	//Symmetric 4x4 matrix, stored as its upper triangle.
+	typedef std::array<double, 10> Quadric;
+
+	//A possible collapse of one vertex onto another.
+	struct Collapse {
+		//The error the collapse adds.
+		double cost;
+		//The vertex that is removed.
+		uint32_t from;
+		//The vertex it is moved onto.
+		uint32_t to;
+		//Versions of both vertices when the cost was calculated.
+		uint32_t fromVersion;
+		uint32_t toVersion;
+
+		/**
+		 * Orders collapses with the cheapest first in a priority queue.
+		 * @param other The collapse to compare with.
+		 * @return Whether this collapse is more expensive.
+		 */
+		bool operator<(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	//Vertex positions, converted from the mesh's format.
+	std::vector<std::array<double, 3>> positions;
+	//The original triangle list.
+	const std::vector<uint32_t>& indices;
+	//Error quadric for each vertex, the sum of the planes of the triangles around it.
+	std::vector<Quadric> quadrics;
+	//Whether each vertex is on an open edge, and so can't be moved.
+	std::vector<bool> locked;
+
+	/**
+	 * Calculates the error of moving a vertex with the given quadric to a position.
+	 * @param quadric The quadric.
+	 * @param pos The position.
+	 * @return The error.
+	 */
+	static double getError(const Quadric& quadric, const std::array<double, 3>& pos);
+};
@@ -23,6 +23,7 @@
 #include "ModelManager.hpp"
 #include "Engine.hpp"
 #include "MeshBuilder.hpp"
+#include "MeshSimplifier.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -30,7 +31,7 @@
 void ModelLoader::loadMaterial(const std::string& name, const MaterialCreateInfo& matInfo) {
 	const UniformSet& matSet = modelManager.getMemoryManager()->getUniformSet(matInfo.uniformSet);
 
-	Material material(name, matInfo.shader, matInfo.uniformSet, matSet, matInfo.viewCull);
+	Material material(name, matInfo.shader, matInfo.uniformSet, matSet, matInfo.viewCull, matInfo.occluder);
 
 	//Someone should probably change this to unordered...
 	std::map<std::string, int> matMap;
@@ -118,7 +119,29 @@ void ModelLoader::loadMesh(const std::string& name, const MeshCreateInfo& meshIn
 	ENGINE_LOG_DEBUG(logger, "Calculated box " + mesh.getBox().toString() + " for mesh " + name);
 	ENGINE_LOG_DEBUG(logger, "Radius of mesh is " + std::to_string(mesh.getRadius()));
 
-	modelManager.addMesh(name, std::move(mesh), true);
+	std::vector<MeshLod> lods;
+
+	if (meshInfo.renderable) {
+		if (!meshInfo.lodFiles.empty()) {
+			for (const std::string& lodFile : meshInfo.lodFiles) {
+				lods.push_back({loadFromDisk(Engine::instance->getConfig().resourceBase + lodFile, format, bufferInfo), 0.0f});
+			}
+		}
+		else if (meshInfo.lodLevels > 0) {
+			lods = generateLods(mesh, meshInfo.lodLevels);
+		}
+
+		float screenSize = meshInfo.lodScreenSize;
+
+		for (MeshLod& lod : lods) {
+			lod.screenSize = screenSize;
+			screenSize /= 2.0f;
+
+			ENGINE_LOG_DEBUG(logger, "Level of detail for mesh " + name + " has " + std::to_string(std::get<2>(lod.mesh.getMeshData()).size() / 3) + " triangles");
+		}
+	}
+
+	modelManager.addMesh(name, std::move(mesh), true, std::move(lods));
 	ENGINE_LOG_DEBUG(logger, "Loaded mesh \"" + Engine::instance->getConfig().resourceBase + meshInfo.filename + "\" as \"" + name + "\"");
 }
 
@@ -185,3 +208,58 @@ Mesh ModelLoader::loadFromDisk(const std::string& filename, const VertexFormat*
 
 	return meshBuild.genMesh(bufferInfo);
 }
+
+std::vector<MeshLod> ModelLoader::generateLods(const Mesh& mesh, size_t levels) {
+	const VertexFormat* format = mesh.getFormat();
+
+	if (!format->hasElement(VERTEX_ELEMENT_POSITION) || !format->checkType(VERTEX_ELEMENT_POSITION, VertexFormat::ElementType::VEC3)) {
+		ENGINE_LOG_WARN(logger, "Can't generate levels of detail for a mesh without positions");
+		return {};
+	}
+
+	const auto meshData = mesh.getMeshData();
+	const unsigned char* vertices = std::get<0>(meshData);
+	const size_t vertexSize = format->getVertexSize();
+	const size_t vertexCount = std::get<1>(meshData) / vertexSize;
+	const std::vector<uint32_t>& indices = std::get<2>(meshData);
+	const size_t triangleCount = indices.size() / 3;
+
+	const MeshSimplifier simplifier(vertices + format->getElementOffset(VERTEX_ELEMENT_POSITION), vertexSize, vertexCount, indices);
+	std::vector<std::vector<uint32_t>> levelIndices(levels);
+
+	//Each level is simplified from the full mesh, so they can all be done at once
+	Engine::parallelFor(0, levels, [&](size_t level) {
+		levelIndices.at(level) = simplifier.simplify(triangleCount >> (level + 1));
+	}, 1);
+
+	std::vector<MeshLod> lods;
+	size_t lastTriangles = triangleCount;
+
+	for (std::vector<uint32_t>& lodIndices : levelIndices) {
+		//Levels that barely changed aren't worth the memory, and
+		//neither is anything after them.
+		if (lodIndices.empty() || lodIndices.size() / 3 > lastTriangles * 3 / 4) {
+			break;
+		}
+
+		lastTriangles = lodIndices.size() / 3;
+
+		//Only keep the vertices the level still uses
+		std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+		std::vector<unsigned char> lodVertices;
+
+		for (uint32_t& index : lodIndices) {
+			if (remap.at(index) == UINT32_MAX) {
+				remap.at(index) = lodVertices.size() / vertexSize;
+				lodVertices.insert(lodVertices.end(), vertices + index * vertexSize, vertices + (index + 1) * vertexSize);
+			}
+
+			index = remap.at(index);
+		}
+
+		//Bounds stay the same as the full mesh, so culling doesn't change between levels
+		lods.push_back({Mesh(mesh.getBufferInfo(), format, std::move(lodVertices), std::move(lodIndices), mesh.getBox(), mesh.getRadius()), 0.0f});
+	}
+
+	return lods;
+}
@@ -39,6 +39,9 @@ struct MaterialCreateInfo {
 	//Whether to perform view culling for this material. Is this the right
 	//place for this?
 	bool viewCull;
+	//Whether objects with this material hide the objects behind them during occlusion
+	//culling. Large, simple meshes make the best occluders.
+	bool occluder = false;
 };
 
 struct MeshCreateInfo {
@@ -53,6 +56,15 @@ struct MeshCreateInfo {
 	//Whether the mesh is intended to be rendered. If false, the vertexBuffer
 	//and indexBuffer parameters will be ignored.
 	bool renderable;
+	//The number of simplified levels of detail to generate for the mesh, each with about
+	//half the triangles of the one before. Ignored for meshes that aren't renderable.
+	size_t lodLevels = 0;
+	//Files to load the levels of detail from, most detailed first. If not empty, these are
+	//used instead of generating levels, for meshes simplified offline.
+	std::vector<std::string> lodFiles;
+	//The screen size (see MeshLod) to switch to the first level at. Each level after
+	//that switches at half the size of the one before.
+	float lodScreenSize = 0.25f;
 };
 
 //Lots of material names, to prevent mistyping.
@@ -137,4 +149,13 @@ protected:
 	 * @throw runtime_error if model loading failed.
 	 */
 	Mesh loadFromDisk(const std::string& filename, const VertexFormat* format, const Mesh::BufferInfo bufferInfo);
+
+	/**
+	 * Generates simplified versions of a mesh, in parallel. Levels stop early if the
+	 * mesh can't be simplified any further.
+	 * @param mesh The full mesh.
+	 * @param levels The maximum number of levels to generate.
+	 * @return The simplified meshes, most detailed first, without screen sizes set.
+	 */
+	std::vector<MeshLod> generateLods(const Mesh& mesh, size_t levels);
 };
@@ -27,6 +27,7 @@ Model ModelManager::getModel(const std::string& material, const std::string& mes
 	return Model{
 		.material = matRef->getMaterial(),
 		.mesh = meshRef->getMesh(),
+		.lods = &meshMap.at(mesh).lods,
 		.matRef = matRef,
 		.meshRef = meshRef,
 	};
@@ -47,6 +48,10 @@ std::shared_ptr<MeshRef> ModelManager::getMesh(const std::string& meshName, Cach
 		}
 
 		memoryManager->addMesh(&mesh);
+
+		for (MeshLod& lod : meshData.lods) {
+			memoryManager->addMesh(&lod.mesh);
+		}
 	}
 
 	return std::make_shared<MeshRef>(this, meshName, &mesh, level);
@@ -66,6 +71,10 @@ void ModelManager::removeMeshReference(const std::string meshName, CacheLevel le
 		if (mesh.isForRendering() && level == CacheLevel::GPU) {
 			ENGINE_LOG_DEBUG(logger, "Removing unused mesh \"" + meshName + "\" from vertex buffers...");
 			memoryManager->freeMesh(&mesh, meshData.persist);
+
+			for (const MeshLod& lod : meshData.lods) {
+				memoryManager->freeMesh(&lod.mesh, meshData.persist);
+			}
 		}
 
 		//If mesh is not persistent, completely remove it
@@ -32,6 +32,8 @@ struct Model {
 	//only guaranteed to work while said references exist.
 	const Material* material;
 	const Mesh* mesh;
+	//Simplified versions of the mesh, most detailed first. Empty if the mesh has none.
+	const std::vector<MeshLod>* lods;
 
 	//Only used for reference counting.
 	std::shared_ptr<MaterialRef> matRef;
@@ -102,9 +104,11 @@ public:
 	 * @param name The name to store the mesh under.
 	 * @param mesh The mesh to add.
 	 * @param persist Whether to keep the mesh when it becomes unused.
+	 * @param lods Simplified versions of the mesh, most detailed first. These are
+	 *     uploaded and removed along with the mesh.
 	 */
-	void addMesh(const std::string& name, Mesh&& mesh, bool persist) {
-		meshMap.emplace(name, MeshData{std::move(mesh), std::array<size_t, CacheLevel::NUM_LEVELS>{}, persist});
+	void addMesh(const std::string& name, Mesh&& mesh, bool persist, std::vector<MeshLod>&& lods = {}) {
+		meshMap.emplace(name, MeshData{std::move(mesh), std::move(lods), std::array<size_t, CacheLevel::NUM_LEVELS>{}, persist});
 		ENGINE_LOG_INFO(logger, "Added mesh \"" + name + "\"");
 	}
 
@@ -172,6 +176,8 @@ private:
 	struct MeshData {
 		//The stored mesh.
 		Mesh mesh;
+		//The mesh's levels of detail.
+		std::vector<MeshLod> lods;
 		//Number of users for the mesh on each cache level.
 		std::array<size_t, CacheLevel::NUM_LEVELS> users;
 		//Whether the mesh stays loaded when it has no users.
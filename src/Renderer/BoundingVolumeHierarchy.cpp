@@ -0,0 +1,245 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <array>
+#include <stdexcept>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "BoundingVolumeHierarchy.hpp"
+
+namespace {
+	/**
+	 * Creates a box that contains nothing, so that combining it with another box gives
+	 * the other box.
+	 * @return The empty box.
+	 */
+	Aabb<float> emptyBox() {
+		Aabb<float> box;
+		box.min = glm::vec3(std::numeric_limits<float>::infinity());
+		box.max = glm::vec3(-std::numeric_limits<float>::infinity());
+
+		return box;
+	}
+}
+
+void BoundingVolumeHierarchy::build(const std::vector<Aabb<float>>& bounds) {
+	nodes.clear();
+	items.resize(bounds.size());
+	std::iota(items.begin(), items.end(), 0);
+
+	if (!bounds.empty()) {
+		Aabb<float> rootBox = emptyBox();
+
+		for (const Aabb<float>& box : bounds) {
+			rootBox = Aabb<float>(rootBox, box);
+		}
+
+		nodes.push_back({rootBox, 0, (uint32_t) bounds.size(), 0});
+		split(0, bounds);
+	}
+
+	itemBounds.resize(items.size());
+
+	for (size_t i = 0; i < items.size(); i++) {
+		itemBounds.at(i) = bounds.at(items.at(i));
+	}
+}
+
+void BoundingVolumeHierarchy::refit(const std::vector<Aabb<float>>& bounds) {
+	if (bounds.size() != items.size()) {
+		throw std::runtime_error("Item count changed without rebuilding hierarchy!");
+	}
+
+	for (size_t i = 0; i < items.size(); i++) {
+		itemBounds.at(i) = bounds.at(items.at(i));
+	}
+
+	//Children are after their parents, so going backwards always updates them first
+	for (size_t i = nodes.size(); i-- > 0;) {
+		Node& node = nodes.at(i);
+
+		if (node.left == 0) {
+			node.box = emptyBox();
+
+			for (size_t j = node.first; j < node.first + node.count; j++) {
+				node.box = Aabb<float>(node.box, itemBounds.at(j));
+			}
+		}
+		else {
+			node.box = Aabb<float>(nodes.at(node.left).box, nodes.at(node.left + 1).box);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::cull(const FrustumCuller& culler, std::vector<uint32_t>& visible) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	std::vector<uint32_t> stack = {0};
+
+	while (!stack.empty()) {
+		const Node& node = nodes.at(stack.back());
+		stack.pop_back();
+
+		const FrustumTest result = culler.testBox(glm::value_ptr(node.box.min), glm::value_ptr(node.box.max));
+
+		if (result == FrustumTest::INSIDE) {
+			visible.insert(visible.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+		}
+		else if (result == FrustumTest::INTERSECTS) {
+			if (node.left == 0) {
+				for (size_t i = node.first; i < node.first + node.count; i++) {
+					const Aabb<float>& box = itemBounds.at(i);
+
+					if (culler.testBox(glm::value_ptr(box.min), glm::value_ptr(box.max)) != FrustumTest::OUTSIDE) {
+						visible.push_back(items.at(i));
+					}
+				}
+			}
+			else {
+				stack.push_back(node.left);
+				stack.push_back(node.left + 1);
+			}
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::split(size_t root, const std::vector<Aabb<float>>& bounds) {
+	//Not recursive, as badly distributed items can make the tree very deep.
+	std::vector<size_t> stack = {root};
+	std::vector<glm::vec3> centers(bounds.size());
+
+	for (size_t i = 0; i < bounds.size(); i++) {
+		centers.at(i) = bounds.at(i).getCenter();
+	}
+
+	while (!stack.empty()) {
+		const size_t node = stack.back();
+		stack.pop_back();
+
+		const uint32_t first = nodes.at(node).first;
+		const uint32_t count = nodes.at(node).count;
+
+		if (count <= MAX_LEAF_SIZE) {
+			continue;
+		}
+
+		//Items are placed into bins by the centers of their boxes
+		Aabb<float> centerBox = emptyBox();
+
+		for (size_t i = first; i < first + count; i++) {
+			const glm::vec3& center = centers.at(items.at(i));
+			centerBox = Aabb<float>(centerBox, Aabb<float>(center, center));
+		}
+
+		float bestCost = std::numeric_limits<float>::infinity();
+		size_t bestAxis = 0;
+		size_t bestSplit = 0;
+
+		auto getBin = [&](uint32_t item, size_t axis) {
+			const float extent = centerBox.max[axis] - centerBox.min[axis];
+			const float offset = centers.at(item)[axis] - centerBox.min[axis];
+
+			return std::min(SAH_BINS - 1, (size_t) (offset * SAH_BINS / extent));
+		};
+
+		for (size_t axis = 0; axis < 3; axis++) {
+			//All centers are in the same place, can't split on this axis
+			if (centerBox.max[axis] <= centerBox.min[axis]) {
+				continue;
+			}
+
+			std::array<Aabb<float>, SAH_BINS> binBoxes;
+			std::array<uint32_t, SAH_BINS> binCounts = {};
+			binBoxes.fill(emptyBox());
+
+			for (size_t i = first; i < first + count; i++) {
+				const size_t bin = getBin(items.at(i), axis);
+
+				binBoxes.at(bin) = Aabb<float>(binBoxes.at(bin), bounds.at(items.at(i)));
+				binCounts.at(bin)++;
+			}
+
+			//Cost of everything at or after each bin
+			std::array<float, SAH_BINS> rightCosts = {};
+			Aabb<float> rightBox = emptyBox();
+			uint32_t rightCount = 0;
+
+			for (size_t bin = SAH_BINS - 1; bin > 0; bin--) {
+				rightBox = Aabb<float>(rightBox, binBoxes.at(bin));
+				rightCount += binCounts.at(bin);
+				rightCosts.at(bin) = rightCount * rightBox.getSurfaceArea();
+			}
+
+			Aabb<float> leftBox = emptyBox();
+			uint32_t leftCount = 0;
+
+			for (size_t bin = 1; bin < SAH_BINS; bin++) {
+				leftBox = Aabb<float>(leftBox, binBoxes.at(bin - 1));
+				leftCount += binCounts.at(bin - 1);
+
+				if (leftCount == 0 || leftCount == count) {
+					continue;
+				}
+
+				const float cost = leftCount * leftBox.getSurfaceArea() + rightCosts.at(bin);
+
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = bin;
+				}
+			}
+		}
+
+		uint32_t mid = first + count / 2;
+
+		if (bestCost < std::numeric_limits<float>::infinity()) {
+			//Splitting isn't worth it if testing all the items would be cheaper than testing both children
+			if (bestCost >= count * nodes.at(node).box.getSurfaceArea() && count <= MAX_LEAF_SIZE * 4) {
+				continue;
+			}
+
+			mid = std::partition(items.begin() + first, items.begin() + first + count, [&](uint32_t item) {
+				return getBin(item, bestAxis) < bestSplit;
+			}) - items.begin();
+		}
+
+		//Create children
+		const uint32_t left = nodes.size();
+		nodes.at(node).left = left;
+
+		for (const std::pair<uint32_t, uint32_t>& range : {std::make_pair(first, mid), std::make_pair(mid, first + count)}) {
+			Aabb<float> box = emptyBox();
+
+			for (size_t i = range.first; i < range.second; i++) {
+				box = Aabb<float>(box, bounds.at(items.at(i)));
+			}
+
+			nodes.push_back({box, range.first, range.second - range.first, 0});
+		}
+
+		stack.push_back(left);
+		stack.push_back(left + 1);
+	}
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AxisAlignedBB.hpp"
+#include "FrustumCuller.hpp"
+
+//A bounding volume hierarchy over a set of boxes, used to cull objects that rarely move without
+//testing them one at a time. Built using the surface area heuristic, and refit in place when
+//the boxes move, which is much cheaper than a rebuild but makes the tree worse over time.
+class BoundingVolumeHierarchy {
+public:
+	/**
+	 * Builds the tree from scratch.
+	 * @param bounds The box for each item. Item ids are their indices in this list.
+	 */
+	void build(const std::vector<Aabb<float>>& bounds);
+
+	/**
+	 * Updates the node boxes to fit the items' new boxes, without changing the tree's structure.
+	 * @param bounds The new box for each item, must be the same size as when the tree was built.
+	 */
+	void refit(const std::vector<Aabb<float>>& bounds);
+
+	/**
+	 * Finds all items that are at least partially inside the frustum. Subtrees completely
+	 * inside or outside of the frustum are accepted or rejected without visiting their children.
+	 * @param culler The culler with the frustum to test against.
+	 * @param visible The ids of visible items are appended to this, in no particular order.
+	 */
+	void cull(const FrustumCuller& culler, std::vector<uint32_t>& visible) const;
+
+	/**
+	 * Gets the number of items the tree was built with.
+	 * @return The item count.
+	 */
+	size_t size() const { return items.size(); }
+
+private:
+	//Max number of items in a leaf, nodes smaller than this are never split.
+	constexpr static size_t MAX_LEAF_SIZE = 4;
+	//Number of buckets to place items into along each axis when finding a split.
+	constexpr static size_t SAH_BINS = 16;
+
+	struct Node {
+		//Box containing all the node's items.
+		Aabb<float> box;
+		//The node's items, which are a range of the item list.
+		uint32_t first;
+		uint32_t count;
+		//Index of the left child, the right child is always after it. 0 for leaves.
+		uint32_t left;
+	};
+
+	//All nodes, with the root first. Children are always after their parents.
+	std::vector<Node> nodes;
+	//Item ids, ordered so that each node's items are next to each other.
+	std::vector<uint32_t> items;
+	//The box for each item, in the same order as the item list.
+	std::vector<Aabb<float>> itemBounds;
+
+	/**
+	 * Splits the given node, and then its children, until each leaf is small enough or
+	 * splitting further wouldn't help.
+	 * @param node The node to split. Its range and box need to already be set.
+	 * @param bounds The item boxes, indexed by id.
+	 */
+	void split(size_t node, const std::vector<Aabb<float>>& bounds);
+};
@@ -25,7 +25,10 @@
 enum class BufferStorage {
 	HOST,
 	DEVICE,
-	DEVICE_HOST_VISIBLE
+	DEVICE_HOST_VISIBLE,
+	//Host visible, rewritten every frame and kept mapped for the buffer's whole life.
+	//The renderer keeps frames from overwriting data the gpu is still using.
+	STREAMING
 };
 
 enum class BufferType {
@@ -41,7 +44,8 @@ public:
 		TRANSFER_DST = 0x00000002,
 		UNIFORM_BUFFER = 0x00000010,
 		INDEX_BUFFER = 0x00000040,
-		VERTEX_BUFFER = 0x00000080
+		VERTEX_BUFFER = 0x00000080,
+		INDIRECT_BUFFER = 0x00000100
 	};
 
 	/**
@@ -109,6 +113,21 @@ public:
 	 */
 	virtual void write(size_t offset, size_t size, const unsigned char* data) = 0;
 
+	/**
+	 * Makes writes to a range of the buffer visible to the gpu, for mapped memory
+	 * that isn't coherent. Does nothing by default.
+	 * @param offset The start of the range to flush.
+	 * @param size The size of the range, in bytes.
+	 */
+	virtual void flush(size_t offset, size_t size) {}
+
+	/**
+	 * Gets the buffer's persistently mapped memory, so data can be written in place instead
+	 * of being copied with write. Writes still need to be flushed.
+	 * @return The mapped memory, or nullptr if the buffer isn't mapped.
+	 */
+	virtual unsigned char* getMappedMemory() { return nullptr; }
+
 	/**
 	 * Gets the size of the buffer.
 	 * @return The size of the buffer, in bytes.
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <array>
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+
+#include "DrawList.hpp"
+
+//Needed for passing by reference (std::min) before C++17.
+constexpr size_t DrawList::MAX_SORT_BLOCKS;
+
+void DrawList::sort() {
+	for (std::vector<DrawItem>& items : passItems) {
+		sortItems(items);
+	}
+}
+
+void DrawList::sortItems(std::vector<DrawItem>& items) {
+	constexpr size_t bucketCount = 256;
+	constexpr size_t digitCount = sizeof(uint64_t);
+
+	if (items.size() < 2) {
+		return;
+	}
+
+	//Each block is counted and scattered by its own task. Blocks are in list order,
+	//and each writes its items in order, so the sort stays stable.
+	const size_t blockCount = std::min(MAX_SORT_BLOCKS, (items.size() + SORT_BLOCK_SIZE - 1) / SORT_BLOCK_SIZE);
+	const size_t blockSize = (items.size() + blockCount - 1) / blockCount;
+
+	auto forEachBlock = [&](const auto& func) {
+		auto runBlock = [&](size_t block) {
+			func(block, block * blockSize, std::min(items.size(), (block + 1) * blockSize));
+		};
+
+		if (blockCount == 1) {
+			runBlock(0);
+		}
+		else {
+			tbb::parallel_for(size_t(0), blockCount, runBlock);
+		}
+	};
+
+	blockCounts.resize(blockCount);
+	blockBits.resize(blockCount);
+	sortBuffer.resize(items.size());
+
+	//Most of the key is the same for long runs of items, so find the bytes that actually
+	//differ between keys and skip the rest.
+	forEachBlock([&](size_t block, size_t begin, size_t end) {
+		uint64_t anyBits = 0;
+		uint64_t allBits = ~0ull;
+
+		for (size_t i = begin; i < end; i++) {
+			anyBits |= items[i].key;
+			allBits &= items[i].key;
+		}
+
+		blockBits[block] = {anyBits, allBits};
+	});
+
+	uint64_t anyBits = 0;
+	uint64_t allBits = ~0ull;
+
+	for (const std::pair<uint64_t, uint64_t>& bits : blockBits) {
+		anyBits |= bits.first;
+		allBits &= bits.second;
+	}
+
+	const uint64_t changedBits = anyBits ^ allBits;
+
+	for (size_t digit = 0; digit < digitCount; digit++) {
+		const uint32_t shift = digit * 8;
+
+		if (((changedBits >> shift) & 0xFF) == 0) {
+			continue;
+		}
+
+		forEachBlock([&](size_t block, size_t begin, size_t end) {
+			std::array<size_t, bucketCount>& count = blockCounts[block];
+			count.fill(0);
+
+			for (size_t i = begin; i < end; i++) {
+				count[(items[i].key >> shift) & 0xFF]++;
+			}
+		});
+
+		//Turn the counts into write positions, ordered by bucket, then by block
+		size_t offset = 0;
+
+		for (size_t bucket = 0; bucket < bucketCount; bucket++) {
+			for (std::array<size_t, bucketCount>& count : blockCounts) {
+				const size_t bucketSize = count[bucket];
+				count[bucket] = offset;
+				offset += bucketSize;
+			}
+		}
+
+		forEachBlock([&](size_t block, size_t begin, size_t end) {
+			std::array<size_t, bucketCount>& position = blockCounts[block];
+
+			for (size_t i = begin; i < end; i++) {
+				sortBuffer[position[(items[i].key >> shift) & 0xFF]++] = items[i];
+			}
+		});
+
+		items.swap(sortBuffer);
+	}
+}
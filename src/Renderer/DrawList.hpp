@@ -0,0 +1,190 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <utility>
+
+#include "ShaderInfo.hpp"
+
+class RenderComponent;
+class Mesh;
+
+//A single object to draw, along with the key that decides its draw order.
+struct DrawItem {
+	//Sort key, see DrawList::makeKey.
+	uint64_t key;
+	//The object to draw.
+	const RenderComponent* object;
+	//The mesh to draw the object with, which depends on its level of detail.
+	const Mesh* mesh;
+};
+
+//Flat lists of objects to draw, one for each render pass, sorted so that objects sharing state
+//are next to each other. Each key packs, from most to least significant: render pass (2 bits),
+//order (16 bits), shader id (12 bits), buffer id (8 bits), batch id (18 bits), and sub-order (8 bits).
+//The order and sub-order come from the object's depth, following its pass's sort policy (see addDepth).
+class DrawList {
+public:
+	//Number of render passes, and so lists.
+	constexpr static size_t PASS_COUNT = 3;
+
+	//Bit positions and sizes of each field in the key.
+	constexpr static uint32_t PASS_SHIFT = 62;
+	constexpr static uint32_t ORDER_SHIFT = 46;
+	constexpr static uint32_t SHADER_SHIFT = 34;
+	constexpr static uint32_t BUFFER_SHIFT = 26;
+	constexpr static uint32_t BATCH_SHIFT = 8;
+	constexpr static uint64_t ORDER_MAX = (1ull << 16) - 1;
+	constexpr static uint64_t SHADER_MAX = (1ull << 12) - 1;
+	constexpr static uint64_t BUFFER_MAX = (1ull << 8) - 1;
+	constexpr static uint64_t BATCH_MAX = (1ull << 18) - 1;
+	constexpr static uint64_t SUB_MAX = (1ull << 8) - 1;
+
+	//Range of quantized depths passed to addDepth.
+	constexpr static uint32_t DEPTH_BITS = 16;
+	constexpr static uint64_t DEPTH_MAX = (1ull << DEPTH_BITS) - 1;
+	//Number of depth bits used to order opaque objects using the same shader.
+	constexpr static uint32_t COARSE_DEPTH_BITS = 4;
+
+	/**
+	 * Creates the part of a sort key that is the same for every object in a batch. Values are not
+	 * range checked, callers need to make sure they fit.
+	 * @param pass The render pass.
+	 * @param shader The shader's id.
+	 * @param buffer The vertex buffer's id.
+	 * @param batch The batch's index in the render manager.
+	 * @return The key, without any depth ordering.
+	 */
+	static constexpr uint64_t makeKey(RenderPass pass, uint64_t shader, uint64_t buffer, uint64_t batch) {
+		return ((uint64_t)pass << PASS_SHIFT) | (shader << SHADER_SHIFT) | (buffer << BUFFER_SHIFT) | (batch << BATCH_SHIFT);
+	}
+
+	/**
+	 * Adds an object's depth to a key from makeKey, following the sort policy of the key's pass.
+	 * Translucent objects are drawn strictly back to front so they blend correctly, and only
+	 * share state with objects at the same depth. Everything else is grouped by shader, then
+	 * drawn in coarse front to back steps, so the depth test can reject hidden fragments
+	 * without switching shaders more often.
+	 * @param key The key from makeKey.
+	 * @param depth The quantized view depth, from 0 at the near plane to DEPTH_MAX at the far plane.
+	 * @param sub The sub-order, for objects that are otherwise the same. Usually getFineDepth(depth).
+	 * @return The key with its order and sub-order set.
+	 */
+	static constexpr uint64_t addDepth(uint64_t key, uint64_t depth, uint64_t sub) {
+		uint64_t order = 0;
+
+		if (getPass(key) == RenderPass::TRANSLUCENT) {
+			order = DEPTH_MAX - depth;
+		}
+		else {
+			order = ((uint64_t)getShader(key) << COARSE_DEPTH_BITS) | (depth >> (DEPTH_BITS - COARSE_DEPTH_BITS));
+		}
+
+		return key | (order << ORDER_SHIFT) | sub;
+	}
+
+	/**
+	 * Gets the depth bits just below the coarse depth, to order objects in the same step front to back.
+	 * @param depth The quantized view depth.
+	 * @return The sub-order for the depth.
+	 */
+	static constexpr uint64_t getFineDepth(uint64_t depth) {
+		//The sub-order is everything below the batch
+		return (depth >> (DEPTH_BITS - COARSE_DEPTH_BITS - BATCH_SHIFT)) & SUB_MAX;
+	}
+
+	/**
+	 * Functions to extract fields from a key.
+	 * @param key The key.
+	 * @return The field's value.
+	 */
+	static constexpr RenderPass getPass(uint64_t key) { return (RenderPass)(key >> PASS_SHIFT); }
+	static constexpr uint32_t getShader(uint64_t key) { return (key >> SHADER_SHIFT) & SHADER_MAX; }
+	static constexpr uint32_t getBuffer(uint64_t key) { return (key >> BUFFER_SHIFT) & BUFFER_MAX; }
+	static constexpr uint32_t getBatch(uint64_t key) { return (key >> BATCH_SHIFT) & BATCH_MAX; }
+
+	/**
+	 * Removes all items, keeping the allocated memory.
+	 */
+	void clear() {
+		for (std::vector<DrawItem>& items : passItems) {
+			items.clear();
+		}
+	}
+
+	/**
+	 * Adds a list of items to the end of a pass's list.
+	 * @param pass The pass the items are drawn in, which must match the pass in their keys.
+	 * @param newItems The items to add.
+	 */
+	void add(RenderPass pass, const std::vector<DrawItem>& newItems) {
+		std::vector<DrawItem>& items = passItems.at((size_t) pass);
+		items.insert(items.end(), newItems.begin(), newItems.end());
+	}
+
+	/**
+	 * Sorts each pass's list by key.
+	 */
+	void sort();
+
+	/**
+	 * Gets the items drawn in a pass.
+	 * @param pass The pass to get the items for.
+	 * @return The items, sorted if sort was called since the last modification.
+	 */
+	const std::vector<DrawItem>& getItems(RenderPass pass) const { return passItems.at((size_t) pass); }
+
+	/**
+	 * Gets the total number of items in all passes.
+	 * @return The item count.
+	 */
+	size_t size() const {
+		size_t count = 0;
+
+		for (const std::vector<DrawItem>& items : passItems) {
+			count += items.size();
+		}
+
+		return count;
+	}
+
+private:
+	//Lists at least this long are split into blocks that are sorted in parallel.
+	constexpr static size_t SORT_BLOCK_SIZE = 8192;
+	//Maximum number of blocks, more would make combining block counts the bottleneck.
+	constexpr static size_t MAX_SORT_BLOCKS = 64;
+
+	//The items to draw in each pass.
+	std::array<std::vector<DrawItem>, PASS_COUNT> passItems;
+	//Scratch space for sorting.
+	std::vector<DrawItem> sortBuffer;
+	//Bucket counts for each block, then the position the next item in each bucket is written at.
+	std::vector<std::array<size_t, 256>> blockCounts;
+	//Bits set in any key and in every key of each block.
+	std::vector<std::pair<uint64_t, uint64_t>> blockBits;
+
+	/**
+	 * Sorts a single list by key, with a parallel least significant digit radix sort.
+	 * @param items The list to sort.
+	 */
+	void sortItems(std::vector<DrawItem>& items);
+};
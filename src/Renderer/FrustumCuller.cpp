@@ -0,0 +1,175 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#define FRUSTUM_CULLER_SIMD
+#include <immintrin.h>
+#endif
+
+#include "FrustumCuller.hpp"
+
+void FrustumCuller::setFrustum(const float* viewProj) {
+	//Rows of the matrix, which is stored by column.
+	std::array<std::array<float, 4>, 4> rows;
+
+	for (size_t i = 0; i < 4; i++) {
+		for (size_t j = 0; j < 4; j++) {
+			rows[i][j] = viewProj[j * 4 + i];
+		}
+	}
+
+	//Left, right, bottom, top, near, far. Each plane is the last row plus or minus one of the others.
+	for (size_t i = 0; i < PLANE_COUNT; i++) {
+		const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+		const std::array<float, 4>& row = rows[i / 2];
+
+		for (size_t j = 0; j < 4; j++) {
+			planes[i][j] = rows[3][j] + sign * row[j];
+		}
+
+		//Normalize so the distance to the plane can be compared with the radius.
+		const float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+
+		for (float& value : planes[i]) {
+			value /= length;
+		}
+	}
+}
+
+void FrustumCuller::cull(size_t begin, size_t end, std::vector<uint32_t>& visible) const {
+	size_t i = begin;
+
+#ifdef FRUSTUM_CULLER_SIMD
+	//Make room for the worst case, so the indices can be written without branching on
+	//visibility. The unused space is removed at the end.
+	const size_t startSize = visible.size();
+	visible.resize(startSize + (end - begin));
+	uint32_t* out = visible.data() + startSize;
+	size_t count = 0;
+
+#if defined(__AVX__)
+	__m256 planeVecs[PLANE_COUNT][4];
+
+	for (size_t j = 0; j < PLANE_COUNT; j++) {
+		for (size_t k = 0; k < 4; k++) {
+			planeVecs[j][k] = _mm256_set1_ps(planes[j][k]);
+		}
+	}
+
+	for (; i + 8 <= end; i += 8) {
+		const __m256 x = _mm256_loadu_ps(&sphereX[i]);
+		const __m256 y = _mm256_loadu_ps(&sphereY[i]);
+		const __m256 z = _mm256_loadu_ps(&sphereZ[i]);
+		const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&sphereRadius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (const __m256* plane : planeVecs) {
+			__m256 dist = _mm256_add_ps(_mm256_mul_ps(plane[0], x), plane[3]);
+			dist = _mm256_add_ps(_mm256_mul_ps(plane[1], y), dist);
+			dist = _mm256_add_ps(_mm256_mul_ps(plane[2], z), dist);
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+		}
+
+		const uint32_t mask = _mm256_movemask_ps(inside);
+
+		for (uint32_t j = 0; j < 8; j++) {
+			out[count] = i + j;
+			count += (mask >> j) & 1;
+		}
+	}
+#else
+	__m128 planeVecs[PLANE_COUNT][4];
+
+	for (size_t j = 0; j < PLANE_COUNT; j++) {
+		for (size_t k = 0; k < 4; k++) {
+			planeVecs[j][k] = _mm_set1_ps(planes[j][k]);
+		}
+	}
+
+	for (; i + 4 <= end; i += 4) {
+		const __m128 x = _mm_loadu_ps(&sphereX[i]);
+		const __m128 y = _mm_loadu_ps(&sphereY[i]);
+		const __m128 z = _mm_loadu_ps(&sphereZ[i]);
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&sphereRadius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (const __m128* plane : planeVecs) {
+			__m128 dist = _mm_add_ps(_mm_mul_ps(plane[0], x), plane[3]);
+			dist = _mm_add_ps(_mm_mul_ps(plane[1], y), dist);
+			dist = _mm_add_ps(_mm_mul_ps(plane[2], z), dist);
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+		}
+
+		const uint32_t mask = _mm_movemask_ps(inside);
+
+		for (uint32_t j = 0; j < 4; j++) {
+			out[count] = i + j;
+			count += (mask >> j) & 1;
+		}
+	}
+#endif
+
+	visible.resize(startSize + count);
+#endif
+
+	cullScalar(i, end, visible);
+}
+
+void FrustumCuller::cullScalar(size_t begin, size_t end, std::vector<uint32_t>& visible) const {
+	for (size_t i = begin; i < end; i++) {
+		bool inside = true;
+
+		for (const std::array<float, 4>& plane : planes) {
+			const float dist = plane[0] * sphereX[i] + plane[1] * sphereY[i] + plane[2] * sphereZ[i] + plane[3];
+			inside = inside && dist >= -sphereRadius[i];
+		}
+
+		if (inside) {
+			visible.push_back(i);
+		}
+	}
+}
+
+FrustumTest FrustumCuller::testBox(const float* min, const float* max) const {
+	FrustumTest result = FrustumTest::INSIDE;
+
+	for (const std::array<float, 4>& plane : planes) {
+		//Distances of the corners farthest along and against the plane's normal
+		float farDist = plane[3];
+		float nearDist = plane[3];
+
+		for (size_t i = 0; i < 3; i++) {
+			farDist += plane[i] * (plane[i] >= 0.0f ? max[i] : min[i]);
+			nearDist += plane[i] * (plane[i] >= 0.0f ? min[i] : max[i]);
+		}
+
+		if (farDist < 0.0f) {
+			return FrustumTest::OUTSIDE;
+		}
+
+		if (nearDist < 0.0f) {
+			result = FrustumTest::INTERSECTS;
+		}
+	}
+
+	return result;
+}
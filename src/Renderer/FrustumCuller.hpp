@@ -0,0 +1,121 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+//Result of testing a volume against the frustum.
+enum class FrustumTest {
+	//Completely outside of the frustum.
+	OUTSIDE,
+	//Partially inside, or close enough to the edges that it couldn't be determined.
+	INTERSECTS,
+	//Completely inside the frustum.
+	INSIDE
+};
+
+//Tests bounding spheres against the six planes of a view frustum. Spheres are stored as separate
+//arrays of x, y, z, and radius so the SIMD paths can load several at once - 8 per iteration with
+//AVX, 4 with SSE, and one at a time otherwise. Which path is used is decided at compile time, so
+//AVX needs to be enabled with the compiler's target flags (-mavx2 or -march=native for gcc).
+class FrustumCuller {
+public:
+	/**
+	 * Extracts the frustum planes from the given view-projection matrix. Clip space is assumed
+	 * to be OpenGL's, with z from -w to w.
+	 * @param viewProj The column-major view-projection matrix, as 16 floats.
+	 */
+	void setFrustum(const float* viewProj);
+
+	/**
+	 * Changes the number of spheres. Existing spheres keep their values, new ones are undefined.
+	 * @param count The new number of spheres.
+	 */
+	void resize(size_t count) {
+		sphereX.resize(count);
+		sphereY.resize(count);
+		sphereZ.resize(count);
+		sphereRadius.resize(count);
+	}
+
+	/**
+	 * Gets the number of spheres.
+	 * @return The sphere count.
+	 */
+	size_t size() const { return sphereX.size(); }
+
+	/**
+	 * Sets a sphere. An infinite radius always passes, and a negative infinite radius never does,
+	 * which can be used for objects that skip culling or are hidden.
+	 * @param index The index of the sphere to set.
+	 * @param x The x coordinate of the center.
+	 * @param y The y coordinate of the center.
+	 * @param z The z coordinate of the center.
+	 * @param radius The sphere's radius.
+	 */
+	void setSphere(size_t index, float x, float y, float z, float radius) {
+		sphereX[index] = x;
+		sphereY[index] = y;
+		sphereZ[index] = z;
+		sphereRadius[index] = radius;
+	}
+
+	/**
+	 * Culls a range of spheres, using the widest SIMD path available. Safe to call from
+	 * multiple threads at once, as long as nothing is being modified.
+	 * @param begin The first sphere to test.
+	 * @param end One past the last sphere to test.
+	 * @param visible The indices of all spheres that are at least partially inside the
+	 *     frustum are appended to this, in increasing order.
+	 */
+	void cull(size_t begin, size_t end, std::vector<uint32_t>& visible) const;
+
+	/**
+	 * Same as cull, but always tests one sphere at a time. Used for the leftover spheres
+	 * in cull, and for comparison.
+	 * @param begin The first sphere to test.
+	 * @param end One past the last sphere to test.
+	 * @param visible Visible sphere indices are appended to this.
+	 */
+	void cullScalar(size_t begin, size_t end, std::vector<uint32_t>& visible) const;
+
+	/**
+	 * Tests an axis-aligned box against the frustum, for hierarchical culling. Some boxes near
+	 * the corners of the frustum are reported as intersecting even though they're outside.
+	 * @param min The minimum corner of the box, as 3 floats.
+	 * @param max The maximum corner of the box.
+	 * @return Where the box is relative to the frustum.
+	 */
+	FrustumTest testBox(const float* min, const float* max) const;
+
+private:
+	//Number of frustum planes.
+	constexpr static size_t PLANE_COUNT = 6;
+
+	//The normalized frustum planes, as (a, b, c, d), with normals pointing inwards.
+	std::array<std::array<float, 4>, PLANE_COUNT> planes;
+
+	//Sphere centers and radii.
+	std::vector<float> sphereX;
+	std::vector<float> sphereY;
+	std::vector<float> sphereZ;
+	std::vector<float> sphereRadius;
+};
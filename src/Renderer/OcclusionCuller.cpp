@@ -0,0 +1,311 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OCCLUSION_CULLER_SIMD
+#include <emmintrin.h>
+#endif
+
+#include <tbb/parallel_for.h>
+
+#include "OcclusionCuller.hpp"
+
+//Needed for passing by reference (std::min) before C++17.
+constexpr size_t OcclusionCuller::WIDTH;
+constexpr size_t OcclusionCuller::HEIGHT;
+
+namespace {
+	/**
+	 * Multiplies two column-major 4x4 matrices.
+	 * @param a The left matrix.
+	 * @param b The right matrix.
+	 * @param out Where to store a * b.
+	 */
+	void multiplyMatrix(const float* a, const float* b, float* out) {
+		for (size_t col = 0; col < 4; col++) {
+			for (size_t row = 0; row < 4; row++) {
+				float sum = 0.0f;
+
+				for (size_t k = 0; k < 4; k++) {
+					sum += a[k * 4 + row] * b[col * 4 + k];
+				}
+
+				out[col * 4 + row] = sum;
+			}
+		}
+	}
+
+	/**
+	 * Transforms a point to clip space.
+	 * @param matrix The column-major transformation matrix.
+	 * @param x, y, z The point.
+	 * @param out Where to store the transformed point, as 4 floats.
+	 */
+	void transformPoint(const float* matrix, float x, float y, float z, float* out) {
+		for (size_t row = 0; row < 4; row++) {
+			out[row] = matrix[row] * x + matrix[4 + row] * y + matrix[8 + row] * z + matrix[12 + row];
+		}
+	}
+
+	/**
+	 * Converts a screen coordinate to a pixel index, clamping it to the screen first so
+	 * points far outside of it can't overflow.
+	 * @param value The coordinate, already rounded.
+	 * @param size The size of the screen along the coordinate's axis.
+	 * @return The clamped coordinate.
+	 */
+	int32_t toPixel(float value, size_t size) {
+		return (int32_t) std::max(std::min(value, (float) size), -1.0f);
+	}
+}
+
+OcclusionCuller::OcclusionCuller() :
+	viewProj(),
+	depthBuffer(WIDTH * HEIGHT, 1.0f),
+	occluderCount(0) {
+
+}
+
+void OcclusionCuller::begin(const float* matrix) {
+	std::copy(matrix, matrix + 16, viewProj.begin());
+	std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+	occluderCount = 0;
+
+	for (std::vector<Triangle>& threadList : threadTriangles) {
+		threadList.clear();
+	}
+}
+
+void OcclusionCuller::addOccluder(const float* transform, const unsigned char* positions, size_t stride, const uint32_t* indices, size_t indexCount) {
+	std::array<float, 16> mvp;
+	multiplyMatrix(viewProj.data(), transform, mvp.data());
+
+	std::vector<Triangle>& outTriangles = threadTriangles.local();
+
+	for (size_t i = 0; i + 3 <= indexCount; i += 3) {
+		//Screen-space x, y, and depth for each vertex.
+		std::array<std::array<float, 3>, 3> verts;
+		bool nearClipped = false;
+
+		for (size_t j = 0; j < 3; j++) {
+			const float* pos = reinterpret_cast<const float*>(positions + indices[i + j] * stride);
+			float clip[4];
+			transformPoint(mvp.data(), pos[0], pos[1], pos[2], clip);
+
+			//Triangles crossing the near plane are skipped instead of clipped, which only
+			//makes the occluder smaller.
+			if (clip[3] < MIN_W) {
+				nearClipped = true;
+				break;
+			}
+
+			const float invW = 1.0f / clip[3];
+			verts[j][0] = (clip[0] * invW * 0.5f + 0.5f) * WIDTH;
+			verts[j][1] = (clip[1] * invW * 0.5f + 0.5f) * HEIGHT;
+			verts[j][2] = clip[2] * invW * 0.5f + 0.5f;
+		}
+
+		if (nearClipped) {
+			continue;
+		}
+
+		const float area = (verts[1][0] - verts[0][0]) * (verts[2][1] - verts[0][1]) - (verts[1][1] - verts[0][1]) * (verts[2][0] - verts[0][0]);
+
+		//Degenerate or too small to cover anything
+		if (std::abs(area) < 1e-6f) {
+			continue;
+		}
+
+		const float minX = std::min({verts[0][0], verts[1][0], verts[2][0]});
+		const float maxX = std::max({verts[0][0], verts[1][0], verts[2][0]});
+		const float minY = std::min({verts[0][1], verts[1][1], verts[2][1]});
+		const float maxY = std::max({verts[0][1], verts[1][1], verts[2][1]});
+
+		//Only pixel centers are covered, so the bounds are the centers within the triangle's box.
+		Triangle tri;
+		tri.minX = std::max(toPixel(std::ceil(minX - 0.5f), WIDTH), 0);
+		tri.maxX = std::min(toPixel(std::floor(maxX - 0.5f), WIDTH), (int32_t) WIDTH - 1);
+		tri.minY = std::max(toPixel(std::ceil(minY - 0.5f), HEIGHT), 0);
+		tri.maxY = std::min(toPixel(std::floor(maxY - 0.5f), HEIGHT), (int32_t) HEIGHT - 1);
+
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+			continue;
+		}
+
+		//Edge j goes between the two vertices other than j, so its value divided by the
+		//area is vertex j's barycentric coordinate. Flipping the sign for clockwise triangles
+		//makes both windings positive inside, so occluders don't need consistent winding.
+		const float sign = area > 0.0f ? 1.0f : -1.0f;
+		const float invArea = 1.0f / std::abs(area);
+		tri.depth = {0.0f, 0.0f, 0.0f};
+
+		for (size_t j = 0; j < 3; j++) {
+			const std::array<float, 3>& start = verts[(j + 1) % 3];
+			const std::array<float, 3>& end = verts[(j + 2) % 3];
+
+			const float a = sign * (start[1] - end[1]);
+			const float b = sign * (end[0] - start[0]);
+			const float c = -(a * start[0] + b * start[1]);
+
+			tri.edges[j] = {a, b, c};
+
+			//Depth over ndc w is linear in screen space, so it can be interpolated with the
+			//barycentric coordinates.
+			tri.depth[0] += a * verts[j][2] * invArea;
+			tri.depth[1] += b * verts[j][2] * invArea;
+			tri.depth[2] += c * verts[j][2] * invArea;
+		}
+
+		outTriangles.push_back(tri);
+	}
+
+	occluderCount++;
+}
+
+void OcclusionCuller::rasterize() {
+	triangles.clear();
+
+	for (std::vector<Triangle>& threadList : threadTriangles) {
+		triangles.insert(triangles.end(), threadList.begin(), threadList.end());
+	}
+
+	//Each strip of rows is only written by one task, so no synchronization is needed.
+	const size_t stripCount = (HEIGHT + STRIP_HEIGHT - 1) / STRIP_HEIGHT;
+
+	tbb::parallel_for(size_t(0), stripCount, [&](size_t strip) {
+		const int32_t stripMin = strip * STRIP_HEIGHT;
+		const int32_t stripMax = std::min((strip + 1) * STRIP_HEIGHT, HEIGHT) - 1;
+
+		for (const Triangle& tri : triangles) {
+			if (tri.maxY >= stripMin && tri.minY <= stripMax) {
+				rasterizeTriangle(tri, std::max(tri.minY, stripMin), std::min(tri.maxY, stripMax));
+			}
+		}
+	});
+}
+
+void OcclusionCuller::rasterizeTriangle(const Triangle& tri, int32_t minY, int32_t maxY) {
+	for (int32_t y = minY; y <= maxY; y++) {
+		const float centerY = y + 0.5f;
+		float* row = &depthBuffer[y * WIDTH];
+		int32_t x = tri.minX;
+
+#ifdef OCCLUSION_CULLER_SIMD
+		//Start on a multiple of 4 so the loads are aligned with the row. The width is a multiple of 4,
+		//so the last group never goes past the end of the row.
+		x &= ~3;
+
+		//Values of the edge and depth functions at the start of the row, and how much they change
+		//between the 4 pixels in a group.
+		const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		__m128 edgeA[3];
+		__m128 edgeRow[3];
+
+		for (size_t j = 0; j < 3; j++) {
+			edgeA[j] = _mm_set1_ps(tri.edges[j][0]);
+			edgeRow[j] = _mm_set1_ps(tri.edges[j][1] * centerY + tri.edges[j][2]);
+		}
+
+		const __m128 depthA = _mm_set1_ps(tri.depth[0]);
+		const __m128 depthRow = _mm_set1_ps(tri.depth[1] * centerY + tri.depth[2]);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; x <= tri.maxX; x += 4) {
+			const __m128 pixelX = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], pixelX), edgeRow[0]), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], pixelX), edgeRow[1]), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], pixelX), edgeRow[2]), zero));
+
+			if (_mm_movemask_ps(inside) == 0) {
+				continue;
+			}
+
+			const __m128 oldDepth = _mm_loadu_ps(&row[x]);
+			const __m128 newDepth = _mm_min_ps(oldDepth, _mm_add_ps(_mm_mul_ps(depthA, pixelX), depthRow));
+			//Keep the old depth outside of the triangle.
+			_mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, newDepth), _mm_andnot_ps(inside, oldDepth)));
+		}
+#endif
+
+		for (; x <= tri.maxX; x++) {
+			const float centerX = x + 0.5f;
+			bool inside = true;
+
+			for (size_t j = 0; j < 3; j++) {
+				inside = inside && tri.edges[j][0] * centerX + tri.edges[j][1] * centerY + tri.edges[j][2] >= 0.0f;
+			}
+
+			if (inside) {
+				row[x] = std::min(row[x], tri.depth[0] * centerX + tri.depth[1] * centerY + tri.depth[2]);
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const float* min, const float* max) const {
+	float minX = std::numeric_limits<float>::infinity();
+	float minY = std::numeric_limits<float>::infinity();
+	float minDepth = std::numeric_limits<float>::infinity();
+	float maxX = -std::numeric_limits<float>::infinity();
+	float maxY = -std::numeric_limits<float>::infinity();
+
+	for (size_t i = 0; i < 8; i++) {
+		float clip[4];
+		transformPoint(viewProj.data(), (i & 1) ? max[0] : min[0], (i & 2) ? max[1] : min[1], (i & 4) ? max[2] : min[2], clip);
+
+		//The box can't be projected if it's partly behind the camera, and anything that
+		//close is almost certainly visible anyway.
+		if (clip[3] < MIN_W) {
+			return true;
+		}
+
+		const float invW = 1.0f / clip[3];
+		const float x = (clip[0] * invW * 0.5f + 0.5f) * WIDTH;
+		const float y = (clip[1] * invW * 0.5f + 0.5f) * HEIGHT;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, clip[2] * invW * 0.5f + 0.5f);
+	}
+
+	//Every pixel the rectangle touches is tested, not just ones with covered centers.
+	const int32_t startX = std::max(toPixel(std::floor(minX), WIDTH), 0);
+	const int32_t endX = toPixel(std::ceil(maxX), WIDTH);
+	const int32_t startY = std::max(toPixel(std::floor(minY), HEIGHT), 0);
+	const int32_t endY = toPixel(std::ceil(maxY), HEIGHT);
+
+	for (int32_t y = startY; y < endY; y++) {
+		const float* row = &depthBuffer[y * WIDTH];
+
+		for (int32_t x = startX; x < endX; x++) {
+			if (row[x] >= minDepth) {
+				return true;
+			}
+		}
+	}
+
+	//Either everything was behind an occluder or the box was off screen.
+	return false;
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <atomic>
+
+#include <tbb/enumerable_thread_specific.h>
+
+//Software occlusion culling. Occluder meshes are rasterized into a small depth buffer on the cpu,
+//and then the screen-space bounds of other objects are tested against it, so objects completely
+//hidden behind occluders aren't drawn. Occluders are rasterized in parallel, with each thread
+//filling a strip of the buffer, 4 pixels at a time with SSE. This doesn't use the rendering api
+//at all, so it can run without a window.
+class OcclusionCuller {
+public:
+	//Size of the depth buffer. The width needs to be a multiple of 4.
+	constexpr static size_t WIDTH = 256;
+	constexpr static size_t HEIGHT = 128;
+
+	/**
+	 * Creates an occlusion culler with an empty depth buffer.
+	 */
+	OcclusionCuller();
+
+	/**
+	 * Removes all occluders and clears the depth buffer, to start a new frame.
+	 * @param viewProj The column-major view-projection matrix, as 16 floats. Clip
+	 *     space is assumed to be OpenGL's.
+	 */
+	void begin(const float* viewProj);
+
+	/**
+	 * Adds an occluder. Can be called from multiple threads at once.
+	 * @param transform The column-major model matrix for the occluder.
+	 * @param positions The first vertex position, as 3 floats.
+	 * @param stride The distance between vertex positions, in bytes.
+	 * @param indices The triangle indices.
+	 * @param indexCount The number of indices.
+	 */
+	void addOccluder(const float* transform, const unsigned char* positions, size_t stride, const uint32_t* indices, size_t indexCount);
+
+	/**
+	 * Rasterizes all the added occluders into the depth buffer. Needs to be called
+	 * after all occluders are added and before isVisible is used.
+	 */
+	void rasterize();
+
+	/**
+	 * Checks whether any occluders were added since begin was called.
+	 * @return Whether there are occluders.
+	 */
+	bool hasOccluders() const { return occluderCount > 0; }
+
+	/**
+	 * Tests a box against the depth buffer. Can be called from multiple threads at once.
+	 * @param min The minimum corner of the world-space box, as 3 floats.
+	 * @param max The maximum corner of the box.
+	 * @return Whether any part of the box's screen-space bounds is in front of the occluders.
+	 *     Boxes crossing the near plane are always visible.
+	 */
+	bool isVisible(const float* min, const float* max) const;
+
+	/**
+	 * Gets the depth buffer, for debugging. Depths go from 0 at the near plane to
+	 * 1 at the far plane, rows go from the bottom of the screen to the top.
+	 * @return The depth buffer.
+	 */
+	const std::vector<float>& getDepthBuffer() const { return depthBuffer; }
+
+private:
+	//Number of rows rasterized by each task.
+	constexpr static size_t STRIP_HEIGHT = 16;
+	//Vertices with a clip w smaller than this are too close to the camera to project.
+	constexpr static float MIN_W = 1e-4f;
+
+	//A screen-space triangle, set up for rasterizing.
+	struct Triangle {
+		//Pixel bounds, inclusive.
+		int32_t minX;
+		int32_t maxX;
+		int32_t minY;
+		int32_t maxY;
+		//Edge functions, as (a, b, c) for a * x + b * y + c. Positive inside the triangle.
+		std::array<std::array<float, 3>, 3> edges;
+		//Depth plane, in the same form as the edges.
+		std::array<float, 3> depth;
+	};
+
+	//The view-projection matrix for the current frame.
+	std::array<float, 16> viewProj;
+	//Nearest occluder depth for each pixel.
+	std::vector<float> depthBuffer;
+	//Triangles set up by each thread.
+	tbb::enumerable_thread_specific<std::vector<Triangle>> threadTriangles;
+	//All triangles, gathered from each thread before rasterizing.
+	std::vector<Triangle> triangles;
+	//Number of occluders added this frame.
+	std::atomic<size_t> occluderCount;
+
+	/**
+	 * Rasterizes the part of a triangle within a strip of rows.
+	 * @param tri The triangle.
+	 * @param minY The first row of the strip.
+	 * @param maxY The last row of the strip, inclusive.
+	 */
+	void rasterizeTriangle(const Triangle& tri, int32_t minY, int32_t maxY);
+};
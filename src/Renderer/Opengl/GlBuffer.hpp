@@ -33,6 +33,7 @@ public:
 	GlBuffer(uint32_t usage, BufferStorage storage, size_t size) :
 		Buffer(size),
 		bufferId(0),
+		mappedMem(nullptr),
 		logger(Engine::instance->getConfig().rendererLog) {
 
 		glGenBuffers(1, &bufferId);
@@ -44,6 +45,7 @@ public:
 			case BufferStorage::DEVICE: glUsage = GL_STATIC_DRAW; break;
 			case BufferStorage::DEVICE_HOST_VISIBLE: glUsage = GL_DYNAMIC_DRAW; break;
 			case BufferStorage::HOST: glUsage = GL_STREAM_DRAW; break;
+			case BufferStorage::STREAMING: glUsage = GL_STREAM_DRAW; break;
 			default: throw std::runtime_error("Missing BufferUsage case in switch statement!");
 		}
 
@@ -52,10 +54,34 @@ public:
 		if (usage & Buffer::Usage::VERTEX_BUFFER) bindPoint = GL_ARRAY_BUFFER;
 		else if (usage & Buffer::Usage::INDEX_BUFFER) bindPoint = GL_ELEMENT_ARRAY_BUFFER;
 		else if (usage & Buffer::Usage::UNIFORM_BUFFER) bindPoint = GL_UNIFORM_BUFFER;
+		else if (usage & Buffer::Usage::INDIRECT_BUFFER) bindPoint = GL_DRAW_INDIRECT_BUFFER;
 
-		//Allocate buffer memory
 		glBindBuffer(bindPoint, bufferId);
-		glBufferData(bindPoint, size, nullptr, glUsage);
+
+		//Streaming buffers are mapped once and left that way if the driver allows it, so writes are
+		//just a memcpy. The mapping is coherent because draws using the data are issued between writes,
+		//and an explicit flush would be needed before each one.
+		if (storage == BufferStorage::STREAMING && GLAD_GL_ARB_buffer_storage && size > 0) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+			glBufferStorage(bindPoint, size, nullptr, flags);
+			mappedMem = (unsigned char*) glMapBufferRange(bindPoint, 0, size, flags);
+
+			if (mappedMem == nullptr) {
+				throw std::runtime_error("Failed to map streaming buffer!");
+			}
+		}
+		else {
+			//Allocate buffer memory
+			glBufferData(bindPoint, size, nullptr, glUsage);
+		}
+	}
+
+	/**
+	 * Deletes the buffer, which also unmaps it.
+	 */
+	~GlBuffer() {
+		glDeleteBuffers(1, &bufferId);
 	}
 
 	/**
@@ -76,6 +102,11 @@ public:
 			throw std::runtime_error("Attempt to write past end of buffer!");
 		}
 
+		if (mappedMem) {
+			memcpy(mappedMem + offset, data, size);
+			return;
+		}
+
 		//Just let the driver figure it out for now, this is legacy anyway.
 		glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
 
@@ -84,9 +115,17 @@ public:
 		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
 	}
 
+	/**
+	 * Gets the persistently mapped memory of a streaming buffer.
+	 * @return The mapped memory, or nullptr if the buffer isn't mapped.
+	 */
+	unsigned char* getMappedMemory() override { return mappedMem; }
+
 private:
 	//Buffer object.
 	GLuint bufferId;
+	//The persistently mapped buffer memory, or null if the buffer isn't streaming.
+	unsigned char* mappedMem;
 	//Logger for the buffer.
 	Logger logger;
 };
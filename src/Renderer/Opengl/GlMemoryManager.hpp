@@ -73,4 +73,9 @@ protected:
 	 * @param material The material to allocate a descriptor set for.
 	 */
 	void addMaterialDescriptors(const Material* material) override {}
+
+	/**
+	 * Waits for all submitted commands to finish.
+	 */
+	void waitIdle() override { glFinish(); }
 };
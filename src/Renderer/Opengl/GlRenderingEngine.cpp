@@ -35,7 +35,8 @@ GlRenderingEngine::GlRenderingEngine(DisplayEngine& display, const LogConfig& re
 					&memoryManager,
 					rendererLog),
 	interface(display, this),
-	memoryManager(rendererLog) {
+	memoryManager(rendererLog),
+	frameFences() {
 
 	if (!glfwInit()) {
 		throw std::runtime_error("Couldn't initialize glfw");
@@ -62,6 +63,14 @@ GlRenderingEngine::~GlRenderingEngine() {
 
 	shaderMap.clear();
 
+	//Delete fences
+
+	for (GLsync fence : frameFences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+		}
+	}
+
 	//Clear out memory manager
 
 	memoryManager.deleteObjects();
@@ -153,135 +162,188 @@ void GlRenderingEngine::setViewport(int width, int height) {
 	glViewport(0, 0, width, height);
 }
 
+void GlRenderingEngine::beginFrame() {
+	GLsync& fence = frameFences.at(currentFrame);
+
+	if (fence != nullptr) {
+		//Same timeout as vulkan, if it takes this long something is very wrong.
+		if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 20u * 1'000'000'000u) == GL_TIMEOUT_EXPIRED) {
+			throw std::runtime_error("Fence wait timed out!");
+		}
+
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
 void GlRenderingEngine::apiPresent() {
+	frameFences.at(currentFrame) = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	glfwSwapBuffers(interface.getWindow());
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void GlRenderingEngine::renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) {
+void GlRenderingEngine::renderObjects(const DrawList& drawList, const Screen* screen) {
 	const Camera* camera = screen->getCamera().get();
 	const ScreenState* state = screen->getState().get();
 
-	renderTransparencyPass(RenderPass::OPAQUE, sortedObjects, camera, state);
-	renderTransparencyPass(RenderPass::TRANSPARENT, sortedObjects, camera, state);
-	renderTransparencyPass(RenderPass::TRANSLUCENT, sortedObjects, camera, state);
-
-	glBindVertexArray(0);
-
-	//Clear depth and stencil for next screen
-	glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-}
-
-void GlRenderingEngine::renderTransparencyPass(RenderPass pass, const RenderManager::RenderPassList& objects, const Camera* camera, const ScreenState* state) {
-	bool enableBlend = pass == RenderPass::TRANSLUCENT;
+	const GlShader* shader = nullptr;
+	const UniformLayout* objectLayout = nullptr;
+	const Material* material = nullptr;
+	size_t maxInstances = 0;
 	bool blendOn = false;
+	//Whether the current shader's screen uniforms were written, see RendererMemoryManager::writePerFrameUniforms.
+	bool screenSetWritten = true;
 
-	for (const auto& shaderObjectMap : objects) {
-		for (const auto& modelMap : shaderObjectMap.second) {
-			const std::string& shaderName = modelMap.first;
-			const std::shared_ptr<GlShader> shader = shaderMap.at(shaderName);
-			bool shaderBound = false;
-			bool screenSetBound = false;
+	//Uniform binding indices for the current shader and material.
+	size_t materialIndex = 0;
+	size_t objectIndex = 0;
 
-			//Skip these objects if their shader isn't in the current render pass
-			if (shader->renderPass != pass) {
-				continue;
-			}
-
-			for (const auto& objectSet : modelMap.second) {
-				const Material* material = objectSet.first;
-				bool materialSetBound = false;
+	for (size_t pass = 0; pass < DrawList::PASS_COUNT; pass++) {
+		const std::vector<DrawItem>& items = drawList.getItems((RenderPass) pass);
 
-				for (const RenderComponent* comp : objectSet.second) {
-					if (comp->isVisible()) {
-						//Set shader / buffer / blend if needed
-						if (!shaderBound) {
-							glUseProgram(shader->id);
-							glBindVertexArray(shader->vao);
-
-							const Mesh* mesh = comp->getModel().mesh;
-							const VertexFormat* format = mesh->getFormat();
-							const Mesh::BufferInfo& buffers = mesh->getBufferInfo();
+		//Passes are drawn in order, so blending stays on once translucent objects are reached
+		if (!blendOn && !items.empty() && (RenderPass) pass == RenderPass::TRANSLUCENT) {
+			glEnable(GL_BLEND);
+			blendOn = true;
+		}
 
-							glBindVertexBuffer(0, ((GlBuffer*)buffers.vertex)->getBufferId(), 0, format->getVertexSize());
-							glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ((GlBuffer*)buffers.index)->getBufferId());
+		for (size_t i = 0, end = 0; i < items.size(); i = end) {
+			const uint64_t key = items.at(i).key;
+			const RenderComponent* comp = items.at(i).object;
+			const bool newShader = i == 0 || DrawList::getShader(key) != DrawList::getShader(items.at(i - 1).key);
+			const bool newBuffer = newShader || DrawList::getBuffer(key) != DrawList::getBuffer(items.at(i - 1).key);
+			const bool newBatch = newBuffer || DrawList::getBatch(key) != DrawList::getBatch(items.at(i - 1).key);
+
+			if (newShader) {
+				shader = shaderMap.at(comp->getModel().material->shader).get();
+
+				glUseProgram(shader->id);
+				glBindVertexArray(shader->vao);
+
+				maxInstances = shader->objectSet.empty() ? 0 : memoryManager.getUniformSet(shader->objectSet).getMaxInstances();
+				objectLayout = shader->objectSet.empty() ? nullptr : &memoryManager.getUniformLayout(shader->objectSet);
+				materialIndex = 0;
+				screenSetWritten = true;
+
+				//Set screen set
+				if (!shader->screenSet.empty()) {
+					const UniformLayout& screenLayout = memoryManager.getUniformLayout(shader->screenSet);
+					GlBuffer* uniBuf = (GlBuffer*) memoryManager.getUniformBuffer(RendererMemoryManager::UniformBufferType::SCREEN_OBJECT);
+					uint32_t offset = 0;
+					screenSetWritten = memoryManager.writePerFrameUniforms(screenLayout.getSize(), currentFrame, offset, [&](unsigned char* block) {
+						packScreenUniforms(screenLayout, block, state, camera);
+					});
+					uintptr_t size = screenLayout.getSize();
+
+					glBindBufferRange(GL_UNIFORM_BUFFER, materialIndex, uniBuf->getBufferId(), offset, size);
+					materialIndex++;
+				}
+			}
 
-							shaderBound = true;
-						}
+			//Objects sharing a mesh and material are drawn together if the shader allows it, and
+			//opaque objects sharing only a material are drawn with one indirect draw.
+			const bool indirect = maxInstances && DrawList::getPass(key) == RenderPass::OPAQUE;
 
-						if (enableBlend && !blendOn) {
-							glEnable(GL_BLEND);
-							blendOn = true;
-						}
+			if (indirect) {
+				end = buildIndirectCommands(items, i, maxInstances, indirectCommands);
+			}
+			else {
+				end = maxInstances ? getInstanceGroupEnd(items, i, maxInstances) : i + 1;
+			}
 
-						size_t nextUniformIndex = 0;
+			//Out of per-frame uniform space, so nothing using this shader can be drawn correctly this frame
+			if (!screenSetWritten) {
+				continue;
+			}
 
-						//Set screen set
-						if (!shader->screenSet.empty()) {
-							if (!screenSetBound) {
-								Std140Aligner& screenAligner = memoryManager.getDescriptorAligner(shader->screenSet);
+			//Vertex buffer bindings are part of the vao, so these need to be rebound when the shader changes too
+			if (newBuffer) {
+				const Mesh* mesh = items.at(i).mesh;
+				const VertexFormat* format = mesh->getFormat();
+				const Mesh::BufferInfo& buffers = mesh->getBufferInfo();
 
-								setPerScreenUniforms(memoryManager.getUniformSet(shader->screenSet), screenAligner, state, camera);
-								GlBuffer* uniBuf = (GlBuffer*) memoryManager.getUniformBuffer(RendererMemoryManager::UniformBufferType::SCREEN_OBJECT);
-								uintptr_t offset = memoryManager.writePerFrameUniforms(screenAligner, currentFrame);
-								uintptr_t size = screenAligner.getData().second;
+				glBindVertexBuffer(0, ((GlBuffer*)buffers.vertex)->getBufferId(), 0, format->getVertexSize());
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ((GlBuffer*)buffers.index)->getBufferId());
+			}
 
-								glBindBufferRange(GL_UNIFORM_BUFFER, nextUniformIndex, uniBuf->getBufferId(), offset, size);
-								screenSetBound = true;
-							}
+			//Set material set
+			if (newBatch) {
+				material = comp->getModel().material;
+				objectIndex = materialIndex;
 
-							nextUniformIndex++;
-						}
+				if (material->hasBufferedUniforms) {
+					GlBuffer* uniBuf = (GlBuffer*) memoryManager.getUniformBuffer(RendererMemoryManager::UniformBufferType::MATERIAL);
+					uintptr_t offset = material->uniformOffset;
+					uintptr_t size = material->uniforms.getData().second;
 
-						//Set material set
-						if (!materialSetBound) {
-							if (material->hasBufferedUniforms) {
-								GlBuffer* uniBuf = (GlBuffer*) memoryManager.getUniformBuffer(RendererMemoryManager::UniformBufferType::MATERIAL);
-								uintptr_t offset = material->uniformOffset;
-								uintptr_t size = material->uniforms.getData().second;
+					glBindBufferRange(GL_UNIFORM_BUFFER, materialIndex, uniBuf->getBufferId(), offset, size);
+					objectIndex++;
+				}
 
-								glBindBufferRange(GL_UNIFORM_BUFFER, nextUniformIndex, uniBuf->getBufferId(), offset, size);
-							}
+				//Bind textures
+				for (size_t j = 0; j < material->textures.size(); j++) {
+					glActiveTexture(GL_TEXTURE0 + j);
+					const GlTextureData& texData = textureMap.at(material->textures.at(j));
+					glBindTexture(texData.type, texData.id);
+				}
+			}
 
-							//Bind textures
-							for (size_t i = 0; i < material->textures.size(); i++) {
-								glActiveTexture(GL_TEXTURE0 + i);
-								const GlTextureData& texData = textureMap.at(material->textures.at(i));
-								glBindTexture(texData.type, texData.id);
-							}
+			//Set object set, as one array for the whole group if instanced
+			bool objectSetWritten = true;
 
-							materialSetBound = true;
-						}
+			if (objectLayout) {
+				GlBuffer* uniBuf = (GlBuffer*) memoryManager.getUniformBuffer(RendererMemoryManager::UniformBufferType::SCREEN_OBJECT);
+				uint32_t offset = 0;
+				uintptr_t size = 0;
 
-						if (material->hasBufferedUniforms) {
-							nextUniformIndex++;
-						}
+				if (maxInstances) {
+					objectSetWritten = memoryManager.writePerFrameUniforms(objectLayout->getInstanceStride() * (end - i), currentFrame, offset, [&](unsigned char* block) {
+						packInstanceUniforms(*objectLayout, block, items, i, end, camera);
+					});
+					size = objectLayout->getInstanceStride() * maxInstances;
+				}
+				else {
+					objectSetWritten = memoryManager.writePerFrameUniforms(objectLayout->getSize(), currentFrame, offset, [&](unsigned char* block) {
+						packObjectUniforms(*objectLayout, block, comp, camera);
+					});
+					size = objectLayout->getSize();
+				}
 
-						//Set object set
-						if (!shader->objectSet.empty()) {
-							Std140Aligner& objectAligner = memoryManager.getDescriptorAligner(shader->objectSet);
+				glBindBufferRange(GL_UNIFORM_BUFFER, objectIndex, uniBuf->getBufferId(), offset, size);
+			}
 
-							setPerObjectUniforms(memoryManager.getUniformSet(shader->objectSet), objectAligner, comp, camera);
-							GlBuffer* uniBuf = (GlBuffer*) memoryManager.getUniformBuffer(RendererMemoryManager::UniformBufferType::SCREEN_OBJECT);
-							uintptr_t offset = memoryManager.writePerFrameUniforms(objectAligner, currentFrame);
-							uintptr_t size = objectAligner.getData().second;
+			//The bindings above are still made, so later groups can rely on them
+			if (!objectSetWritten) {
+				continue;
+			}
 
-							glBindBufferRange(GL_UNIFORM_BUFFER, nextUniformIndex, uniBuf->getBufferId(), offset, size);
-						}
+			//Instanced shaders can't have per-object push constants, so the first object's values work for the whole group
+			setPushConstants(shader, comp, camera);
 
-						setPushConstants(shader.get(), comp, camera);
+			if (indirect) {
+				size_t commandOffset = 0;
 
-						const std::tuple<uintptr_t, uint32_t, int32_t> meshInfo = comp->getModel().mesh->getRenderInfo();
-						glDrawElementsBaseVertex(GL_TRIANGLES, std::get<1>(meshInfo), GL_UNSIGNED_INT, (void*) (std::get<0>(meshInfo) * sizeof(uint32_t)), std::get<2>(meshInfo));
-					}
+				//Skipped if out of space, like uniforms
+				if (memoryManager.writeIndirectCommands(indirectCommands.data(), indirectCommands.size(), currentFrame, commandOffset)) {
+					glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ((const GlBuffer*) memoryManager.getIndirectBuffer())->getBufferId());
+					glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*) commandOffset, indirectCommands.size(), 0);
 				}
 			}
+			else {
+				const std::tuple<uintptr_t, uint32_t, int32_t> meshInfo = items.at(i).mesh->getRenderInfo();
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, std::get<1>(meshInfo), GL_UNSIGNED_INT, (void*) (std::get<0>(meshInfo) * sizeof(uint32_t)), end - i, std::get<2>(meshInfo));
+			}
 		}
 	}
 
 	if (blendOn) {
 		glDisable(GL_BLEND);
 	}
+
+	glBindVertexArray(0);
+
+	//Clear depth and stencil for next screen
+	glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 }
 
 void GlRenderingEngine::setPushConstants(const GlShader* shader, const RenderComponent* comp, const Camera* camera) {
@@ -291,7 +353,7 @@ void GlRenderingEngine::setPushConstants(const GlShader* shader, const RenderCom
 		const void* value = nullptr;
 
 		switch (uniform.provider) {
-			case UniformProviderType::OBJECT_MODEL_VIEW: tempMat = camera->getView() * comp->getTransform(); value = &tempMat; break;
+			case UniformProviderType::OBJECT_MODEL_VIEW: tempMat = camera->getRenderView() * comp->getTransform(); value = &tempMat; break;
 			case UniformProviderType::OBJECT_TRANSFORM: tempMat = comp->getTransform(); value = &tempMat; break;
 			case UniformProviderType::OBJECT_STATE: value = comp->getParentState()->getRenderValue(uniform.name); break;
 			default: throw std::runtime_error("Invalid provider type for object uniform set!");
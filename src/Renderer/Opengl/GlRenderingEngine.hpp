@@ -21,6 +21,7 @@
 #include <unordered_map>
 #include <string>
 #include <memory>
+#include <array>
 
 #include <glm/glm.hpp>
 
@@ -70,9 +71,10 @@ public:
 	void finishLoad() override {}
 
 	/**
-	 * Nothing needs to happen here.
+	 * Waits for the gpu to finish the last frame that used the current frame's section
+	 * of the per-frame buffers, since those are written directly while mapped.
 	 */
-	void beginFrame() override {}
+	void beginFrame() override;
 
 	/**
 	 * Called when the window size has changed and the viewport needs to be updated.
@@ -94,11 +96,42 @@ protected:
 	void apiPresent() override;
 
 	/**
-	 * Renders the passed in objects.
-	 * @param sortedObjects A sorted map of maps of maps of sets of all the possible objects to render.
+	 * Renders the passed in objects, only rebinding state when it changes between them.
+	 * @param drawList The sorted list of objects to render.
 	 * @param screen The screen to render.
 	 */
-	void renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) override;
+	void renderObjects(const DrawList& drawList, const Screen* screen) override;
+
+	/**
+	 * Gets the render pass for the given shader.
+	 * @param shader The shader's name.
+	 * @return The shader's render pass.
+	 */
+	RenderPass getShaderPass(const std::string& shader) const override { return shaderMap.at(shader)->renderPass; }
+
+	/**
+	 * Gets the maximum instances for the given shader.
+	 * @param shader The shader's name.
+	 * @return The max instances of the shader's object set, or 0 if not instanced.
+	 */
+	size_t getShaderMaxInstances(const std::string& shader) const override {
+		const std::string& objectSet = shaderMap.at(shader)->objectSet;
+		return objectSet.empty() ? 0 : memoryManager.getUniformSet(objectSet).getMaxInstances();
+	}
+
+	/**
+	 * Gets the per-screen uniform set for the given shader.
+	 * @param shader The shader's name.
+	 * @return The name of the set, or an empty string if not present.
+	 */
+	const std::string& getShaderScreenSet(const std::string& shader) const override { return shaderMap.at(shader)->screenSet; }
+
+	/**
+	 * Gets the per-object uniform set for the given shader.
+	 * @param shader The shader's name.
+	 * @return The name of the set, or an empty string if not present.
+	 */
+	const std::string& getShaderObjectSet(const std::string& shader) const override { return shaderMap.at(shader)->objectSet; }
 
 private:
 	//A map to store texture data
@@ -109,15 +142,10 @@ private:
 	GlfwInterface interface;
 	//The memory manager, for buffer management and such.
 	GlMemoryManager memoryManager;
-
-	/**
-	 * Renders all the objects in objects. Transparency stuff is set up before this function is called.
-	 * @param pass The current rendering pass.
-	 * @param objects A container of the objects to render. See RenderComponentManager.hpp for what it actually is.
-	 * @param camera The camera to use when rendering.
-	 * @param state The screen state, passed to shaders when setting uniforms.
-	 */
-	void renderTransparencyPass(RenderPass pass, const RenderManager::RenderPassList& objects, const Camera* camera, const ScreenState* state);
+	//Scratch space for indirect commands.
+	std::vector<IndirectDrawCommand> indirectCommands;
+	//Signaled when each frame in flight finishes on the gpu, or null if the frame hasn't been rendered yet.
+	std::array<GLsync, MAX_ACTIVE_FRAMES> frameFences;
 
 	/**
 	 * Emulates push constants from Vulkan. Really, this just sets uniform locations in the provided
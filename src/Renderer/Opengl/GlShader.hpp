@@ -38,6 +38,8 @@ public:
 	const PushConstantSet pushConstants;
 	//The vertex attribute array.
 	const GLuint vao;
+	//Buffer holding instance indices for instanced shaders, 0 if not instanced.
+	const GLuint instanceBuffer;
 
 	/**
 	 * Creates a GlShader with the given id.
@@ -48,20 +50,26 @@ public:
 	 * @param pushConstants Push constants for this shader, these will never be buffered
 	 *     even if uniform buffers are implemented (will always use glUniform*).
 	 * @param vao The vertex attribute array for this shader.
+	 * @param instanceBuffer The instance index buffer bound in the vao, or 0 if not present.
 	 */
-	GlShader(GLuint id, RenderPass pass, const std::string& screenSet, const std::string& objectSet, const std::vector<UniformDescription>& pushConstants, GLuint vao) :
+	GlShader(GLuint id, RenderPass pass, const std::string& screenSet, const std::string& objectSet, const std::vector<UniformDescription>& pushConstants, GLuint vao, GLuint instanceBuffer) :
 		id(id),
 		renderPass(pass),
 		screenSet(screenSet),
 		objectSet(objectSet),
 		pushConstants(pushConstants),
-		vao(vao) {}
+		vao(vao),
+		instanceBuffer(instanceBuffer) {}
 
 	/**
 	 * Destructor. Destroys the program object.
 	 */
 	~GlShader() {
 		glDeleteProgram(id);
+
+		if (instanceBuffer != 0) {
+			glDeleteBuffers(1, &instanceBuffer);
+		}
 	}
 
 	/**
@@ -18,6 +18,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 #include "GlShaderLoader.hpp"
 #include "GlShader.hpp"
@@ -51,11 +52,20 @@ void GlShaderLoader::loadShader(std::string name, const ShaderInfo& info) {
 		}
 	}
 
+	validateInstancing(name, info, objectSet.empty() ? nullptr : &memoryManager->getUniformSet(objectSet));
+
+	const size_t maxInstances = objectSet.empty() ? 0 : memoryManager->getUniformSet(objectSet).getMaxInstances();
+
 	//Create input attribute format
 	const VertexFormat* format = Engine::instance->getModelManager().getFormat(info.format);
 	GLuint vao = createAttributeArray(format);
+	GLuint instanceBuffer = 0;
+
+	if (maxInstances > 0) {
+		instanceBuffer = createInstanceIndexBuffer(format, maxInstances);
+	}
 
-	std::shared_ptr<GlShader> shader = std::make_shared<GlShader>(createProgram(info.vertex, info.fragment), info.pass, screenSet, objectSet, info.pushConstants, vao);
+	std::shared_ptr<GlShader> shader = std::make_shared<GlShader>(createProgram(info.vertex, info.fragment), info.pass, screenSet, objectSet, info.pushConstants, vao, instanceBuffer);
 	shaderMap.emplace(name, shader);
 
 	//Cache push constant locations for faster lookup later
@@ -92,6 +102,32 @@ GLuint GlShaderLoader::createAttributeArray(const VertexFormat* format) {
 	return vao;
 }
 
+GLuint GlShaderLoader::createInstanceIndexBuffer(const VertexFormat* format, size_t maxInstances) {
+	std::vector<uint32_t> indices(maxInstances);
+
+	for (size_t i = 0; i < indices.size(); i++) {
+		indices.at(i) = i;
+	}
+
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	//Vertex data uses binding 0, so instance data goes in binding 1
+	const GLuint attribute = format->getFormatVec().size();
+
+	glEnableVertexAttribArray(attribute);
+	glVertexAttribIFormat(attribute, 1, GL_UNSIGNED_INT, 0);
+	glVertexAttribBinding(attribute, 1);
+	glBindVertexBuffer(1, buffer, 0, sizeof(uint32_t));
+	glVertexBindingDivisor(1, 1);
+
+	ENGINE_LOG_DEBUG(logger, "    Binding " + std::to_string(attribute) + ": Instance index, " + std::to_string(maxInstances) + " instances");
+
+	return buffer;
+}
+
 GLuint GlShaderLoader::createProgram(std::string vertexName, std::string fragmentName) {
 	//Create shaders and program
 
@@ -56,6 +56,16 @@ private:
 	 */
 	GLuint createAttributeArray(const VertexFormat* format);
 
+	/**
+	 * Creates a buffer of instance indices and adds it to the currently bound attribute array
+	 * as a per-instance uint input, after the vertex format's inputs. Unlike gl_InstanceID,
+	 * this includes the base instance, which indirect draws need.
+	 * @param format The vertex format of the attribute array.
+	 * @param maxInstances The number of indices in the buffer.
+	 * @return The created buffer.
+	 */
+	GLuint createInstanceIndexBuffer(const VertexFormat* format, size_t maxInstances);
+
 	/**
 	 * Creates a program object using the shaders with the specified filenames.
 	 * @param vertexName The path to the vertex shader.
@@ -146,7 +146,7 @@ void PhysDebRenderingEngine::flushLines() {
 
 	glUseProgram(lineProg);
 
-	glm::mat4 modelView = currentCamera->getView();
+	glm::mat4 modelView = currentCamera->getRenderView();
 	glm::mat4 projection = currentCamera->getProjection();
 
 	GLuint mvLoc = glGetUniformLocation(lineProg, "modelView");
@@ -160,19 +160,23 @@ void PhysDebRenderingEngine::flushLines() {
 	pendingLines = 0;
 }
 
-void PhysDebRenderingEngine::renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) {
+void PhysDebRenderingEngine::renderObjects(const DrawList& drawList, const Screen* screen) {
 	//Get physics component manager and do debug drawing stuff
 	const PhysicsManager* physicsManager = std::static_pointer_cast<const PhysicsManager>(screen->getManager(PHYSICS_COMPONENT_NAME)).get();
 
 	if (physicsManager) {
-		btCollisionWorld* world = physicsManager->getWorld();
 		currentCamera = screen->getCamera().get();
 
-		world->setDebugDrawer(this);
-		world->debugDrawWorld();
+		//Don't draw while a background step is moving things around.
+		physicsManager->waitForStep();
+
+		for (btCollisionWorld* world : physicsManager->getWorlds()) {
+			world->setDebugDrawer(this);
+			world->debugDrawWorld();
+		}
 
 		flushLines();
 	}
 
-	GlRenderingEngine::renderObjects(sortedObjects, screen);
+	GlRenderingEngine::renderObjects(drawList, screen);
 }
@@ -102,10 +102,10 @@ public:
 protected:
 	/**
 	 * Renders the objects as normal, but also renders a physics debug layer if present.
-	 * @param sortedObjects A sorted map of maps of maps of sets of all the possible objects to render.
+	 * @param drawList The sorted list of objects to render.
 	 * @param screen The screen being rendered.
 	 */
-	void renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) override;
+	void renderObjects(const DrawList& drawList, const Screen* screen) override;
 
 private:
 	//Line vertex format.
@@ -7,16 +7,16 @@
     APIs: gl=4.3
     Profile: core
     Extensions:
-
+        GL_ARB_buffer_storage
     Loader: True
     Local files: False
     Omit khrplatform: False
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=4.3" --generator="c" --spec="gl" --extensions=""
+        --profile="core" --api="gl=4.3" --generator="c" --spec="gl" --extensions="GL_ARB_buffer_storage"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.3
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.3&extensions=GL_ARB_buffer_storage
 */
 
 #include <stdio.h>
@@ -833,6 +833,8 @@ PFNGLVIEWPORTARRAYVPROC glad_glViewportArrayv = NULL;
 PFNGLVIEWPORTINDEXEDFPROC glad_glViewportIndexedf = NULL;
 PFNGLVIEWPORTINDEXEDFVPROC glad_glViewportIndexedfv = NULL;
 PFNGLWAITSYNCPROC glad_glWaitSync = NULL;
+int GLAD_GL_ARB_buffer_storage = 0;
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = NULL;
 static void load_GL_VERSION_1_0(GLADloadproc load) {
 	if(!GLAD_GL_VERSION_1_0) return;
 	glad_glCullFace = (PFNGLCULLFACEPROC)load("glCullFace");
@@ -1449,9 +1451,13 @@ static void load_GL_VERSION_4_3(GLADloadproc load) {
 	glad_glGetObjectPtrLabel = (PFNGLGETOBJECTPTRLABELPROC)load("glGetObjectPtrLabel");
 	glad_glGetPointerv = (PFNGLGETPOINTERVPROC)load("glGetPointerv");
 }
+static void load_GL_ARB_buffer_storage(GLADloadproc load) {
+	if(!GLAD_GL_ARB_buffer_storage) return;
+	glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+}
 static int find_extensionsGL(void) {
 	if (!get_exts()) return 0;
-	(void)&has_ext;
+	GLAD_GL_ARB_buffer_storage = has_ext("GL_ARB_buffer_storage");
 	free_exts();
 	return 1;
 }
@@ -1538,6 +1544,7 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_VERSION_4_3(load);
 
 	if (!find_extensionsGL()) return 0;
+	load_GL_ARB_buffer_storage(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
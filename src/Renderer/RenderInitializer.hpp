@@ -59,8 +59,10 @@ public:
 	 * @param set The list of uniforms to add. When creating the shader bindings, the
 	 *     uniform buffer, if present, will always recieve binding 0, followed by non-
 	 *     buffered unforms, such as samplers, in the order they are listed.
+	 * @param maxInstances For PER_OBJECT sets, the length of the instance array in the shader,
+	 *     or 0 to draw each object separately. See UniformSet.
 	 */
-	void addUniformSet(const std::string& name, UniformSetType type, size_t maxUsers, const UniformList& uniforms) { memoryManager->addUniformSet(name, UniformSet(type, maxUsers, uniforms)); }
+	void addUniformSet(const std::string& name, UniformSetType type, size_t maxUsers, const UniformList& uniforms, size_t maxInstances = 0) { memoryManager->addUniformSet(name, UniformSet(type, maxUsers, uniforms, maxInstances)); }
 
 private:
 	//The logger.
@@ -16,6 +16,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 
+#include <algorithm>
+
 #include "RendererMemoryManager.hpp"
 #include "RenderingEngine.hpp"
 #include "ExtraMath.hpp"
@@ -23,7 +25,10 @@
 RendererMemoryManager::RendererMemoryManager(const LogConfig& logConfig) :
 	logger(logConfig),
 	currentUniformOffset(0),
-	screenObjectBufferSize(0) {}
+	screenObjectBufferSize(0),
+	instanceBindPadding(0),
+	currentIndirectOffset(0),
+	indirectBufferSize(0) {}
 
 void RendererMemoryManager::uniformBufferInit() {
 	size_t materialSize = 0;
@@ -38,6 +43,16 @@ void RendererMemoryManager::uniformBufferInit() {
 		size_t alignedSize = ExMath::roundToVal(partiallyAlignedSize, getMinUniformBufferAlignment());
 		alignedSize *= set.getMaxUsers();
 
+		//Instanced sets are bound with the size of the full array, which can run past the last
+		//written instance, so leave room for that at the end.
+		if (set.getMaxInstances()) {
+			alignedSize += Std140Aligner::getBlockSize(set);
+			instanceBindPadding = std::max(instanceBindPadding, Std140Aligner::getBlockSize(set));
+
+			//Every indirect command draws at least one object
+			indirectBufferSize += sizeof(IndirectDrawCommand) * set.getMaxUsers();
+		}
+
 		switch (set.getType()) {
 			case UniformSetType::MATERIAL: materialSize += alignedSize; break;
 			case UniformSetType::PER_SCREEN: screenObjectSize += alignedSize; break;
@@ -50,7 +65,11 @@ void RendererMemoryManager::uniformBufferInit() {
 	screenObjectSize *= RenderingEngine::MAX_ACTIVE_FRAMES;
 
 	uniformBuffers.at(UniformBufferType::MATERIAL) = createBuffer(Buffer::Usage::UNIFORM_BUFFER | Buffer::Usage::TRANSFER_DST, BufferStorage::DEVICE, materialSize);
-	uniformBuffers.at(UniformBufferType::SCREEN_OBJECT) = createBuffer(Buffer::Usage::UNIFORM_BUFFER, BufferStorage::DEVICE_HOST_VISIBLE, screenObjectSize);
+	uniformBuffers.at(UniformBufferType::SCREEN_OBJECT) = createBuffer(Buffer::Usage::UNIFORM_BUFFER, BufferStorage::STREAMING, screenObjectSize);
+
+	if (indirectBufferSize > 0) {
+		indirectBuffer = createBuffer(Buffer::Usage::INDIRECT_BUFFER, BufferStorage::STREAMING, indirectBufferSize * RenderingEngine::MAX_ACTIVE_FRAMES);
+	}
 }
 
 void RendererMemoryManager::addBuffer(const std::string& name, size_t size, BufferType type, BufferStorage storage) {
@@ -153,17 +172,115 @@ void RendererMemoryManager::addMaterial(Material* material) {
 	addMaterialDescriptors(material);
 }
 
-uint32_t RendererMemoryManager::writePerFrameUniforms(const Std140Aligner& uniformProvider, size_t currentFrame) {
-	const unsigned char* writeData = uniformProvider.getData().first;
-	const size_t writeSize = uniformProvider.getData().second;
+void RendererMemoryManager::reservePerFrameSpace(size_t writeSize, size_t writeCount, size_t commandCount) {
+	const size_t requiredSize = currentUniformOffset + writeSize + writeCount * (getMinUniformBufferAlignment() - 1) + instanceBindPadding;
+	const size_t requiredCommandSize = currentIndirectOffset + sizeof(IndirectDrawCommand) * commandCount;
+
+	//Once something's been written, commands referring to the buffer might already be recorded
+	if (requiredSize > screenObjectBufferSize && currentUniformOffset == 0) {
+		growScreenObjectBuffer(requiredSize);
+	}
+
+	if (requiredCommandSize > indirectBufferSize && currentIndirectOffset == 0) {
+		growIndirectBuffer(requiredCommandSize);
+	}
+}
+
+bool RendererMemoryManager::writePerFrameUniforms(const unsigned char* writeData, size_t writeSize, size_t currentFrame, uint32_t& offset) {
+	if (!reservePerFrameUniforms(writeSize, currentFrame, offset)) {
+		return false;
+	}
+
+	uniformBuffers.at(UniformBufferType::SCREEN_OBJECT)->write(offset, writeSize, writeData);
+	return true;
+}
+
+bool RendererMemoryManager::reservePerFrameUniforms(size_t writeSize, size_t currentFrame, uint32_t& offset) {
+	//Reserve space without locking. Every reservation is rounded to the alignment, so every offset stays aligned.
+	const uint32_t reserveSize = ExMath::roundToVal<uint32_t>(writeSize, getMinUniformBufferAlignment());
+	const uint32_t reserveOffset = currentUniformOffset.fetch_add(reserveSize);
+	const size_t frameStart = screenObjectBufferSize * currentFrame;
+
+	//The buffer can't be replaced while other threads are writing to it, so overflowing writes are dropped
+	//and the offset keeps counting up, to find the size needed when the frame is done. The start of the
+	//section is returned so anything bound with the offset stays in bounds.
+	if (reserveOffset + reserveSize + instanceBindPadding > screenObjectBufferSize) {
+		offset = frameStart;
+		return false;
+	}
+
+	offset = frameStart + reserveOffset;
+	return true;
+}
+
+bool RendererMemoryManager::writeIndirectCommands(const IndirectDrawCommand* commands, size_t count, size_t currentFrame, size_t& offset) {
+	const size_t writeSize = sizeof(IndirectDrawCommand) * count;
+	const uint32_t reserveOffset = currentIndirectOffset.fetch_add(writeSize);
+
+	//Same as uniforms, the offset keeps counting so the buffer can be grown to fit once the frame is done
+	if (reserveOffset + writeSize > indirectBufferSize) {
+		return false;
+	}
+
+	offset = indirectBufferSize * currentFrame + reserveOffset;
+	indirectBuffer->write(offset, writeSize, (const unsigned char*) commands);
+
+	return true;
+}
+
+void RendererMemoryManager::flushPerFrameData(size_t currentFrame) {
+	const size_t uniformSize = std::min<size_t>(currentUniformOffset, screenObjectBufferSize);
+
+	if (uniformSize > 0) {
+		uniformBuffers.at(UniformBufferType::SCREEN_OBJECT)->flush(screenObjectBufferSize * currentFrame, uniformSize);
+	}
+
+	const size_t commandSize = std::min<size_t>(currentIndirectOffset, indirectBufferSize);
+
+	if (commandSize > 0) {
+		indirectBuffer->flush(indirectBufferSize * currentFrame, commandSize);
+	}
+}
+
+void RendererMemoryManager::resetPerFrameOffset() {
+	const size_t requiredSize = currentUniformOffset + instanceBindPadding;
+
+	if (requiredSize > screenObjectBufferSize) {
+		growScreenObjectBuffer(requiredSize);
+	}
+
+	if (currentIndirectOffset > indirectBufferSize) {
+		growIndirectBuffer(currentIndirectOffset);
+	}
+
+	currentUniformOffset = 0;
+	currentIndirectOffset = 0;
+}
+
+void RendererMemoryManager::growScreenObjectBuffer(size_t requiredSize) {
+	//At least double the size, so a slowly increasing object count doesn't stall every frame
+	const size_t newSize = ExMath::roundToVal(std::max(requiredSize, screenObjectBufferSize * 2), getMinUniformBufferAlignment());
+
+	ENGINE_LOG_WARN(logger, "Ran out of per-frame uniform space, growing from " + std::to_string(screenObjectBufferSize) + " to " + std::to_string(newSize) + " bytes per frame");
+
+	//Frames still in flight are reading from the old buffer
+	waitIdle();
+
+	uniformBuffers.at(UniformBufferType::SCREEN_OBJECT) = createBuffer(Buffer::Usage::UNIFORM_BUFFER, BufferStorage::STREAMING, newSize * RenderingEngine::MAX_ACTIVE_FRAMES);
+	screenObjectBufferSize = newSize;
+
+	uniformBufferReplaced(UniformBufferType::SCREEN_OBJECT);
+}
 
-	//Handle uniform alignment
-	currentUniformOffset = ExMath::roundToVal<uint32_t>(currentUniformOffset, getMinUniformBufferAlignment());
+void RendererMemoryManager::growIndirectBuffer(size_t requiredSize) {
+	//At least double the size, so a slowly increasing draw count doesn't stall every frame
+	const size_t newSize = std::max(requiredSize, indirectBufferSize * 2);
 
-	const size_t writeOffset = screenObjectBufferSize * currentFrame + currentUniformOffset;
+	ENGINE_LOG_WARN(logger, "Ran out of indirect draw command space, growing from " + std::to_string(indirectBufferSize) + " to " + std::to_string(newSize) + " bytes per frame");
 
-	uniformBuffers.at(UniformBufferType::SCREEN_OBJECT)->write(writeOffset, writeSize, writeData);
-	currentUniformOffset += writeSize;
+	//Frames still in flight are reading from the old buffer
+	waitIdle();
 
-	return writeOffset;
+	indirectBuffer = createBuffer(Buffer::Usage::INDIRECT_BUFFER, BufferStorage::STREAMING, newSize * RenderingEngine::MAX_ACTIVE_FRAMES);
+	indirectBufferSize = newSize;
 }
@@ -22,15 +22,28 @@
 #include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <atomic>
+
+#include <tbb/enumerable_thread_specific.h>
 
 #include "Buffer.hpp"
 #include "MemoryAllocator.hpp"
 #include "EngineConfig.hpp"
 #include "Logger.hpp"
 #include "ShaderInfo.hpp"
+#include "UniformLayout.hpp"
 #include "Models/Material.hpp"
 #include "Models/Mesh.hpp"
 
+//A single indirect draw. OpenGL and Vulkan use the same layout for this.
+struct IndirectDrawCommand {
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
 //An interface to the rendering engine's memory manager.
 class RendererMemoryManager {
 public:
@@ -84,19 +97,18 @@ public:
 		uniformSets.emplace(name, set);
 		createUniformSetType(name, set);
 
-		//Materials hold their own aligners, but screen and object aligners need to go here for now
-		//(Move to RenderComponent/Manager later?)
+		//Materials hold their own aligners, screen and object sets are written every frame from a compiled layout
 		if (set.getType() != UniformSetType::MATERIAL) {
-			descriptorAligners.emplace(name, Std140Aligner(set.getBufferedUniforms()));
+			uniformLayouts.emplace(name, UniformLayout(set));
 		}
 	}
 
 	/**
-	 * Gets the aligner for the given descriptor set.
-	 * @param name The name of the descriptor set.
-	 * @return The aligner for the set.
+	 * Gets the compiled layout for the given per-screen or per-object uniform set.
+	 * @param name The name of the uniform set.
+	 * @return The layout for the set.
 	 */
-	Std140Aligner& getDescriptorAligner(const std::string& name) { return descriptorAligners.at(name); }
+	const UniformLayout& getUniformLayout(const std::string& name) const { return uniformLayouts.at(name); }
 
 	/**
 	 * Gets the buffer with the provided name.
@@ -111,7 +123,7 @@ public:
 	 * @param set The name of the set to get.
 	 * @return The set with the given name.
 	 */
-	const UniformSet& getUniformSet(const std::string& set) { return uniformSets.at(set); }
+	const UniformSet& getUniformSet(const std::string& set) const { return uniformSets.at(set); }
 
 	/**
 	 * Gets the uniform buffer stored at the given type.
@@ -120,6 +132,12 @@ public:
 	 */
 	const Buffer* getUniformBuffer(UniformBufferType type) { return uniformBuffers.at(type).get(); }
 
+	/**
+	 * Gets the buffer indirect draw commands are written to.
+	 * @return The indirect buffer, or null if there are no instanced uniform sets.
+	 */
+	const Buffer* getIndirectBuffer() { return indirectBuffer.get(); }
+
 	/**
 	 * Adds a mesh to the provided buffer, and creates any resources needed to render it.
 	 * If the mesh has already been added, nothing happens.
@@ -145,18 +163,89 @@ public:
 	void addMaterial(Material* material);
 
 	/**
-	 * Writes the provided uniform values into the uniform buffer for the current frame and returns the offset
-	 * they were written at.
-	 * @param uniformProvider The provider of the uniforms.
+	 * Makes sure the per-frame uniform and indirect buffers have room for the given writes on top of
+	 * everything already written this frame. Should be called before recording any commands that use
+	 * the buffers. If nothing has been written to a buffer yet this frame, nothing recorded refers to it,
+	 * so it's grown right away. Otherwise it can't be replaced until the frame is presented, and writes
+	 * that don't fit are skipped.
+	 * @param writeSize The total size of the uniform writes.
+	 * @param writeCount The number of uniform writes, each of which can be padded up to the minimum alignment.
+	 * @param commandCount The number of indirect draw commands.
+	 */
+	void reservePerFrameSpace(size_t writeSize, size_t writeCount, size_t commandCount);
+
+	/**
+	 * Writes the provided uniform values into the uniform buffer for the current frame. Safe to call from
+	 * multiple threads. The buffer is a ring with one section for each frame in flight, and space is taken
+	 * from the current frame's section by bumping an offset. If the section runs out of space, the write is
+	 * skipped and the buffer grows once the frame is presented, so anything using it shouldn't be drawn.
+	 * @param writeData The std140 aligned uniform data.
+	 * @param writeSize The size of the data.
+	 * @param currentFrame The current frame index.
+	 * @param offset Set to the offset the values were written at, or an offset that's
+	 *     still safe to bind if the write was skipped.
+	 * @return Whether the values were written.
+	 */
+	bool writePerFrameUniforms(const unsigned char* writeData, size_t writeSize, size_t currentFrame, uint32_t& offset);
+
+	/**
+	 * Same as above, but the values are packed directly into the uniform buffer by the provided function
+	 * when it's mapped, skipping the extra copy. If it isn't mapped, they're packed into per-thread
+	 * scratch space and written from there.
+	 * @param writeSize The size of the data that will be packed.
 	 * @param currentFrame The current frame index.
-	 * @return The offset the uniform values were written at.
+	 * @param offset Set to the offset the values were written at, or an offset that's
+	 *     still safe to bind if the write was skipped.
+	 * @param pack Called with a pointer to writeSize bytes to pack the values into. Not called
+	 *     if the write is skipped.
+	 * @return Whether the values were written.
 	 */
-	uint32_t writePerFrameUniforms(const Std140Aligner& uniformProvider, size_t currentFrame);
+	template<typename PackFunc>
+	bool writePerFrameUniforms(size_t writeSize, size_t currentFrame, uint32_t& offset, const PackFunc& pack) {
+		if (!reservePerFrameUniforms(writeSize, currentFrame, offset)) {
+			return false;
+		}
+
+		Buffer* uniformBuffer = uniformBuffers.at(UniformBufferType::SCREEN_OBJECT).get();
+		unsigned char* mappedMem = uniformBuffer->getMappedMemory();
+
+		if (mappedMem) {
+			pack(mappedMem + offset);
+		}
+		else {
+			std::vector<unsigned char>& scratch = packScratch.local();
+			scratch.resize(writeSize);
+
+			pack(scratch.data());
+			uniformBuffer->write(offset, writeSize, scratch.data());
+		}
+
+		return true;
+	}
 
 	/**
-	 * Called after each frame completes.
+	 * Writes indirect draw commands into the indirect buffer for the current frame. Safe to call from multiple
+	 * threads. Like the uniform buffer, if the frame's section runs out of space the write is skipped, and the
+	 * buffer grows once the frame is presented.
+	 * @param commands The commands to write.
+	 * @param count The number of commands.
+	 * @param currentFrame The current frame index.
+	 * @param offset Set to the offset the commands were written at.
+	 * @return Whether the commands were written.
 	 */
-	void resetPerFrameOffset() { currentUniformOffset = 0; }
+	bool writeIndirectCommands(const IndirectDrawCommand* commands, size_t count, size_t currentFrame, size_t& offset);
+
+	/**
+	 * Makes everything written to the per-frame uniform and indirect buffers this frame visible to
+	 * the gpu. Called once per frame, before the frame is submitted.
+	 * @param currentFrame The current frame index.
+	 */
+	void flushPerFrameData(size_t currentFrame);
+
+	/**
+	 * Called after each frame completes. Grows the per-frame uniform and indirect buffers if the frame ran out of space.
+	 */
+	void resetPerFrameOffset();
 
 protected:
 	//Logger, logs things.
@@ -172,6 +261,8 @@ protected:
 		for (std::shared_ptr<Buffer>& buf : uniformBuffers) {
 			buf.reset();
 		}
+
+		indirectBuffer.reset();
 	}
 
 	/**
@@ -217,6 +308,18 @@ protected:
 	 */
 	virtual void addMaterialDescriptors(const Material* material) = 0;
 
+	/**
+	 * Blocks until the gpu has finished with all submitted frames, so buffers they use can be replaced.
+	 */
+	virtual void waitIdle() = 0;
+
+	/**
+	 * Called after a uniform buffer is replaced, so anything referring to the old buffer
+	 * (like descriptor sets) can be updated. The gpu will be idle when this is called.
+	 * @param type The uniform buffer that was replaced.
+	 */
+	virtual void uniformBufferReplaced(UniformBufferType type) {}
+
 	/**
 	 * Takes a uniform set type and turns it into a uniform buffer type.
 	 * @param type The uniform buffer type.
@@ -238,12 +341,44 @@ private:
 	std::array<std::shared_ptr<Buffer>, UniformBufferType::NUM_TYPES> uniformBuffers;
 	//Stores all created uniform sets.
 	std::unordered_map<std::string, UniformSet> uniformSets;
-	//Current offset into the object/screen uniform buffer, gets reset each frame.
-	uint32_t currentUniformOffset;
+	//Current offset into the object/screen uniform buffer, gets reset each frame. Atomic so
+	//uniforms can be written from multiple threads while recording commands.
+	std::atomic<uint32_t> currentUniformOffset;
 	//Allowed usage size of the screen object buffer for each frame.
 	size_t screenObjectBufferSize;
-	//Stores one aligner for each per-screen or per-object descriptor set, to avoid dynamic allocation
-	//inside the rendering loop.
-	//TODO: Move to render components and managers.
-	std::unordered_map<std::string, Std140Aligner> descriptorAligners;
+	//Space left unwritten at the end of each frame's section of the screen object buffer. Instanced
+	//sets are bound with the size of the full array, which can run past the last written instance.
+	size_t instanceBindPadding;
+	//Indirect draw commands, split into one section for each frame.
+	std::shared_ptr<Buffer> indirectBuffer;
+	//Current offset into the indirect buffer, reset each frame.
+	std::atomic<uint32_t> currentIndirectOffset;
+	//Size of each frame's section of the indirect buffer.
+	size_t indirectBufferSize;
+	//Compiled layouts for each per-screen or per-object uniform set.
+	std::unordered_map<std::string, UniformLayout> uniformLayouts;
+	//Scratch space for packing uniforms when the uniform buffer isn't mapped.
+	tbb::enumerable_thread_specific<std::vector<unsigned char>> packScratch;
+
+	/**
+	 * Takes space for a write from the current frame's section of the per-frame uniform buffer.
+	 * Safe to call from multiple threads.
+	 * @param writeSize The size of the write.
+	 * @param currentFrame The current frame index.
+	 * @param offset Set to the offset to write at, or to the start of the section if the write doesn't fit.
+	 * @return Whether there was space for the write.
+	 */
+	bool reservePerFrameUniforms(size_t writeSize, size_t currentFrame, uint32_t& offset);
+
+	/**
+	 * Replaces the screen object buffer with a bigger one. All data in the old buffer is lost.
+	 * @param requiredSize The minimum size needed for each frame.
+	 */
+	void growScreenObjectBuffer(size_t requiredSize);
+
+	/**
+	 * Replaces the indirect buffer with a bigger one. All data in the old buffer is lost.
+	 * @param requiredSize The minimum size needed for each frame.
+	 */
+	void growIndirectBuffer(size_t requiredSize);
 };
@@ -17,171 +17,443 @@
  ******************************************************************************/
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/type_ptr.hpp>
 
 #include "RenderingEngine.hpp"
 #include "Engine.hpp"
-#include "ExtraMath.hpp"
 
-void RenderingEngine::render(const Screen* screen) {
-	std::shared_ptr<const RenderManager> renderManager = screen->getRenderData();
+void RenderingEngine::render(Screen* screen, float partialTicks) {
+	std::shared_ptr<RenderManager> renderManager = screen->getRenderData();
 
 	//Don't render without render component
 	if (!renderManager) {
 		return;
 	}
 
-	//View culling to check if objects are within the camera's view
-
 	const std::vector<const RenderComponent*>& componentVec = renderManager->getComponentSet();
 
-	const float width = getWindowInterface().getWindowWidth();
-	const float height = getWindowInterface().getWindowHeight();
-
 	std::shared_ptr<const Camera> camera = screen->getCamera();
 
-	glm::mat4 projection = camera->getProjection();
-	glm::mat4 view = camera->getView();
-	float nearDist = camera->getNearFar().first;
-	float farDist = camera->getNearFar().second;
-
-	const std::array<std::pair<glm::vec2, glm::vec2>, 4> cameraBox = {
-		//Top left
-		ExMath::screenToWorld(glm::vec2(0.0, 0.0), projection, glm::mat4(1.0f), width, height, nearDist, farDist),
-		//Top right
-		ExMath::screenToWorld(glm::vec2(width, 0.0), projection, glm::mat4(1.0f), width, height, nearDist, farDist),
-		//Bottom left
-		ExMath::screenToWorld(glm::vec2(0.0, height), projection, glm::mat4(1.0f), width, height, nearDist, farDist),
-		//Bottom right
-		ExMath::screenToWorld(glm::vec2(width, height), projection, glm::mat4(1.0f), width, height, nearDist, farDist)
-	};
+	//The camera moves in tick sized steps too, so it needs to be interpolated along with everything it's following.
+	camera->interpolateView(partialTicks);
+
+	const glm::mat4 view = camera->getRenderView();
+	const glm::mat4 projection = camera->getProjection();
+	//Perspective projections divide by depth, orthographic ones don't
+	const bool perspective = projection[2][3] != 0.0f;
+	const float nearDist = camera->getNearFar().first;
+	const float farDist = camera->getNearFar().second;
+
+	updateBatchKeys(renderManager.get());
+
+	const std::vector<uint32_t>& componentBatches = renderManager->getComponentBatches();
+	std::vector<uint32_t>& componentLods = renderManager->getComponentLods();
+	const float depthScale = 1.0f / (farDist - nearDist);
+
+	const std::vector<uint32_t>& dynamicComponents = renderManager->getDynamicComponents();
+	const std::vector<uint32_t>& staticComponents = renderManager->getStaticComponents();
+
+	//Pack the bounding spheres of dynamic objects for view culling. Objects that aren't view
+	//culled always pass, and hidden objects never do. Static objects are in the render
+	//manager's hierarchy instead, but still need to be interpolated in case they moved.
+
+	culler.setFrustum(glm::value_ptr(projection * view));
+	culler.resize(dynamicComponents.size());
+
+	Engine::instance->parallelFor(0, componentVec.size(), [&](size_t i) {
+		if (i >= dynamicComponents.size()) {
+			componentVec.at(staticComponents.at(i - dynamicComponents.size()))->interpolateTransform(partialTicks);
+			return;
+		}
+
+		const RenderComponent* comp = componentVec.at(dynamicComponents.at(i));
+
+		comp->interpolateTransform(partialTicks);
+
+		const glm::vec3 pos = comp->getTranslation();
+		float radius = std::numeric_limits<float>::infinity();
+
+		if (comp->isHidden()) {
+			radius = -radius;
+		}
+		else if (comp->getModel().material->viewCull) {
+			const glm::vec3 scale = comp->getScale();
+			radius = comp->getModel().mesh->getRadius() * std::max({scale.x, scale.y, scale.z});
+		}
+
+		culler.setSphere(i, pos.x, pos.y, pos.z, radius);
+	});
 
-	Engine::instance->parallelFor(0, componentVec.size(), [&](size_t index) {
+	//Creates the draw item for a visible object, sorted into its pass
+	auto addDrawItem = [&](size_t index, std::array<std::vector<DrawItem>, DrawList::PASS_COUNT>& passItems) {
 		const RenderComponent* comp = componentVec.at(index);
-		bool isCulled = comp->getModel().material->viewCull;
+		const uint32_t batch = componentBatches.at(index);
+
+		//Depth is quantized on a square root curve, to keep more precision close to the camera
+		const float viewDepth = -(view * glm::vec4(comp->getTranslation(), 1.0f)).z;
+		const uint64_t depth = std::sqrt(glm::clamp((viewDepth - nearDist) * depthScale, 0.0f, 1.0f)) * DrawList::DEPTH_MAX;
+		uint64_t sub = DrawList::getFineDepth(depth);
+
+		//Pick the level of detail from the size of the object's bounding sphere on screen
+		const Mesh* mesh = comp->getModel().mesh;
+		const std::vector<MeshLod>* lods = comp->getModel().lods;
+
+		if (lods != nullptr && !lods->empty()) {
+			const glm::vec3 scale = comp->getScale();
+			const float radius = mesh->getRadius() * std::max({scale.x, scale.y, scale.z});
+			float screenSize = radius * projection[1][1];
+
+			if (perspective) {
+				screenSize /= std::max(viewDepth, nearDist);
+			}
+
+			//Each component is only culled once, so only one thread writes to its level
+			uint32_t& level = componentLods.at(index);
+			level = selectLod(*lods, level, screenSize);
+
+			if (level > 0) {
+				mesh = &lods->at(level - 1).mesh;
+			}
+		}
+
+		if (batchInstanced.at(batch)) {
+			//Instanced objects need the same meshes next to each other more than they need
+			//fine depth ordering, so use a hash of the mesh instead. Collisions only split groups.
+			const uintptr_t meshHash = (uintptr_t) mesh;
+			sub = ((meshHash >> 4) ^ (meshHash >> 12)) & DrawList::SUB_MAX;
+		}
+
+		const uint64_t key = DrawList::addDepth(batchKeys.at(batch), depth, sub);
+		passItems.at((size_t) DrawList::getPass(key)).push_back({key, comp, mesh});
+	};
+
+	//Cull dynamic objects in blocks, keeping track of visible occluders
+
+	auto addCandidate = [&](uint32_t index) {
+		threadCandidates.local().push_back(index);
+
+		if (componentVec.at(index)->getModel().material->occluder) {
+			threadOccluders.local().push_back(index);
+		}
+	};
+
+	const size_t blockCount = (dynamicComponents.size() + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+
+	Engine::instance->parallelFor(0, blockCount, [&](size_t block) {
+		std::vector<uint32_t>& visible = threadVisible.local();
+
+		visible.clear();
+		culler.cull(block * CULL_BLOCK_SIZE, std::min(dynamicComponents.size(), (block + 1) * CULL_BLOCK_SIZE), visible);
+
+		for (uint32_t slot : visible) {
+			addCandidate(dynamicComponents.at(slot));
+		}
+	});
+
+	//Cull static objects with the hierarchy, hidden ones have to be skipped separately
+
+	staticVisible.clear();
+	renderManager->getStaticHierarchy().cull(culler, staticVisible);
+
+	const size_t staticBlockCount = (staticVisible.size() + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+
+	Engine::instance->parallelFor(0, staticBlockCount, [&](size_t block) {
+		const size_t blockEnd = std::min(staticVisible.size(), (block + 1) * CULL_BLOCK_SIZE);
+
+		for (size_t i = block * CULL_BLOCK_SIZE; i < blockEnd; i++) {
+			const uint32_t index = staticComponents.at(staticVisible.at(i));
+
+			if (!componentVec.at(index)->isHidden()) {
+				addCandidate(index);
+			}
+		}
+	});
+
+	candidates.clear();
+	occluders.clear();
+
+	for (std::vector<uint32_t>& threadList : threadCandidates) {
+		candidates.insert(candidates.end(), threadList.begin(), threadList.end());
+		threadList.clear();
+	}
+
+	for (std::vector<uint32_t>& threadList : threadOccluders) {
+		occluders.insert(occluders.end(), threadList.begin(), threadList.end());
+		threadList.clear();
+	}
+
+	//Rasterize the visible occluders, if there are any. Meshes without positions can't be drawn, so they're skipped.
+
+	const bool occlusionCull = !occluders.empty();
+
+	if (occlusionCull) {
+		occlusionCuller.begin(glm::value_ptr(projection * view));
+	}
+
+	Engine::instance->parallelFor(0, occluders.size(), [&](size_t i) {
+		const RenderComponent* comp = componentVec.at(occluders.at(i));
+		const Mesh* mesh = comp->getModel().mesh;
+		const VertexFormat* format = mesh->getFormat();
+
+		if (!format->hasElement(VERTEX_ELEMENT_POSITION)) {
+			return;
+		}
+
+		const auto meshData = mesh->getMeshData();
+		const std::vector<uint32_t>& indices = std::get<2>(meshData);
+		const glm::mat4 transform = comp->getTransform();
+
+		occlusionCuller.addOccluder(glm::value_ptr(transform), std::get<0>(meshData) + format->getElementOffset(VERTEX_ELEMENT_POSITION), format->getVertexSize(), indices.data(), indices.size());
+	});
+
+	if (occlusionCull) {
+		occlusionCuller.rasterize();
+	}
+
+	//Test everything else against the occluders, and build draw items for what's left
+
+	const size_t candidateBlockCount = (candidates.size() + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+
+	Engine::instance->parallelFor(0, candidateBlockCount, [&](size_t block) {
+		std::array<std::vector<DrawItem>, DrawList::PASS_COUNT>& passItems = threadItems.local();
+		const size_t blockEnd = std::min(candidates.size(), (block + 1) * CULL_BLOCK_SIZE);
+
+		for (size_t i = block * CULL_BLOCK_SIZE; i < blockEnd; i++) {
+			const uint32_t index = candidates.at(i);
+			const RenderComponent* comp = componentVec.at(index);
+			const Material* material = comp->getModel().material;
+
+			//Occluders would hide themselves, and objects that aren't view culled are always drawn.
+			if (occlusionCull && occlusionCuller.hasOccluders() && material->viewCull && !material->occluder) {
+				const glm::vec3 scale = comp->getScale();
+				const float radius = comp->getModel().mesh->getRadius() * std::max({scale.x, scale.y, scale.z});
+				const glm::vec3 min = comp->getTranslation() - radius;
+				const glm::vec3 max = comp->getTranslation() + radius;
 
-		comp->setVisible(!comp->isHidden() &&  (!isCulled || checkVisible(cameraBox, view, componentVec.at(index), nearDist, farDist)));
+				if (!occlusionCuller.isVisible(glm::value_ptr(min), glm::value_ptr(max))) {
+					continue;
+				}
+			}
+
+			addDrawItem(index, passItems);
+		}
 	});
 
+	drawList.clear();
+
+	for (std::array<std::vector<DrawItem>, DrawList::PASS_COUNT>& passItems : threadItems) {
+		for (size_t pass = 0; pass < DrawList::PASS_COUNT; pass++) {
+			drawList.add((RenderPass) pass, passItems.at(pass));
+			passItems.at(pass).clear();
+		}
+	}
+
+	drawList.sort();
+
+	//The per-frame buffers can't be replaced once commands using them are recorded, so make room first.
+	reserveFrameSpace(drawList);
+
 	//Render all visible objects
 
-	renderObjects(renderManager->getComponentList(), screen);
+	renderObjects(drawList, screen);
 }
 
-void RenderingEngine::setPerScreenUniforms(const UniformSet& set, Std140Aligner& aligner, const ScreenState* state, const Camera* camera, const glm::mat4& projCorrect) {
-	for (const UniformDescription& uniform : set.getBufferedUniforms()) {
-		glm::mat4 tempMat;
-		const void* value = nullptr;
+void RenderingEngine::updateBatchKeys(const RenderManager* renderManager) {
+	const std::vector<RenderBatch>& batches = renderManager->getBatches();
 
-		switch (uniform.provider) {
-			case UniformProviderType::CAMERA_PROJECTION: tempMat = camera->getProjection(); value = &tempMat; tempMat = projCorrect * tempMat; break;
-			case UniformProviderType::CAMERA_VIEW: tempMat = camera->getView(); value = &tempMat; break;
-			case UniformProviderType::SCREEN_STATE: value = state->getRenderValue(uniform.name); break;
-			default: throw std::runtime_error("Invalid provider type for screen uniform set!");
+	if (batches.size() > DrawList::BATCH_MAX + 1) {
+		throw std::runtime_error("Too many render batches for draw keys!");
+	}
+
+	batchKeys.resize(batches.size());
+	batchInstanced.resize(batches.size());
+
+	for (size_t i = 0; i < batches.size(); i++) {
+		const RenderBatch& batch = batches.at(i);
+
+		//Unused batch, nothing will reference it
+		if (batch.users == 0) {
+			continue;
+		}
+
+		const std::string& shader = batch.material->shader;
+
+		if (!shaderIds.count(shader)) {
+			if (shaderIds.size() > DrawList::SHADER_MAX) {
+				throw std::runtime_error("Too many shaders for draw keys!");
+			}
+
+			shaderIds.emplace(shader, shaderIds.size());
 		}
 
-		if (uniform.count) {
-			setUniformArrayValue(uniform.type, uniform.name, uniform.count, value, aligner);
+		if (!bufferIds.count(batch.buffer)) {
+			if (bufferIds.size() > DrawList::BUFFER_MAX) {
+				throw std::runtime_error("Too many vertex buffers for draw keys!");
+			}
+
+			bufferIds.emplace(batch.buffer, bufferIds.size());
 		}
-		else {
-			setUniformValue(uniform.type, uniform.name, value, aligner);
+
+		batchKeys.at(i) = DrawList::makeKey(getShaderPass(shader), shaderIds.at(shader), bufferIds.at(batch.buffer), i);
+		batchInstanced.at(i) = getShaderMaxInstances(shader) > 0;
+	}
+}
+
+void RenderingEngine::reserveFrameSpace(const DrawList& drawList) {
+	RendererMemoryManager* memoryManager = getMemoryManager();
+	size_t writeSize = 0;
+	size_t writeCount = 0;
+	size_t commandCount = 0;
+
+	for (size_t pass = 0; pass < DrawList::PASS_COUNT; pass++) {
+		const std::vector<DrawItem>& items = drawList.getItems((RenderPass) pass);
+		const UniformLayout* objectLayout = nullptr;
+		size_t maxInstances = 0;
+		size_t groupSize = 0;
+
+		for (size_t i = 0; i < items.size(); i++) {
+			const uint64_t key = items.at(i).key;
+			const bool newShader = i == 0 || DrawList::getShader(key) != DrawList::getShader(items.at(i - 1).key);
+
+			//Screen sets are written at most once each time the shader changes
+			if (newShader) {
+				const std::string& shader = items.at(i).object->getModel().material->shader;
+				const std::string& screenSet = getShaderScreenSet(shader);
+				const std::string& objectSet = getShaderObjectSet(shader);
+
+				if (!screenSet.empty()) {
+					writeSize += memoryManager->getUniformLayout(screenSet).getSize();
+					writeCount++;
+				}
+
+				objectLayout = objectSet.empty() ? nullptr : &memoryManager->getUniformLayout(objectSet);
+				maxInstances = getShaderMaxInstances(shader);
+			}
+
+			if (!objectLayout) {
+				continue;
+			}
+
+			if (!maxInstances) {
+				writeSize += objectLayout->getSize();
+				writeCount++;
+				continue;
+			}
+
+			//Groups are never larger than maxInstances and never span batches, and only span meshes
+			//for indirect draws, so this counts at least as many groups as are actually written.
+			//Indirect draws have a command for each mesh in the group, so that's an upper bound on those too.
+			const bool newGroup = newShader || groupSize == maxInstances || items.at(i).mesh != items.at(i - 1).mesh ||
+								  (key >> DrawList::BATCH_SHIFT) != (items.at(i - 1).key >> DrawList::BATCH_SHIFT);
+
+			if (newGroup) {
+				groupSize = 0;
+				writeCount++;
+
+				if ((RenderPass) pass == RenderPass::OPAQUE) {
+					commandCount++;
+				}
+			}
+
+			writeSize += objectLayout->getInstanceStride();
+			groupSize++;
 		}
 	}
+
+	memoryManager->reservePerFrameSpace(writeSize, writeCount, commandCount);
+}
+
+size_t RenderingEngine::getInstanceGroupEnd(const std::vector<DrawItem>& items, size_t begin, size_t maxInstances) {
+	const uint64_t batchKey = items.at(begin).key >> DrawList::BATCH_SHIFT;
+	const Mesh* mesh = items.at(begin).mesh;
+	const size_t maxEnd = std::min(items.size(), begin + maxInstances);
+
+	size_t end = begin + 1;
+
+	while (end < maxEnd && (items.at(end).key >> DrawList::BATCH_SHIFT) == batchKey && items.at(end).mesh == mesh) {
+		end++;
+	}
+
+	return end;
+}
+
+size_t RenderingEngine::buildIndirectCommands(const std::vector<DrawItem>& items, size_t begin, size_t maxInstances, std::vector<IndirectDrawCommand>& commands) {
+	const uint64_t batchKey = items.at(begin).key >> DrawList::BATCH_SHIFT;
+	const size_t maxEnd = std::min(items.size(), begin + maxInstances);
+
+	commands.clear();
+	size_t end = begin;
+
+	while (end < maxEnd && (items.at(end).key >> DrawList::BATCH_SHIFT) == batchKey) {
+		const size_t groupEnd = getInstanceGroupEnd(items, end, maxEnd - end);
+		const std::tuple<uintptr_t, uint32_t, int32_t> meshInfo = items.at(end).mesh->getRenderInfo();
+
+		commands.push_back({
+			std::get<1>(meshInfo),
+			(uint32_t) (groupEnd - end),
+			(uint32_t) std::get<0>(meshInfo),
+			std::get<2>(meshInfo),
+			(uint32_t) (end - begin)
+		});
+
+		end = groupEnd;
+	}
+
+	return end;
+}
+
+size_t RenderingEngine::selectLod(const std::vector<MeshLod>& lods, size_t current, float screenSize) {
+	size_t level = std::min(current, lods.size());
+
+	//Coarser while the object is well below the next level's threshold
+	while (level < lods.size() && screenSize < lods.at(level).screenSize * (1.0f - LOD_HYSTERESIS)) {
+		level++;
+	}
+
+	//Finer while it's well above the current level's threshold
+	while (level > 0 && screenSize > lods.at(level - 1).screenSize * (1.0f + LOD_HYSTERESIS)) {
+		level--;
+	}
+
+	return level;
+}
+
+void RenderingEngine::packInstanceUniforms(const UniformLayout& layout, unsigned char* block, const std::vector<DrawItem>& items, size_t begin, size_t end, const Camera* camera) {
+	for (size_t i = begin; i < end; i++) {
+		packObjectUniforms(layout, block + layout.getInstanceStride() * (i - begin), items.at(i).object, camera);
+	}
 }
 
-void RenderingEngine::setPerObjectUniforms(const UniformSet& set, Std140Aligner& aligner, const RenderComponent* comp, const Camera* camera) {
-	for (const UniformDescription& uniform : set.getBufferedUniforms()) {
+void RenderingEngine::packScreenUniforms(const UniformLayout& layout, unsigned char* block, const ScreenState* state, const Camera* camera, const glm::mat4& projCorrect) {
+	for (const UniformRecord& uniform : layout.getRecords()) {
 		glm::mat4 tempMat;
-		const void* value = nullptr;
+		const void* value = &tempMat;
 
+		//Providers were validated when the layout was compiled
 		switch (uniform.provider) {
-			case UniformProviderType::OBJECT_MODEL_VIEW: tempMat = camera->getView() * comp->getTransform(); value = &tempMat; break;
-			case UniformProviderType::OBJECT_TRANSFORM: tempMat = comp->getTransform(); value = &tempMat; break;
-			case UniformProviderType::OBJECT_STATE: value = comp->getParentState()->getRenderValue(uniform.name); break;
-			default: throw std::runtime_error("Invalid provider type for object uniform set!");
+			case UniformProviderType::CAMERA_PROJECTION: tempMat = projCorrect * camera->getProjection(); break;
+			case UniformProviderType::CAMERA_VIEW: tempMat = camera->getRenderView(); break;
+			default: value = state->getRenderValue(uniform.name); break;
 		}
 
-		if (uniform.count) {
-			setUniformArrayValue(uniform.type, uniform.name, uniform.count, value, aligner);
-		}
-		else {
-			setUniformValue(uniform.type, uniform.name, value, aligner);
-		}
+		UniformLayout::writeValue(uniform, value, block);
 	}
 }
 
-bool RenderingEngine::checkVisible(const std::array<std::pair<glm::vec2, glm::vec2>, 4>& cameraBox, const glm::mat4& viewMat, const RenderComponent* object, float nearDist, float farDist) {
-	const float near = -nearDist;
-	const float far = -farDist;
-
-	const glm::vec3 objectPosCamera = viewMat * glm::vec4(object->getTranslation(), 1.0f);
-	const float objectRadius = object->getModel().mesh->getRadius() * std::max({object->getScale().x, object->getScale().y, object->getScale().z});
-
-	//Object behind near plane or beyond far plane
-	if ((objectPosCamera.z - objectRadius) > near || (objectPosCamera.z + objectRadius) < far) {
-		return false;
-	}
-
-	//Object intersects near plane
-	if (((objectPosCamera.z + objectRadius) < near) != ((objectPosCamera.z - objectRadius) < near)) {
-		const float objectDist = near - objectPosCamera.z;
-		const float objectRadiusPlane = sqrt(objectRadius * objectRadius + objectDist * objectDist);
-
-		//Create bounding box from object sphere (top, bottom, right, left)
-		const glm::vec4 objectBoxSides(
-			objectPosCamera.y + objectRadiusPlane,
-			objectPosCamera.y - objectRadiusPlane,
-			objectPosCamera.x + objectRadiusPlane,
-			objectPosCamera.x - objectRadiusPlane
-		);
-
-		//Create bounding box from camera near plane
-		const glm::vec4 cameraBoxSides(
-			cameraBox.at(0).first.y,
-			cameraBox.at(2).first.y,
-			cameraBox.at(1).first.x,
-			cameraBox.at(0).first.x
-		);
-
-		return objectBoxSides.y < cameraBoxSides.x &&
-			   objectBoxSides.x > cameraBoxSides.y &&
-			   objectBoxSides.w < cameraBoxSides.z &&
-			   objectBoxSides.z > cameraBoxSides.w;
-	}
-
-	//Object intersects far plane
-	if (((objectPosCamera.z + objectRadius) < far) != ((objectPosCamera.z - objectRadius) < far)) {
-		const float objectDist = far - objectPosCamera.z;
-		const float objectRadiusPlane = sqrt(objectRadius * objectRadius + objectDist * objectDist);
-
-		//Create bounding box from object sphere (top, bottom, right, left)
-		const glm::vec4 objectBoxSides(
-			objectPosCamera.y + objectRadiusPlane,
-			objectPosCamera.y - objectRadiusPlane,
-			objectPosCamera.x + objectRadiusPlane,
-			objectPosCamera.x - objectRadiusPlane
-		);
-
-		//Create bounding box from camera far plane
-		const glm::vec4 cameraBoxSides(
-			cameraBox.at(0).second.y,
-			cameraBox.at(2).second.y,
-			cameraBox.at(1).second.x,
-			cameraBox.at(0).second.x
-		);
-
-		return objectBoxSides.y < cameraBoxSides.x &&
-			   objectBoxSides.x > cameraBoxSides.y &&
-			   objectBoxSides.w < cameraBoxSides.z &&
-			   objectBoxSides.z > cameraBoxSides.w;
-	}
-
-	const float percent = (near + objectPosCamera.z) / far;
-
-	//Width and height of the plane parallel to the near and far planes with same z coordinate as the object
-	const glm::vec2 cameraPlaneSize = {
-		std::abs(ExMath::interpolate<glm::vec2>(cameraBox.at(1).first, cameraBox.at(1).second, percent).x),
-		std::abs(ExMath::interpolate<glm::vec2>(cameraBox.at(1).first, cameraBox.at(1).second, percent).y)
-	};
+void RenderingEngine::packObjectUniforms(const UniformLayout& layout, unsigned char* block, const RenderComponent* comp, const Camera* camera) {
+	for (const UniformRecord& uniform : layout.getRecords()) {
+		glm::mat4 tempMat;
+		const void* value = &tempMat;
 
-	return (std::abs(objectPosCamera.x) - objectRadius) <= cameraPlaneSize.x && (std::abs(objectPosCamera.y) - objectRadius) <= cameraPlaneSize.y;
+		switch (uniform.provider) {
+			case UniformProviderType::OBJECT_MODEL_VIEW: tempMat = camera->getRenderView() * comp->getTransform(); break;
+			case UniformProviderType::OBJECT_TRANSFORM: tempMat = comp->getTransform(); break;
+			default: value = comp->getParentState()->getRenderValue(uniform.name); break;
+		}
+
+		UniformLayout::writeValue(uniform, value, block);
+	}
 }
@@ -21,8 +21,10 @@
 #include <memory>
 #include <string>
 #include <array>
+#include <unordered_map>
 
 #include <glm/glm.hpp>
+#include <tbb/enumerable_thread_specific.h>
 
 #include "TextureLoader.hpp"
 #include "ShaderLoader.hpp"
@@ -32,6 +34,9 @@
 #include "WindowSystemInterface.hpp"
 #include "Display/Camera.hpp"
 #include "RenderInitializer.hpp"
+#include "DrawList.hpp"
+#include "FrustumCuller.hpp"
+#include "OcclusionCuller.hpp"
 
 //A generic rendering engine. Provides the base interfaces, like resource loading
 //and rendering, but leaves the implementation to api-specific subclasses, like
@@ -121,16 +126,19 @@ public:
 
 	/**
 	 * Renders the passed in object. This function performs view culling if needed and
-	 * passed all visible renderComponents to the underlying graphics rendering api
+	 * passes all visible renderComponents to the underlying graphics rendering api
 	 * @param screen The screen to render.
+	 * @param partialTicks The fraction of a tick since the last update, used to
+	 *     interpolate object positions.
 	 */
-	void render(const Screen* screen);
+	void render(Screen* screen, float partialTicks);
 
 	/**
 	 * Called when drawing is done and the results can be displayed on the screen.
 	 * Also sets up the pipeline for the next frame.
 	 */
 	void present() {
+		getMemoryManager()->flushPerFrameData(currentFrame);
 		apiPresent();
 		getMemoryManager()->resetPerFrameOffset();
 		currentFrame = (currentFrame + 1) % MAX_ACTIVE_FRAMES;
@@ -167,83 +175,149 @@ protected:
 	virtual void apiPresent() = 0;
 
 	/**
-	 * Renders the visible objects, using the sorted map.
+	 * Renders the visible objects, in the order of the draw list.
 	 * The depth and stencil buffers should be cleared before or after this function
 	 * so different screens don't effect each other's rendering.
-	 * @param sortedObjects All objects, sorted by buffer, then shader, then model.
+	 * @param drawList All visible objects, split by pass and sorted by shader, then buffer, then material.
 	 * @param screen The screen being rendered.
 	 */
-	virtual void renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) = 0;
+	virtual void renderObjects(const DrawList& drawList, const Screen* screen) = 0;
 
 	/**
-	 * Sets the per-screen uniforms for set in the provided aligner using the values obtained from state and camera.
-	 * @param set The uniform set containing values to set.
-	 * @param aligner The object the values are set in.
+	 * Gets the render pass the given shader draws in.
+	 * @param shader The name of the shader.
+	 * @return The shader's render pass.
+	 */
+	virtual RenderPass getShaderPass(const std::string& shader) const = 0;
+
+	/**
+	 * Gets the maximum number of objects the given shader can draw in one instanced draw.
+	 * @param shader The name of the shader.
+	 * @return The max instances of the shader's object set, or 0 if it isn't instanced.
+	 */
+	virtual size_t getShaderMaxInstances(const std::string& shader) const = 0;
+
+	/**
+	 * Gets the per-screen uniform set of the given shader.
+	 * @param shader The name of the shader.
+	 * @return The name of the set, or an empty string if the shader doesn't have one.
+	 */
+	virtual const std::string& getShaderScreenSet(const std::string& shader) const = 0;
+
+	/**
+	 * Gets the per-object uniform set of the given shader.
+	 * @param shader The name of the shader.
+	 * @return The name of the set, or an empty string if the shader doesn't have one.
+	 */
+	virtual const std::string& getShaderObjectSet(const std::string& shader) const = 0;
+
+	/**
+	 * Finds the end of a group of objects that can be drawn with one instanced draw, which
+	 * is a run of items with the same mesh and material.
+	 * @param items The sorted draw list items.
+	 * @param begin The first item in the group.
+	 * @param maxInstances The maximum size of the group.
+	 * @return One past the last item in the group.
+	 */
+	static size_t getInstanceGroupEnd(const std::vector<DrawItem>& items, size_t begin, size_t maxInstances);
+
+	/**
+	 * Creates indirect draw commands for a run of objects with the same material, with one
+	 * command for each mesh. The objects use consecutive instances, starting at 0, so their
+	 * uniforms can be written with setInstanceUniforms.
+	 * @param items The sorted draw list items.
+	 * @param begin The first item to draw.
+	 * @param maxInstances The maximum number of objects to draw.
+	 * @param commands Cleared and filled with the created commands.
+	 * @return One past the last item drawn by the commands.
+	 */
+	static size_t buildIndirectCommands(const std::vector<DrawItem>& items, size_t begin, size_t maxInstances, std::vector<IndirectDrawCommand>& commands);
+
+	/**
+	 * Packs the per-object uniforms for a group of instanced objects into a single array.
+	 * @param layout The layout of the instanced object set.
+	 * @param block Where to write the array, must have space for (end - begin) instances.
+	 * @param items The sorted draw list items.
+	 * @param begin The first item in the group.
+	 * @param end One past the last item in the group.
+	 * @param camera The current camera.
+	 */
+	static void packInstanceUniforms(const UniformLayout& layout, unsigned char* block, const std::vector<DrawItem>& items, size_t begin, size_t end, const Camera* camera);
+
+	/**
+	 * Packs the per-screen uniforms for a set using the values obtained from state and camera.
+	 * @param layout The layout of the set.
+	 * @param block Where to write the values.
 	 * @param state The screen state object to obtain SCREEN_STATE values from.
 	 * @param camera The camera object to obtain CAMERA_* values from.
 	 * @param projCorrect A transform to apply to the projection matrix to ensure correct rendering, mainly used by the
 	 *     Vulkan renderer. Defaults to the identity.
 	 */
-	void setPerScreenUniforms(const UniformSet& set, Std140Aligner& aligner, const ScreenState* state, const Camera* camera, const glm::mat4& projCorrect = glm::mat4(1.0));
+	static void packScreenUniforms(const UniformLayout& layout, unsigned char* block, const ScreenState* state, const Camera* camera, const glm::mat4& projCorrect = glm::mat4(1.0));
 
 	/**
-	 * Sets the per-object uniforms for the given object.
-	 * @param set The set for the given object.
-	 * @param aligner The aligner to write the uniforms to.
+	 * Packs the per-object uniforms for the given object.
+	 * @param layout The layout of the object's set.
+	 * @param block Where to write the values.
 	 * @param comp The render component for the object.
 	 * @param camera The current camera.
 	 */
-	void setPerObjectUniforms(const UniformSet& set, Std140Aligner& aligner, const RenderComponent* comp, const Camera* camera);
-
-	/**
-	 * Sets the value in aligner to the provided value.
-	 * @param type The type of the uniform to set.
-	 * @param uniformName The name of the uniform to set.
-	 * @param value The value to set the uniform to.
-	 * @param aligner The aligner to set the value in.
-	 */
-	static constexpr void setUniformValue(const UniformType type, const std::string& uniformName, const void* value, Std140Aligner& aligner) {
-		switch (type) {
-			case UniformType::FLOAT: aligner.setFloat(uniformName, *(const float*)value); break;
-			case UniformType::VEC2: aligner.setVec2(uniformName, *(const glm::vec2*)value); break;
-			case UniformType::VEC3: aligner.setVec3(uniformName, *(const glm::vec3*)value); break;
-			case UniformType::VEC4: aligner.setVec4(uniformName, *(const glm::vec4*)value); break;
-			case UniformType::MAT3: aligner.setMat3(uniformName, *(const glm::mat3*)value); break;
-			case UniformType::MAT4: aligner.setMat4(uniformName, *(const glm::mat4*)value); break;
-			default: throw std::runtime_error("Invalid buffered uniform type for uniform \"" + uniformName + "\"!");
-		}
-	}
+	static void packObjectUniforms(const UniformLayout& layout, unsigned char* block, const RenderComponent* comp, const Camera* camera);
+
+private:
+	//Number of objects culled at once by each task.
+	constexpr static size_t CULL_BLOCK_SIZE = 1024;
+	//How far, as a fraction of the threshold, an object's screen size has to go past
+	//a level of detail's threshold before the level changes. Stops flickering between
+	//levels when objects sit near a threshold.
+	constexpr static float LOD_HYSTERESIS = 0.1f;
+
+	//The objects being drawn for the current screen.
+	DrawList drawList;
+	//Bounding spheres of all the screen's objects, for view culling.
+	FrustumCuller culler;
+	//Indices of visible objects in the current block, for each thread.
+	tbb::enumerable_thread_specific<std::vector<uint32_t>> threadVisible;
+	//Visible static objects, as ids in the render manager's hierarchy.
+	std::vector<uint32_t> staticVisible;
+	//Objects that passed view culling, and the occluders among them, found by each thread.
+	tbb::enumerable_thread_specific<std::vector<uint32_t>> threadCandidates;
+	tbb::enumerable_thread_specific<std::vector<uint32_t>> threadOccluders;
+	//All objects that passed view culling, gathered from each thread.
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> occluders;
+	//Depth buffer of the visible occluders, for hiding objects behind them.
+	OcclusionCuller occlusionCuller;
+	//Visible objects found by each thread during culling, split by render pass.
+	tbb::enumerable_thread_specific<std::array<std::vector<DrawItem>, DrawList::PASS_COUNT>> threadItems;
+	//Ids used in draw keys for shaders and buffers, assigned as they're first seen.
+	std::unordered_map<std::string, uint32_t> shaderIds;
+	std::unordered_map<const Buffer*, uint32_t> bufferIds;
+	//The key for each of the render manager's batches, without depth.
+	std::vector<uint64_t> batchKeys;
+	//Whether each batch uses an instanced shader.
+	std::vector<bool> batchInstanced;
 
 	/**
-	 * Same as setUniformValue, but for arrays.
-	 * @param type The type of the uniform to set.
-	 * @param uniformName The name of the uniform to set.
-	 * @param count The number of array values to set.
-	 * @param value The value to set the uniform to.
-	 * @param aligner The aligner to set the value in.
-	 */
-	static constexpr void setUniformArrayValue(const UniformType type, const std::string& uniformName, size_t count, const void* value, Std140Aligner& aligner) {
-		switch (type) {
-			case UniformType::FLOAT: aligner.setFloatArray(uniformName, 0, count, (const float*)value); break;
-			case UniformType::VEC2: aligner.setVec2Array(uniformName, 0, count, (const glm::vec2*)value); break;
-			case UniformType::VEC3: aligner.setVec3Array(uniformName, 0, count, (const glm::vec3*)value); break;
-			case UniformType::VEC4: aligner.setVec4Array(uniformName, 0, count, (const glm::vec4*)value); break;
-			case UniformType::MAT3: aligner.setMat3Array(uniformName, 0, count, (const glm::mat3*)value); break;
-			case UniformType::MAT4: aligner.setMat4Array(uniformName, 0, count, (const glm::mat4*)value); break;
-			default: throw std::runtime_error("Invalid buffered uniform type for uniform \"" + uniformName + "\"!");
-		}
-	}
+	 * Computes the draw key for each batch in the render manager.
+	 * @param renderManager The render manager being drawn.
+	 * @throw runtime_error if there are too many shaders, buffers, or batches to fit in a key.
+	 */
+	void updateBatchKeys(const RenderManager* renderManager);
+
+	/**
+	 * Makes room in the per-frame uniform and indirect buffers for everything drawing the draw list will write.
+	 * @param drawList The sorted draw list that's about to be rendered.
+	 */
+	void reserveFrameSpace(const DrawList& drawList);
 
-private:
 	/**
-	 * Checks whether the given object is visible from the camera.
-	 * @param cameraBox The box of the camera, in camera coordinates. Goes
-	 *     {top left, top right, bottom left, bottom right}.
-	 * @param viewMat The view matrix, used to transform object position into camera space.
-	 * @param object The object to check.
-	 * @param nearDist The distance for the near plane.
-	 * @param farDist The distance for the far plane.
-	 * @return Whether the object can be seen from the camera.
+	 * Picks the level of detail for an object, moving away from its current
+	 * level only if its size is past the new level's threshold by LOD_HYSTERESIS.
+	 * @param lods The levels of detail for the object's mesh.
+	 * @param current The object's current level, see RenderManager::getComponentLods.
+	 * @param screenSize The object's projected diameter, as a fraction of the screen's height.
+	 * @return The new level.
 	 */
-	bool checkVisible(const std::array<std::pair<glm::vec2, glm::vec2>, 4>& cameraBox, const glm::mat4& viewMat, const RenderComponent* object, float nearDist, float farDist);
+	static size_t selectLod(const std::vector<MeshLod>& lods, size_t current, float screenSize);
 };
@@ -39,6 +39,11 @@ size_t Std140Aligner::getAlignedSize(const UniformSet& set) {
 	return currentSize;
 }
 
+size_t Std140Aligner::getInstanceStride(const UniformSet& set) {
+	//Arrays of structures round each element up to the alignment of a vec4
+	return ExMath::roundToVal<size_t>(getAlignedSize(set), baseAlignment(UniformType::VEC4));
+}
+
 Std140Aligner::Std140Aligner(const UniformList& uniforms) :
 	uniformData(nullptr),
 	dataSize(0) {
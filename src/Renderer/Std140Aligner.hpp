@@ -51,6 +51,24 @@ public:
 	 */
 	static size_t getAlignedSize(const UniformSet& set);
 
+	/**
+	 * Gets the distance between instances of an instanced uniform set, which is the
+	 * aligned size rounded up to the alignment of a structure.
+	 * @param set The uniform set.
+	 * @return The instance stride.
+	 */
+	static size_t getInstanceStride(const UniformSet& set);
+
+	/**
+	 * Gets the size of the uniform block the shader sees for the set - the aligned size,
+	 * or the size of the whole instance array for instanced sets.
+	 * @param set The uniform set.
+	 * @return The size of the uniform block.
+	 */
+	static size_t getBlockSize(const UniformSet& set) {
+		return set.getMaxInstances() ? getInstanceStride(set) * set.getMaxInstances() : getAlignedSize(set);
+	}
+
 	/**
 	 * Constructs the aligned memory region.
 	 * @param uniforms The uniforms that will be stored. Samplers and
@@ -174,6 +192,49 @@ public:
 		return *this;
 	}
 
+	/**
+	 * Calculates the size of the data type once it has been properly aligned.
+	 * This is mainly useful for arrays and matrices, because the stride is a
+	 * bit odd.
+	 * @param type The type to get the size of.
+	 * @return The size of the type. Note that this does not necessarily determine
+	 *     the offset of the next element, due to alignment restrictions.
+	 */
+	static constexpr uint32_t alignedSize(const UniformType type) {
+		switch (type) {
+			case UniformType::FLOAT: return sizeof(float);
+			case UniformType::VEC2: return 2 * sizeof(float);
+			case UniformType::VEC3: return 3 * sizeof(float);
+			case UniformType::VEC4: return 4 * sizeof(float);
+			//Calculated by: roundToVal(alignedSize(UniformType::VEC3), alignedSize(UniformType::VEC4))
+			case UniformType::MAT3: return 3 * alignedSize(UniformType::VEC4);
+			case UniformType::MAT4: return 4 * alignedSize(UniformType::VEC4);
+			default: throw std::runtime_error("Invalid uniform type provided to alignedSize!");
+		}
+	}
+
+	/**
+	 * Calculates the base alignment of the provided type. When used with
+	 * alignedSize, this should help reduce the complexity of aligning
+	 * elements, especially in cases like floats following vec3s.
+	 * Still might not be a good idea to have vec3s in opengl shaders,
+	 * though, because apparently some drivers handle that wrong.
+	 * @param type The type to get the base alignment for.
+	 * @return The base alignment for the type.
+	 */
+	static constexpr uint32_t baseAlignment(const UniformType type) {
+		switch (type) {
+			case UniformType::FLOAT: return sizeof(float);
+			case UniformType::VEC2: return 2 * sizeof(float);
+			case UniformType::VEC3: return 4 * sizeof(float);
+			case UniformType::VEC4: return 4 * sizeof(float);
+			//Calculated by: roundToVal(baseAlignment(UniformType::VEC3), baseAlignment(UniformType::VEC4))
+			case UniformType::MAT3: return baseAlignment(UniformType::VEC4);
+			case UniformType::MAT4: return baseAlignment(UniformType::VEC4);
+			default: throw std::runtime_error("Invalid uniform type provided to baseAlignment!");
+		}
+	}
+
 private:
 	//Map of uniforms, for fast retrieval.
 	std::unordered_map<std::string, UniformData> uniformMap;
@@ -242,47 +303,4 @@ private:
 		const UniformData& data = uniformMap.at(name);
 		return *(T*)(&uniformData[data.offset]);
 	}
-
-	/**
-	 * Calculates the size of the data type once it has been properly aligned.
-	 * This is mainly useful for arrays and matrices, because the stride is a
-	 * bit odd.
-	 * @param type The type to get the size of.
-	 * @return The size of the type. Note that this does not necessarily determine
-	 *     the offset of the next element, due to alignment restrictions.
-	 */
-	static constexpr uint32_t alignedSize(const UniformType type) {
-		switch (type) {
-			case UniformType::FLOAT: return sizeof(float);
-			case UniformType::VEC2: return 2 * sizeof(float);
-			case UniformType::VEC3: return 3 * sizeof(float);
-			case UniformType::VEC4: return 4 * sizeof(float);
-			//Calculated by: roundToVal(alignedSize(UniformType::VEC3), alignedSize(UniformType::VEC4))
-			case UniformType::MAT3: return 3 * alignedSize(UniformType::VEC4);
-			case UniformType::MAT4: return 4 * alignedSize(UniformType::VEC4);
-			default: throw std::runtime_error("Invalid uniform type provided to alignedSize!");
-		}
-	}
-
-	/**
-	 * Calculates the base alignment of the provided type. When used with
-	 * alignedSize, this should help reduce the complexity of aligning
-	 * elements, especially in cases like floats following vec3s.
-	 * Still might not be a good idea to have vec3s in opengl shaders,
-	 * though, because apparently some drivers handle that wrong.
-	 * @param type The type to get the base alignment for.
-	 * @return The base alignment for the type.
-	 */
-	static constexpr uint32_t baseAlignment(const UniformType type) {
-		switch (type) {
-			case UniformType::FLOAT: return sizeof(float);
-			case UniformType::VEC2: return 2 * sizeof(float);
-			case UniformType::VEC3: return 4 * sizeof(float);
-			case UniformType::VEC4: return 4 * sizeof(float);
-			//Calculated by: roundToVal(baseAlignment(UniformType::VEC3), baseAlignment(UniformType::VEC4))
-			case UniformType::MAT3: return baseAlignment(UniformType::VEC4);
-			case UniformType::MAT4: return baseAlignment(UniformType::VEC4);
-			default: throw std::runtime_error("Invalid uniform type provided to baseAlignment!");
-		}
-	}
 };
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "UniformLayout.hpp"
+#include "Std140Aligner.hpp"
+#include "ExtraMath.hpp"
+
+namespace {
+	/**
+	 * Checks whether a uniform provider can be used in a uniform set of the given type.
+	 * @param setType The type of the uniform set.
+	 * @param provider The provider of one of the set's uniforms.
+	 * @return Whether the provider is allowed.
+	 */
+	bool providerAllowed(const UniformSetType setType, const UniformProviderType provider) {
+		switch (provider) {
+			case UniformProviderType::CAMERA_PROJECTION:
+			case UniformProviderType::CAMERA_VIEW:
+			case UniformProviderType::SCREEN_STATE:
+				return setType == UniformSetType::PER_SCREEN;
+			case UniformProviderType::OBJECT_MODEL_VIEW:
+			case UniformProviderType::OBJECT_TRANSFORM:
+			case UniformProviderType::OBJECT_STATE:
+				return setType == UniformSetType::PER_OBJECT;
+			default: return false;
+		}
+	}
+}
+
+UniformLayout::UniformLayout(const UniformSet& set) :
+	size(0),
+	instanceStride(0) {
+
+	uint32_t currentOffset = 0;
+
+	for (const UniformDescription& uniform : set.getBufferedUniforms()) {
+		if (!providerAllowed(set.getType(), uniform.provider)) {
+			throw std::runtime_error("Invalid provider type for uniform \"" + uniform.name + "\"!");
+		}
+
+		//Same rules as Std140Aligner
+		uint32_t offset = ExMath::roundToVal(currentOffset, Std140Aligner::baseAlignment(uniform.type));
+		uint32_t alignedSize = Std140Aligner::alignedSize(uniform.type);
+
+		if (uniform.count) {
+			offset = ExMath::roundToVal(offset, Std140Aligner::baseAlignment(UniformType::VEC4));
+			alignedSize = ExMath::roundToVal(alignedSize, Std140Aligner::baseAlignment(UniformType::VEC4)) * uniform.count;
+		}
+
+		records.push_back({uniform.provider, uniform.type, offset, (uint32_t) uniform.count, uniform.name});
+		currentOffset = offset + alignedSize;
+	}
+
+	size = currentOffset;
+	instanceStride = ExMath::roundToVal(size, Std140Aligner::baseAlignment(UniformType::VEC4));
+}
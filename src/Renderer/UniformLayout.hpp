@@ -0,0 +1,119 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#include "UniformSet.hpp"
+
+//A single uniform in a compiled layout.
+struct UniformRecord {
+	//Where the uniform's value comes from.
+	UniformProviderType provider;
+	//Type of the uniform.
+	UniformType type;
+	//Offset of the uniform from the start of the block, in bytes.
+	uint32_t offset;
+	//Number of array elements, or 0 if the uniform isn't an array.
+	uint32_t count;
+	//Name of the uniform, only used to look up state values.
+	std::string name;
+};
+
+//The buffered uniforms of a per-screen or per-object uniform set, compiled into a list of records
+//with precomputed std140 offsets. Values are copied straight to their offsets in the destination,
+//so filling a block doesn't need any lookups by name. Providers are validated when the layout is
+//created, so nothing can fail while writing values.
+class UniformLayout {
+public:
+	/**
+	 * Compiles the layout for the given set.
+	 * @param set The uniform set to compile. Must be PER_SCREEN or PER_OBJECT.
+	 * @throw std::runtime_error if a uniform has a provider that isn't allowed for the set's type.
+	 */
+	UniformLayout(const UniformSet& set);
+
+	/**
+	 * Gets the records for all buffered uniforms, in the order they appear in the set.
+	 * @return The uniform records.
+	 */
+	const std::vector<UniformRecord>& getRecords() const { return records; }
+
+	/**
+	 * Gets the size of one copy of the set's uniforms.
+	 * @return The aligned size, in bytes.
+	 */
+	uint32_t getSize() const { return size; }
+
+	/**
+	 * Gets the distance between instances of the set in an instance array.
+	 * @return The instance stride, in bytes.
+	 */
+	uint32_t getInstanceStride() const { return instanceStride; }
+
+	/**
+	 * Copies a value into a block laid out with this layout, adding the padding std140 requires
+	 * for matrix columns and array elements.
+	 * @param record The record for the uniform being written.
+	 * @param value The value to write. Arrays must have all record.count elements.
+	 * @param block The start of the block to write to.
+	 */
+	static void writeValue(const UniformRecord& record, const void* value, unsigned char* block) {
+		unsigned char* dest = block + record.offset;
+		const unsigned char* src = (const unsigned char*) value;
+		const size_t elements = record.count ? record.count : 1;
+
+		switch (record.type) {
+			//Every column of a mat3 is padded to the size of a vec4
+			case UniformType::MAT3:
+				for (size_t i = 0; i < elements * 3; i++) {
+					std::memcpy(dest + i * COLUMN_STRIDE, src + i * uniformSize(UniformType::VEC3), uniformSize(UniformType::VEC3));
+				}
+				break;
+			case UniformType::MAT4: std::memcpy(dest, src, elements * uniformSize(UniformType::MAT4)); break;
+			default: {
+				const size_t valueSize = uniformSize(record.type);
+
+				if (record.count) {
+					//Array elements are padded to the size of a vec4
+					for (size_t i = 0; i < elements; i++) {
+						std::memcpy(dest + i * COLUMN_STRIDE, src + i * valueSize, valueSize);
+					}
+				}
+				else {
+					std::memcpy(dest, src, valueSize);
+				}
+			}
+		}
+	}
+
+private:
+	//Stride of matrix columns and array elements.
+	constexpr static size_t COLUMN_STRIDE = 4 * sizeof(float);
+
+	//All buffered uniforms in the set.
+	std::vector<UniformRecord> records;
+	//Aligned size of the set.
+	uint32_t size;
+	//Size rounded up to the alignment of a structure, for instance arrays.
+	uint32_t instanceStride;
+};
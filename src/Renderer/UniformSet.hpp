@@ -119,10 +119,23 @@ public:
 	 *     the screen stack for any given frame. PER_OBJECT needs one user for every object
 	 *     which uses the set for any given frame, across all screens.
 	 * @param uniforms A list of uniforms in the set.
+	 * @param maxInstances If nonzero, the set is laid out in the shader as an array of this
+	 *     many copies of its uniforms (std140 array of structs), and objects sharing a mesh and
+	 *     material are drawn with a single instanced draw, or a single indirect draw for opaque
+	 *     objects sharing only a material. The array is indexed with gl_InstanceIndex in Vulkan.
+	 *     OpenGL has no equivalent that includes the base instance, so the index is provided as
+	 *     an extra uint vertex input, at the location after the vertex format's inputs.
+	 *     Only allowed for PER_OBJECT sets.
+	 * @throw runtime_error if maxInstances is set for a set that isn't PER_OBJECT.
 	 */
-	UniformSet(UniformSetType type, size_t maxUsers, const UniformList& uniforms) :
+	UniformSet(UniformSetType type, size_t maxUsers, const UniformList& uniforms, size_t maxInstances = 0) :
 		type(type),
-		maxUsers(maxUsers) {
+		maxUsers(maxUsers),
+		maxInstances(maxInstances) {
+
+		if (maxInstances != 0 && type != UniformSetType::PER_OBJECT) {
+			throw std::runtime_error("Only per-object uniform sets can be instanced!");
+		}
 
 		for (UniformDescription uniform : uniforms) {
 			//Pretty much everything here is intended to fallthrough.
@@ -154,6 +167,12 @@ public:
 	 */
 	size_t getMaxUsers() const { return maxUsers; }
 
+	/**
+	 * Gets the maximum number of instances drawn at once with this set.
+	 * @return The max instances, or 0 if the set isn't instanced.
+	 */
+	size_t getMaxInstances() const { return maxInstances; }
+
 	/**
 	 * Gets all the buffered uniforms within the set.
 	 * @return The buffered uniforms.
@@ -171,6 +190,8 @@ private:
 	UniformSetType type;
 	//The maximum allowed users of the uniform set.
 	size_t maxUsers;
+	//Size of the instance array in the shader, 0 if not instanced.
+	size_t maxInstances;
 	//List of uniforms stored in an uniform buffer.
 	UniformList bufferedUniforms;
 	//List of uniforms not stored in an uniform buffer (like samplers).
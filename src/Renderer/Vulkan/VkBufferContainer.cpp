@@ -41,6 +41,7 @@ VkBufferContainer::VkBufferContainer(VkMemoryManager* memoryManager, VkObjectHan
 			memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY;
 			break;
 		case BufferStorage::DEVICE_HOST_VISIBLE:
+		case BufferStorage::STREAMING:
 			memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
 			break;
 		case BufferStorage::HOST:
@@ -59,6 +59,23 @@ public:
 	 */
 	void write(size_t offset, size_t size, const unsigned char* data) override;
 
+	/**
+	 * Flushes writes to mapped memory, if it isn't host coherent.
+	 * @param offset The start of the range to flush.
+	 * @param size The size of the range, in bytes.
+	 */
+	void flush(size_t offset, size_t size) override {
+		if (mappedMem) {
+			vmaFlushAllocation(allocator, allocation, offset, size);
+		}
+	}
+
+	/**
+	 * Gets the mapped memory of the buffer.
+	 * @return The mapped memory, or nullptr if the buffer isn't host visible.
+	 */
+	unsigned char* getMappedMemory() override { return mappedMem; }
+
 private:
 	//Logger, for logging.
 	Logger logger;
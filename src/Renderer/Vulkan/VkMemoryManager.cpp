@@ -579,6 +579,17 @@ VkDescriptorSetLayout VkMemoryManager::createSetLayout(const UniformSet& set) co
 	return layout;
 }
 
+void VkMemoryManager::uniformBufferReplaced(UniformBufferType type) {
+	for (const auto& uniformSetPair : getUniformSetMap()) {
+		const UniformSet& uniformSet = uniformSetPair.second;
+
+		//Material sets are filled with their textures, and never use the replaced buffers
+		if (uniformSet.getType() != UniformSetType::MATERIAL && uniformBufferFromSetType(uniformSet.getType()) == type) {
+			fillDescriptorSet(descriptorSets.at(uniformSetPair.first), uniformSet, std::vector<std::string>());
+		}
+	}
+}
+
 void VkMemoryManager::fillDescriptorSet(VkDescriptorSet set, const UniformSet& uniformSet, const std::vector<std::string>& textures) {
 	std::vector<VkWriteDescriptorSet> writeOps;
 	std::deque<VkDescriptorBufferInfo> bufferInfos;
@@ -589,7 +600,7 @@ void VkMemoryManager::fillDescriptorSet(VkDescriptorSet set, const UniformSet& u
 		VkDescriptorBufferInfo bufferInfo = {};
 		bufferInfo.buffer = ((const VkBufferContainer*) getUniformBuffer(uniformBufferFromSetType(uniformSet.getType())))->getBuffer();
 		bufferInfo.offset = 0;
-		bufferInfo.range = Std140Aligner::getAlignedSize(uniformSet);
+		bufferInfo.range = Std140Aligner::getBlockSize(uniformSet);
 
 		bufferInfos.push_back(bufferInfo);
 
@@ -197,6 +197,17 @@ protected:
 	 */
 	void addMaterialDescriptors(const Material* material) override;
 
+	/**
+	 * Waits for the device to finish all submitted work.
+	 */
+	void waitIdle() override { vkDeviceWaitIdle(objects.getDevice()); }
+
+	/**
+	 * Points the screen and object descriptor sets at the new buffer.
+	 * @param type The uniform buffer that was replaced.
+	 */
+	void uniformBufferReplaced(UniformBufferType type) override;
+
 private:
 	//Object handler for vulkan objects.
 	VkObjectHandler& objects;
@@ -364,6 +364,8 @@ void VkObjectHandler::createLogicalDevice() {
 
 	VkPhysicalDeviceFeatures usedDeviceFeatures = {};
 	usedDeviceFeatures.samplerAnisotropy = physicalDeviceFeatures.samplerAnisotropy;
+	usedDeviceFeatures.multiDrawIndirect = physicalDeviceFeatures.multiDrawIndirect;
+	usedDeviceFeatures.drawIndirectFirstInstance = physicalDeviceFeatures.drawIndirectFirstInstance;
 
 	std::vector<const char*> deviceExtensions;
 	deviceExtensions.reserve(requiredExtensions.size());
@@ -443,6 +445,8 @@ void VkObjectHandler::logPhysicalDeviceFeatures() {
 	ENGINE_LOG_INFO(logger, "Feature availability:");
 	ENGINE_LOG_INFO(logger, "\tAnisotropic filtering: " + std::string(physicalDeviceFeatures.samplerAnisotropy ? "Yes" : "No"));
 	ENGINE_LOG_INFO(logger, "\tMax Anisotropy: " + std::to_string(physicalDeviceProperties.limits.maxSamplerAnisotropy));
+	ENGINE_LOG_INFO(logger, "\tMulti-draw indirect: " + std::string(physicalDeviceFeatures.multiDrawIndirect ? "Yes" : "No"));
+	ENGINE_LOG_INFO(logger, "\tIndirect first instance: " + std::string(physicalDeviceFeatures.drawIndirectFirstInstance ? "Yes" : "No"));
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL VkObjectHandler::debugCallback(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objType, uint64_t obj, size_t location, int32_t code, const char* layerPrefix, const char* mesg, void* usrData) {
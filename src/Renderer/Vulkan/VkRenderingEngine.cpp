@@ -16,6 +16,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ******************************************************************************/
 
+#include <algorithm>
+
 #include "VkRenderingEngine.hpp"
 #include "Engine.hpp"
 #include "VkShaderLoader.hpp"
@@ -40,7 +42,8 @@ VkRenderingEngine::VkRenderingEngine(DisplayEngine& display, const LogConfig& re
 	objectHandler(logger),
 	swapObjects(objectHandler),
 	memoryManager(rendererLog, objectHandler),
-	currentImageIndex(0) {
+	currentImageIndex(0),
+	indirectSupported(false) {
 
 	if (!glfwInit()) {
 		throw std::runtime_error("Couldn't initialize glfw");
@@ -51,6 +54,14 @@ VkRenderingEngine::~VkRenderingEngine() {
 	//Don't destroy things while rendering.
 	vkDeviceWaitIdle(objectHandler.getDevice());
 
+	for (RecordingThread& thread : recordingThreads) {
+		for (VkCommandPool pool : thread.pools) {
+			if (pool != VK_NULL_HANDLE) {
+				vkDestroyCommandPool(objectHandler.getDevice(), pool, nullptr);
+			}
+		}
+	}
+
 	for (size_t i = 0; i < MAX_ACTIVE_FRAMES; i++) {
 		vkDestroySemaphore(objectHandler.getDevice(), imageAvailable.at(i), nullptr);
 		vkDestroySemaphore(objectHandler.getDevice(), renderFinished.at(i), nullptr);
@@ -99,6 +110,10 @@ void VkRenderingEngine::init() {
 
 	objectHandler.init(window);
 	memoryManager.init();
+
+	//Indirect draws use one command per mesh, with instances starting partway into the instance array
+	const VkPhysicalDeviceFeatures& features = objectHandler.getPhysicalDeviceFeatures();
+	indirectSupported = features.multiDrawIndirect && features.drawIndirectFirstInstance;
 	swapObjects.init(memoryManager);
 
 	//Allocate command buffers
@@ -163,6 +178,15 @@ void VkRenderingEngine::beginFrame() {
 	//Reset fence here because of the return above
 	vkResetFences(objectHandler.getDevice(), 1, &renderFences.at(currentFrame));
 
+	//The frame's secondary buffers finished executing along with the fence, so they can be reused
+	for (RecordingThread& thread : recordingThreads) {
+		if (thread.pools.at(currentFrame) != VK_NULL_HANDLE) {
+			vkResetCommandPool(objectHandler.getDevice(), thread.pools.at(currentFrame), 0);
+		}
+
+		thread.usedBuffers.at(currentFrame) = 0;
+	}
+
 	//Begin command buffer for this frame
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -190,7 +214,8 @@ void VkRenderingEngine::beginFrame() {
 	passBeginInfo.clearValueCount = 2;
 	passBeginInfo.pClearValues = clearValues;
 
-	vkCmdBeginRenderPass(commandBuffers.at(currentFrame), &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	//All drawing is recorded into secondary buffers, from multiple threads
+	vkCmdBeginRenderPass(commandBuffers.at(currentFrame), &passBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 }
 
 void VkRenderingEngine::setViewport(int width, int height) {
@@ -245,167 +270,295 @@ void VkRenderingEngine::apiPresent() {
 	}
 }
 
-void VkRenderingEngine::renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) {
+void VkRenderingEngine::renderObjects(const DrawList& drawList, const Screen* screen) {
 	const Camera* camera = screen->getCamera().get();
 	const ScreenState* state = screen->getState().get();
 
-	bool drewSomething = false;
+	if (drawList.size() == 0) {
+		return;
+	}
 
-	drewSomething |= renderTransparencyPass(RenderPass::OPAQUE, sortedObjects, camera, state);
-	drewSomething |= renderTransparencyPass(RenderPass::TRANSPARENT, sortedObjects, camera, state);
-	drewSomething |= renderTransparencyPass(RenderPass::TRANSLUCENT, sortedObjects, camera, state);
+	//Write screen uniforms up front, as they're the same for every chunk. Also split each
+	//pass's list into chunks to be recorded in parallel. Chunks only end where the batch
+	//changes, so instanced and indirect draws are never split.
+	screenSetOffsets.clear();
+	recordChunks.clear();
 
-	if (drewSomething) {
-		//TODO: generate render passes at engine initialization to render this unnecessary
-		VkClearAttachment depthClear = {};
-		depthClear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		depthClear.clearValue.depthStencil = {1.0f, 0};
+	for (size_t pass = 0; pass < DrawList::PASS_COUNT; pass++) {
+		const std::vector<DrawItem>& items = drawList.getItems((RenderPass) pass);
 
-		VkClearRect clearRect = {};
-		clearRect.rect.extent = swapObjects.getSwapchainExtent();
-		clearRect.layerCount = 1;
+		for (size_t i = 0; i < items.size(); i++) {
+			if (i != 0 && DrawList::getShader(items.at(i).key) == DrawList::getShader(items.at(i - 1).key)) {
+				continue;
+			}
 
-		vkCmdClearAttachments(commandBuffers.at(currentFrame), 1, &depthClear, 1, &clearRect);
-	}
-}
+			const std::string& screenSetName = shaderMap.at(items.at(i).object->getModel().material->shader)->getPerScreenDescriptor();
 
-bool VkRenderingEngine::renderTransparencyPass(RenderPass pass, RenderManager::RenderPassList sortedObjects, const Camera* camera, const ScreenState* screenState) {
-	//TODO: this needs to be made threadable, and just rewritten in general - it's currently just a direct port of the GlRenderingEngine's loop.
-	//Also, each loop should probably be its own function, this is getting ridiculous.
+			if (!screenSetName.empty() && !screenSetOffsets.count(screenSetName)) {
+				const UniformLayout& screenLayout = memoryManager.getUniformLayout(screenSetName);
+				uint32_t offset = 0;
 
-	bool drewSomething = false;
+				//Sets that didn't fit are left out, and anything using them isn't drawn
+				if (memoryManager.writePerFrameUniforms(screenLayout.getSize(), currentFrame, offset, [&](unsigned char* block) {
+					packScreenUniforms(screenLayout, block, state, camera, projectionCorrection);
+				})) {
+					screenSetOffsets.emplace(screenSetName, offset);
+				}
+			}
+		}
 
-	//Per-buffer loop
-	for (const auto& shaderObjectMap : sortedObjects) {
-		bool bufferBound = false;
+		size_t chunkBegin = 0;
 
-		//Per-shader loop
-		for (const auto& modelMap : shaderObjectMap.second) {
-			const std::string& shaderName = modelMap.first;
-			const std::shared_ptr<VkShader> shader = shaderMap.at(shaderName);
-			bool shaderBound = false;
+		while (chunkBegin < items.size()) {
+			size_t chunkEnd = std::min(items.size(), chunkBegin + RECORD_CHUNK_SIZE);
 
-			//Skip these objects if their shader isn't in the current render pass
-			if (shader->getRenderPass() != pass) {
-				continue;
+			while (chunkEnd < items.size() && (items.at(chunkEnd).key >> DrawList::BATCH_SHIFT) == (items.at(chunkEnd - 1).key >> DrawList::BATCH_SHIFT)) {
+				chunkEnd++;
 			}
 
-			bool screenSetBound = false;
-			const std::string& screenSetName = shader->getPerScreenDescriptor();
+			recordChunks.push_back({(RenderPass) pass, chunkBegin, chunkEnd});
+			chunkBegin = chunkEnd;
+		}
+	}
 
-			//Per-model loop
-			for (const auto& objectSet : modelMap.second) {
-				const Material* material = objectSet.first;
+	const size_t chunkCount = recordChunks.size();
+	chunkBuffers.resize(chunkCount);
 
-				bool materialSetBound = false;
+	Engine::parallelFor(0, chunkCount, [&](size_t chunk) {
+		RecordingThread& thread = getRecordingThread();
+		VkCommandBuffer commandBuffer = getSecondaryBuffer(thread);
 
-				//Per-object loop
-				for (const RenderComponent* comp : objectSet.second) {
-					if (!comp->isVisible()) {
-						continue;
-					}
+		VkCommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = swapObjects.getRenderPass();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = swapObjects.getFramebuffer(currentImageIndex);
 
-					//Set shader / buffer if needed
-					if (!shaderBound) {
-						vkCmdBindPipeline(commandBuffers.at(currentFrame), VK_PIPELINE_BIND_POINT_GRAPHICS, shader->getPipeline());
-						shaderBound = true;
-					}
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-					if (!bufferBound) {
-						const VkDeviceSize zero = 0;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to start recording secondary command buffer.");
+		}
 
-						//For now, assume that vertex buffers are always paired with the same index buffers
-						const Mesh::BufferInfo& buffers = comp->getModel().mesh->getBufferInfo();
+		const RecordChunk& recordInfo = recordChunks.at(chunk);
+		recordChunk(drawList.getItems(recordInfo.pass), recordInfo.begin, recordInfo.end, commandBuffer, thread, camera);
 
-						VkBuffer vertexBuffer = ((const VkBufferContainer*) buffers.vertex)->getBuffer();
-						VkBuffer indexBuffer = ((const VkBufferContainer*) buffers.index)->getBuffer();
+		//The depth clear has to be in a secondary buffer too, as the render pass only allows those
+		if (chunk == chunkCount - 1) {
+			//TODO: generate render passes at engine initialization to render this unnecessary
+			VkClearAttachment depthClear = {};
+			depthClear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			depthClear.clearValue.depthStencil = {1.0f, 0};
 
-						vkCmdBindVertexBuffers(commandBuffers.at(currentFrame), 0, 1, &vertexBuffer, &zero);
-						vkCmdBindIndexBuffer(commandBuffers.at(currentFrame), indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			VkClearRect clearRect = {};
+			clearRect.rect.extent = swapObjects.getSwapchainExtent();
+			clearRect.layerCount = 1;
 
-						bufferBound = true;
-					}
+			vkCmdClearAttachments(commandBuffer, 1, &depthClear, 1, &clearRect);
+		}
 
-					//Bind descriptor sets if needed
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record secondary command buffer.");
+		}
 
-					std::array<VkDescriptorSet, 3> bindSets;
-					std::array<uint32_t, 3> bindOffsets;
-					size_t numSets = 0;
-					size_t numOffsets = 0;
-					//Which set to start binding at - don't rebind already bound sets.
-					size_t startSet = 0;
+		chunkBuffers.at(chunk) = commandBuffer;
+	}, 1);
 
-					//Screen set
-					if (!screenSetName.empty()) {
-						if (!screenSetBound) {
-							Std140Aligner& screenAligner = memoryManager.getDescriptorAligner(screenSetName);
+	vkCmdExecuteCommands(commandBuffers.at(currentFrame), chunkBuffers.size(), chunkBuffers.data());
+}
 
-							setPerScreenUniforms(memoryManager.getUniformSet(screenSetName), screenAligner, screenState, camera, projectionCorrection);
+void VkRenderingEngine::recordChunk(const std::vector<DrawItem>& items, size_t begin, size_t end, VkCommandBuffer commandBuffer, RecordingThread& thread, const Camera* camera) {
+	std::shared_ptr<VkShader> shader;
+	const UniformLayout* objectLayout = nullptr;
+	size_t maxInstances = 0;
+	bool screenSetBound = false;
+
+	for (size_t i = begin, groupEnd = begin; i < end; i = groupEnd) {
+		const uint64_t key = items.at(i).key;
+		const RenderComponent* comp = items.at(i).object;
+		const Material* material = comp->getModel().material;
+		const bool newShader = i == begin || DrawList::getShader(key) != DrawList::getShader(items.at(i - 1).key);
+		const bool newBuffer = newShader || DrawList::getBuffer(key) != DrawList::getBuffer(items.at(i - 1).key);
+		const bool newBatch = newBuffer || DrawList::getBatch(key) != DrawList::getBatch(items.at(i - 1).key);
+
+		if (newShader) {
+			shader = shaderMap.at(material->shader);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shader->getPipeline());
+			maxInstances = getShaderMaxInstances(material->shader);
+			objectLayout = shader->getPerObjectDescriptor().empty() ? nullptr : &memoryManager.getUniformLayout(shader->getPerObjectDescriptor());
+			screenSetBound = false;
+		}
 
-							bindSets.at(numSets) = memoryManager.getDescriptorSet(screenSetName);
-							bindOffsets.at(numOffsets) = memoryManager.writePerFrameUniforms(screenAligner, currentFrame);
+		//Objects sharing a mesh and material are drawn together if the shader allows it, and
+		//opaque objects sharing only a material are drawn with one indirect draw if supported.
+		const bool indirect = maxInstances && indirectSupported && DrawList::getPass(key) == RenderPass::OPAQUE;
 
-							screenSetBound = true;
-							numSets++;
-							numOffsets++;
-						}
-						else {
-							//Screen set already bound, start binding at model set
-							startSet++;
-						}
-					}
+		if (indirect) {
+			groupEnd = buildIndirectCommands(items, i, std::min(maxInstances, end - i), thread.indirectCommands);
+		}
+		else {
+			groupEnd = maxInstances ? getInstanceGroupEnd(items, i, std::min(maxInstances, end - i)) : i + 1;
+		}
 
-					//Model set
-					if (!materialSetBound) {
-						bindSets.at(numSets) = memoryManager.getDescriptorSet(material->name);
-						numSets++;
+		//Screen set
+		const std::string& screenSetName = shader->getPerScreenDescriptor();
 
-						if (material->hasBufferedUniforms) {
-							bindOffsets.at(numOffsets) = material->uniformOffset;
-							numOffsets++;
-						}
+		//Out of per-frame uniform space, so nothing using this shader can be drawn correctly this frame
+		if (!screenSetName.empty() && !screenSetOffsets.count(screenSetName)) {
+			continue;
+		}
 
-						materialSetBound = true;
-					}
-					else {
-						//Model set will never be bound without a screen set, so this is perfectly safe
-						startSet++;
-					}
+		if (newBuffer) {
+			const VkDeviceSize zero = 0;
 
-					//Object set
-					if (!shader->getPerObjectDescriptor().empty()) {
-						const std::string& objectDescriptor = shader->getPerObjectDescriptor();
+			//For now, assume that vertex buffers are always paired with the same index buffers
+			const Mesh::BufferInfo& buffers = items.at(i).mesh->getBufferInfo();
 
-						Std140Aligner& objectAligner = memoryManager.getDescriptorAligner(objectDescriptor);
+			VkBuffer vertexBuffer = ((const VkBufferContainer*) buffers.vertex)->getBuffer();
+			VkBuffer indexBuffer = ((const VkBufferContainer*) buffers.index)->getBuffer();
 
-						setPerObjectUniforms(memoryManager.getUniformSet(objectDescriptor), objectAligner, comp, camera);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &zero);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		}
 
-						bindSets.at(numSets) = memoryManager.getDescriptorSet(objectDescriptor);
-						bindOffsets.at(numOffsets) = memoryManager.writePerFrameUniforms(objectAligner, currentFrame);
+		//Bind descriptor sets if needed
 
-						numSets++;
-						numOffsets++;
-					}
+		std::array<VkDescriptorSet, 3> bindSets;
+		std::array<uint32_t, 3> bindOffsets;
+		size_t numSets = 0;
+		size_t numOffsets = 0;
+		//Which set to start binding at - don't rebind already bound sets.
+		size_t startSet = 0;
 
-					if (numSets > 0) {
-						vkCmdBindDescriptorSets(commandBuffers.at(currentFrame), VK_PIPELINE_BIND_POINT_GRAPHICS, shader->getPipelineLayout(), startSet, numSets, bindSets.data(), numOffsets, bindOffsets.data());
-					}
+		//Screen set, the uniforms were already written before recording started
+		if (!screenSetName.empty()) {
+			if (!screenSetBound) {
+				bindSets.at(numSets) = memoryManager.getDescriptorSet(screenSetName);
+				bindOffsets.at(numOffsets) = screenSetOffsets.at(screenSetName);
 
-					setPushConstants(shader, comp, camera);
+				screenSetBound = true;
+				numSets++;
+				numOffsets++;
+			}
+			else {
+				//Screen set already bound, start binding at model set
+				startSet++;
+			}
+		}
 
-					const std::tuple<uintptr_t, uint32_t, int32_t> meshInfo = comp->getModel().mesh->getRenderInfo();
+		//Model set
+		if (newBatch) {
+			bindSets.at(numSets) = memoryManager.getDescriptorSet(material->name);
+			numSets++;
 
-					vkCmdDrawIndexed(commandBuffers.at(currentFrame), std::get<1>(meshInfo), 1, std::get<0>(meshInfo), std::get<2>(meshInfo), 0);
-					drewSomething = true;
-				}
+			if (material->hasBufferedUniforms) {
+				bindOffsets.at(numOffsets) = material->uniformOffset;
+				numOffsets++;
 			}
 		}
+		else {
+			//Model set will never be bound without a screen set, so this is perfectly safe
+			startSet++;
+		}
+
+		//Object set, as one array for the whole group if instanced
+		bool objectSetWritten = true;
+
+		if (objectLayout) {
+			bindSets.at(numSets) = memoryManager.getDescriptorSet(shader->getPerObjectDescriptor());
+
+			if (maxInstances) {
+				objectSetWritten = memoryManager.writePerFrameUniforms(objectLayout->getInstanceStride() * (groupEnd - i), currentFrame, bindOffsets.at(numOffsets), [&](unsigned char* block) {
+					packInstanceUniforms(*objectLayout, block, items, i, groupEnd, camera);
+				});
+			}
+			else {
+				objectSetWritten = memoryManager.writePerFrameUniforms(objectLayout->getSize(), currentFrame, bindOffsets.at(numOffsets), [&](unsigned char* block) {
+					packObjectUniforms(*objectLayout, block, comp, camera);
+				});
+			}
+
+			numSets++;
+			numOffsets++;
+		}
+
+		if (numSets > 0) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shader->getPipelineLayout(), startSet, numSets, bindSets.data(), numOffsets, bindOffsets.data());
+		}
+
+		//The sets above are still bound, so later groups can rely on them
+		if (!objectSetWritten) {
+			continue;
+		}
+
+		//Instanced shaders can't have per-object push constants, so the first object's values work for the whole group
+		setPushConstants(commandBuffer, shader, comp, camera);
+
+		if (indirect) {
+			size_t commandOffset = 0;
+
+			//Skipped if out of space, like uniforms
+			if (memoryManager.writeIndirectCommands(thread.indirectCommands.data(), thread.indirectCommands.size(), currentFrame, commandOffset)) {
+				VkBuffer indirectBuffer = ((const VkBufferContainer*) memoryManager.getIndirectBuffer())->getBuffer();
+
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, commandOffset, thread.indirectCommands.size(), sizeof(IndirectDrawCommand));
+			}
+		}
+		else {
+			const std::tuple<uintptr_t, uint32_t, int32_t> meshInfo = items.at(i).mesh->getRenderInfo();
+
+			vkCmdDrawIndexed(commandBuffer, std::get<1>(meshInfo), groupEnd - i, std::get<0>(meshInfo), std::get<2>(meshInfo), 0);
+		}
+	}
+}
+
+VkRenderingEngine::RecordingThread& VkRenderingEngine::getRecordingThread() {
+	bool exists = false;
+	RecordingThread& thread = recordingThreads.local(exists);
+
+	if (!exists) {
+		VkCommandPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolCreateInfo.queueFamilyIndex = objectHandler.getGraphicsQueueIndex();
+
+		for (VkCommandPool& pool : thread.pools) {
+			if (vkCreateCommandPool(objectHandler.getDevice(), &poolCreateInfo, nullptr, &pool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create recording command pool!");
+			}
+		}
+	}
+
+	return thread;
+}
+
+VkCommandBuffer VkRenderingEngine::getSecondaryBuffer(RecordingThread& thread) {
+	std::vector<VkCommandBuffer>& buffers = thread.buffers.at(currentFrame);
+	size_t& used = thread.usedBuffers.at(currentFrame);
+
+	if (used == buffers.size()) {
+		VkCommandBufferAllocateInfo bufferAllocInfo = {};
+		bufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		bufferAllocInfo.commandPool = thread.pools.at(currentFrame);
+		bufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		bufferAllocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer buffer = VK_NULL_HANDLE;
+
+		if (vkAllocateCommandBuffers(objectHandler.getDevice(), &bufferAllocInfo, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate secondary command buffer!");
+		}
+
+		buffers.push_back(buffer);
 	}
 
-	return drewSomething;
+	return buffers.at(used++);
 }
 
-void VkRenderingEngine::setPushConstants(const std::shared_ptr<const VkShader>& shader, const RenderComponent* comp, const Camera* camera) {
+void VkRenderingEngine::setPushConstants(VkCommandBuffer commandBuffer, const std::shared_ptr<const VkShader>& shader, const RenderComponent* comp, const Camera* camera) {
 	//Need to make this bigger if the minimum size ever changes. Maybe make it 256 (biggest value seen for maxPushConstantsSize) and restrict it dynamically?
 	unsigned char pushConstantMem[128];
 	const std::vector<PushRange>& pushRanges = shader->getPushConstantRanges();
@@ -421,7 +574,7 @@ void VkRenderingEngine::setPushConstants(const std::shared_ptr<const VkShader>&
 			switch (uniform.provider) {
 				case UniformProviderType::OBJECT_STATE: pushVal = comp->getParentState()->getRenderValue(uniform.name); break;
 				case UniformProviderType::OBJECT_TRANSFORM: tempMat = comp->getTransform(); pushVal = &tempMat; break;
-				case UniformProviderType::OBJECT_MODEL_VIEW: tempMat = camera->getView() * comp->getTransform(); pushVal = &tempMat; break;
+				case UniformProviderType::OBJECT_MODEL_VIEW: tempMat = camera->getRenderView() * comp->getTransform(); pushVal = &tempMat; break;
 				default: throw std::runtime_error("Invalid push constant provider!");
 			}
 
@@ -436,6 +589,6 @@ void VkRenderingEngine::setPushConstants(const std::shared_ptr<const VkShader>&
 			}
 		}
 
-		vkCmdPushConstants(commandBuffers.at(currentFrame), shader->getPipelineLayout(), range.shaderStages.to_ulong(), range.start, range.size, &pushConstantMem[range.start]);
+		vkCmdPushConstants(commandBuffer, shader->getPipelineLayout(), range.shaderStages.to_ulong(), range.start, range.size, &pushConstantMem[range.start]);
 	}
 }
@@ -19,9 +19,12 @@
 #pragma once
 
 #include <array>
+#include <vector>
+#include <unordered_map>
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
+#include <tbb/enumerable_thread_specific.h>
 
 #include "Renderer/RenderingEngine.hpp"
 #include "Display/DisplayEngine.hpp"
@@ -88,13 +91,66 @@ protected:
 	void apiPresent() override;
 
 	/**
-	 * Renders the visible objects, using the sorted map.
-	 * @param sortedObjects All objects, sorted by buffer, then shader, then model.
+	 * Renders the visible objects, in draw list order.
+	 * @param drawList The sorted list of objects to render.
 	 * @param screen The screen to render.
 	 */
-	void renderObjects(RenderManager::RenderPassList sortedObjects, const Screen* screen) override;
+	void renderObjects(const DrawList& drawList, const Screen* screen) override;
+
+	/**
+	 * Gets the render pass for the given shader.
+	 * @param shader The shader's name.
+	 * @return The shader's render pass.
+	 */
+	RenderPass getShaderPass(const std::string& shader) const override { return shaderMap.at(shader)->getRenderPass(); }
+
+	/**
+	 * Gets the maximum instances for the given shader.
+	 * @param shader The shader's name.
+	 * @return The max instances of the shader's object set, or 0 if not instanced.
+	 */
+	size_t getShaderMaxInstances(const std::string& shader) const override {
+		const std::string& objectSet = shaderMap.at(shader)->getPerObjectDescriptor();
+		return objectSet.empty() ? 0 : memoryManager.getUniformSet(objectSet).getMaxInstances();
+	}
+
+	/**
+	 * Gets the per-screen uniform set for the given shader.
+	 * @param shader The shader's name.
+	 * @return The name of the set, or an empty string if not present.
+	 */
+	const std::string& getShaderScreenSet(const std::string& shader) const override { return shaderMap.at(shader)->getPerScreenDescriptor(); }
+
+	/**
+	 * Gets the per-object uniform set for the given shader.
+	 * @param shader The shader's name.
+	 * @return The name of the set, or an empty string if not present.
+	 */
+	const std::string& getShaderObjectSet(const std::string& shader) const override { return shaderMap.at(shader)->getPerObjectDescriptor(); }
 
 private:
+	//Minimum number of draws recorded into each secondary command buffer.
+	constexpr static size_t RECORD_CHUNK_SIZE = 256;
+
+	//Everything a thread needs to record draws on its own.
+	struct RecordingThread {
+		//One pool for each frame, so a frame's buffers can be reset while the other frame is executing.
+		std::array<VkCommandPool, MAX_ACTIVE_FRAMES> pools = {};
+		//Secondary buffers allocated from each pool.
+		std::array<std::vector<VkCommandBuffer>, MAX_ACTIVE_FRAMES> buffers;
+		//Number of buffers used so far for each frame.
+		std::array<size_t, MAX_ACTIVE_FRAMES> usedBuffers = {};
+		//Scratch space for indirect commands.
+		std::vector<IndirectDrawCommand> indirectCommands;
+	};
+
+	//A range of one pass's draw list, recorded into a single secondary buffer.
+	struct RecordChunk {
+		RenderPass pass;
+		size_t begin;
+		size_t end;
+	};
+
 	//Interface with the window system.
 	GlfwInterface interface;
 	//Handles all internal vulkan objects.
@@ -109,6 +165,16 @@ private:
 	std::array<VkCommandBuffer, MAX_ACTIVE_FRAMES> commandBuffers;
 	//Current swapchain image index.
 	uint32_t currentImageIndex;
+	//Whether opaque instanced objects can be drawn with multi-draw indirect.
+	bool indirectSupported;
+	//Recording state for each thread that has recorded draws.
+	tbb::enumerable_thread_specific<RecordingThread> recordingThreads;
+	//Offsets of the screen uniforms written for the screen being rendered.
+	std::unordered_map<std::string, uint32_t> screenSetOffsets;
+	//Chunks of the draw list being recorded, in draw order.
+	std::vector<RecordChunk> recordChunks;
+	//Secondary buffer recorded for each chunk, in draw order.
+	std::vector<VkCommandBuffer> chunkBuffers;
 
 	//Rendering semaphores, one for each frame.
 	std::array<VkSemaphore, MAX_ACTIVE_FRAMES> imageAvailable;
@@ -116,20 +182,36 @@ private:
 	std::array<VkFence, MAX_ACTIVE_FRAMES> renderFences;
 
 	/**
-	 * Renders a single transparency pass.
-	 * @param pass The current rendering pass.
-	 * @param objects A container of the objects to render. See RenderComponentManager.hpp for what it actually is.
+	 * Records part of the draw list into a secondary command buffer. Can be called from multiple
+	 * threads at once, as long as each uses a different RecordingThread.
+	 * @param items The sorted draw list items.
+	 * @param begin The first item to record, must be the start of a batch.
+	 * @param end One past the last item to record, must be the end of a batch.
+	 * @param commandBuffer The secondary buffer to record into.
+	 * @param thread The recording state for the current thread.
 	 * @param camera The camera for the current screen.
-	 * @param screenState The state of the current screen.
-	 * @return Whether something was drawn, used to shut up the validation layers until a better solution is found.
 	 */
-	bool renderTransparencyPass(RenderPass pass, RenderManager::RenderPassList sortedObjects, const Camera* camera, const ScreenState* screenState);
+	void recordChunk(const std::vector<DrawItem>& items, size_t begin, size_t end, VkCommandBuffer commandBuffer, RecordingThread& thread, const Camera* camera);
+
+	/**
+	 * Gets the recording state for the current thread, creating its command pools if needed.
+	 * @return The thread's recording state.
+	 */
+	RecordingThread& getRecordingThread();
+
+	/**
+	 * Gets an unused secondary command buffer for the current frame from the thread's pool.
+	 * @param thread The recording state for the current thread.
+	 * @return The command buffer.
+	 */
+	VkCommandBuffer getSecondaryBuffer(RecordingThread& thread);
 
 	/**
 	 * Sets the push constant values for the provided object.
+	 * @param commandBuffer The command buffer to record into.
 	 * @param shader The shader the object uses, contains push constant offsets and usage flags.
 	 * @param comp The object to set push constants for.
 	 * @param camera The current camera, for view transforms.
 	 */
-	void setPushConstants(const std::shared_ptr<const VkShader>& shader, const RenderComponent* comp, const Camera* camera);
+	void setPushConstants(VkCommandBuffer commandBuffer, const std::shared_ptr<const VkShader>& shader, const RenderComponent* comp, const Camera* camera);
 };
@@ -129,6 +129,8 @@ void VkShaderLoader::loadShader(std::string name, const ShaderInfo& info) {
 		}
 	}
 
+	validateInstancing(name, info, objectSet.empty() ? nullptr : &memoryManager->getUniformSet(objectSet));
+
 	//Create shader and add to shader map
 	shaderMap.insert({name, std::make_shared<VkShader>(vkObjects.getDevice(), pipelineCache, pipelineLayout, info.pushConstants, pipelineCreator, screenSet, objectSet)});
 
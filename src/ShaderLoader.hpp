@@ -19,6 +19,7 @@
 #pragma once
 
 #include <string>
+#include <stdexcept>
 
 #include "Logger.hpp"
 #include "Renderer/ShaderInfo.hpp"
@@ -47,4 +48,28 @@ public:
 
 protected:
 	Logger logger;
+
+	/**
+	 * Checks that a shader with an instanced object set doesn't use per-object push
+	 * constants, as those are only set once for each instanced draw.
+	 * @param name The name of the shader.
+	 * @param info The shader's information.
+	 * @param objectSet The shader's per-object set, or null if it doesn't have one.
+	 * @throw runtime_error if the shader is instanced and has per-object push constants.
+	 */
+	static void validateInstancing(const std::string& name, const ShaderInfo& info, const UniformSet* objectSet) {
+		if (!objectSet || objectSet->getMaxInstances() == 0) {
+			return;
+		}
+
+		for (const UniformDescription& uniform : info.pushConstants) {
+			switch (uniform.provider) {
+				case UniformProviderType::OBJECT_MODEL_VIEW:
+				case UniformProviderType::OBJECT_TRANSFORM:
+				case UniformProviderType::OBJECT_STATE:
+					throw std::runtime_error("Instanced shader \"" + name + "\" can't use per-object push constant \"" + uniform.name + "\"!");
+				default: break;
+			}
+		}
+	}
 };
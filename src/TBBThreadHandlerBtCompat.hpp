@@ -23,33 +23,68 @@
 #include <functional>
 
 #include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
 
 #include "LinearMath/btThreads.h"
 
 class TaskSchedulerTBB : public btITaskScheduler {
 public:
-	TaskSchedulerTBB() : btITaskScheduler("IntelTBB") {}
+	TaskSchedulerTBB() :
+		btITaskScheduler("IntelTBB"),
+		numThreads(getMaxNumThreads()),
+		arena(numThreads) {}
 
 	virtual int getMaxNumThreads() const override {
-		return std::max(1u, std::thread::hardware_concurrency());
+		//Bullet keeps per-thread data in fixed size arrays, so it can't use more than this.
+		return std::min(std::max(1, (int) std::thread::hardware_concurrency()), BT_MAX_THREAD_COUNT);
 	}
 
 	virtual int getNumThreads() const override {
-		//Just assume TBB uses the max avialable - no actual way of getting
-		//the number without using deprecated interfaces.
-		return std::max(1u, std::thread::hardware_concurrency());
+		return numThreads;
 	}
 
-	virtual void setNumThreads(int numThreads) override {}
+	/**
+	 * Sets the maximum number of threads bullet's work is split across.
+	 * Must not be called while the scheduler is running anything.
+	 * @param newThreads The number of threads, clamped to [1, getMaxNumThreads()].
+	 */
+	virtual void setNumThreads(int newThreads) override {
+		newThreads = std::max(1, std::min(newThreads, getMaxNumThreads()));
+
+		if (newThreads != numThreads) {
+			numThreads = newThreads;
+			arena.terminate();
+			arena.initialize(numThreads);
+		}
+	}
 
 	virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) override {
-		tbb::parallel_for(tbb::blocked_range<int>(iBegin, iEnd, 0), [&body](const tbb::blocked_range<int>& range) {
-			body.forLoop(range.begin(), range.end());
+		arena.execute([&]() {
+			tbb::parallel_for(tbb::blocked_range<int>(iBegin, iEnd, std::max(1, grainSize)), [&body](const tbb::blocked_range<int>& range) {
+				body.forLoop(range.begin(), range.end());
+			});
 		});
 	}
 
 	virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) override {
-		//Not even going to bother here, it's just addition. Might need changing if constraint support is added.
-		return body.sumLoop(iBegin, iEnd);
+		btScalar sum = 0;
+
+		arena.execute([&]() {
+			sum = tbb::parallel_reduce(tbb::blocked_range<int>(iBegin, iEnd, std::max(1, grainSize)), btScalar(0),
+				[&body](const tbb::blocked_range<int>& range, btScalar partialSum) {
+					return partialSum + body.sumLoop(range.begin(), range.end());
+				},
+				std::plus<btScalar>()
+			);
+		});
+
+		return sum;
 	}
+
+private:
+	//The current thread limit.
+	int numThreads;
+	//Limits bullet's tasks to numThreads threads, without affecting the rest of the engine.
+	tbb::task_arena arena;
 };
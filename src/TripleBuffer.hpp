@@ -0,0 +1,88 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+//Lets one thread repeatedly produce values while another reads the most recent
+//complete one, without either ever waiting on the other. The writer fills the
+//back buffer and publishes it, the reader acquires the latest published buffer.
+//Only one thread may write and one thread may acquire at a time, though any
+//number of threads can read the acquired buffer between acquires.
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() :
+		buffers(),
+		front(0),
+		middle(1),
+		back(2) {}
+
+	/**
+	 * Gets the buffer to write the next value into. Writer only.
+	 * @return The back buffer.
+	 */
+	T& getWriteBuffer() { return buffers[back]; }
+
+	/**
+	 * Makes the back buffer available to the reader, and gets a new back
+	 * buffer to write to. Writer only.
+	 */
+	void publish() {
+		back = middle.exchange(back | FRESH_BIT) & INDEX_MASK;
+	}
+
+	/**
+	 * Makes the most recently published buffer the read buffer, if one was
+	 * published since the last acquire. Reader only.
+	 * @return Whether a new buffer was acquired.
+	 */
+	bool acquire() {
+		if (!(middle.load() & FRESH_BIT)) {
+			return false;
+		}
+
+		front = middle.exchange(front) & INDEX_MASK;
+		return true;
+	}
+
+	/**
+	 * Gets the buffer acquired by the last call to acquire.
+	 * @return The front buffer.
+	 */
+	T& getReadBuffer() { return buffers[front]; }
+	const T& getReadBuffer() const { return buffers[front]; }
+
+private:
+	//Set in middle when it has been published, but not acquired yet.
+	static constexpr uint8_t FRESH_BIT = 0x4;
+	//Mask to get the buffer index from middle.
+	static constexpr uint8_t INDEX_MASK = 0x3;
+
+	std::array<T, 3> buffers;
+	//Index of the buffer being read, owned by the reader.
+	uint8_t front;
+	//Index of the buffer last exchanged, possibly with FRESH_BIT set.
+	std::atomic<uint8_t> middle;
+	//Index of the buffer being written, owned by the writer.
+	uint8_t back;
+};
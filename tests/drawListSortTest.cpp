@@ -0,0 +1,138 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "../src/Renderer/DrawList.hpp"
+
+//Checks the parallel radix sort against std::stable_sort, and that each pass's sort policy orders by depth correctly.
+
+bool checkSort(const std::string& name, size_t itemCount, uint64_t keyMask, std::mt19937_64& random) {
+	DrawList drawList;
+	std::vector<DrawItem> items;
+
+	//Objects are numbered in order, so stability can be checked
+	for (size_t i = 0; i < itemCount; i++) {
+		items.push_back({random() & keyMask, (const RenderComponent*) (i + 1)});
+	}
+
+	drawList.add(RenderPass::OPAQUE, items);
+	drawList.sort();
+
+	std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) {
+		return a.key < b.key;
+	});
+
+	const std::vector<DrawItem>& sorted = drawList.getItems(RenderPass::OPAQUE);
+
+	for (size_t i = 0; i < items.size(); i++) {
+		if (sorted.at(i).key != items.at(i).key || sorted.at(i).object != items.at(i).object) {
+			std::cout << name << " test failed! Item " << i << " out of order.\n";
+			return false;
+		}
+	}
+
+	std::cout << name << " test passed.\n";
+	return true;
+}
+
+//Gets the depths of the items in a pass, in draw order.
+std::vector<uint64_t> getDrawDepths(const DrawList& drawList, RenderPass pass) {
+	std::vector<uint64_t> depths;
+
+	for (const DrawItem& item : drawList.getItems(pass)) {
+		depths.push_back((uint64_t) item.object);
+	}
+
+	return depths;
+}
+
+int main(int argc, char** argv) {
+	std::mt19937_64 random(12345);
+	bool passed = true;
+
+	passed = checkSort("Small", 100, ~0ull, random) && passed;
+	passed = checkSort("Large", 200000, ~0ull, random) && passed;
+	passed = checkSort("Few digits", 200000, 0xFF00000000FF00FFull, random) && passed;
+	passed = checkSort("Same keys", 50000, 0, random) && passed;
+
+	//Two shaders in each pass, with objects at random depths. Each object is its depth, to read it back easily.
+	DrawList drawList;
+	std::vector<DrawItem> opaque;
+	std::vector<DrawItem> translucent;
+
+	for (size_t i = 0; i < 10000; i++) {
+		const uint64_t shader = random() % 2;
+		const uint64_t depth = random() & DrawList::DEPTH_MAX;
+		const uint64_t opaqueKey = DrawList::makeKey(RenderPass::OPAQUE, shader, 0, shader);
+		const uint64_t translucentKey = DrawList::makeKey(RenderPass::TRANSLUCENT, shader, 0, shader);
+
+		opaque.push_back({DrawList::addDepth(opaqueKey, depth, DrawList::getFineDepth(depth)), (const RenderComponent*) depth});
+		translucent.push_back({DrawList::addDepth(translucentKey, depth, 0), (const RenderComponent*) depth});
+	}
+
+	drawList.add(RenderPass::OPAQUE, opaque);
+	drawList.add(RenderPass::TRANSLUCENT, translucent);
+	drawList.sort();
+
+	const std::vector<uint64_t> translucentDepths = getDrawDepths(drawList, RenderPass::TRANSLUCENT);
+
+	if (std::is_sorted(translucentDepths.rbegin(), translucentDepths.rend())) {
+		std::cout << "Translucent back to front test passed.\n";
+	}
+	else {
+		std::cout << "Translucent back to front test failed!\n";
+		passed = false;
+	}
+
+	//Opaque objects should be grouped by shader, and front to back within each shader
+	const std::vector<DrawItem>& opaqueItems = drawList.getItems(RenderPass::OPAQUE);
+	const std::vector<uint64_t> opaqueDepths = getDrawDepths(drawList, RenderPass::OPAQUE);
+	//Coarse and fine depth together order by the top 12 bits of the depth
+	const uint32_t unorderedBits = DrawList::DEPTH_BITS - DrawList::COARSE_DEPTH_BITS - 8;
+	size_t shaderChanges = 0;
+	bool frontToBack = true;
+
+	for (size_t i = 1; i < opaqueItems.size(); i++) {
+		if (DrawList::getShader(opaqueItems.at(i).key) != DrawList::getShader(opaqueItems.at(i - 1).key)) {
+			shaderChanges++;
+		}
+		else if (opaqueDepths.at(i) >> unorderedBits < opaqueDepths.at(i - 1) >> unorderedBits) {
+			frontToBack = false;
+		}
+	}
+
+	if (shaderChanges == 1 && frontToBack) {
+		std::cout << "Opaque front to back test passed.\n";
+	}
+	else {
+		std::cout << "Opaque front to back test failed! " << shaderChanges << " shader changes.\n";
+		passed = false;
+	}
+
+	if (!passed) {
+		return 1;
+	}
+
+	std::cout << "All tests passed.\n";
+	return 0;
+}
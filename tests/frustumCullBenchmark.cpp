@@ -0,0 +1,103 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <cmath>
+
+#include "../src/Renderer/FrustumCuller.hpp"
+#include "../src/ExtraMath.hpp"
+
+//Compares the SIMD frustum culling path with the scalar one, using a large
+//number of objects spread around the camera so some, but not most, are visible.
+
+constexpr size_t OBJECT_COUNT = 100000;
+constexpr size_t REPEATS = 200;
+constexpr float WORLD_SIZE = 1000.0f;
+constexpr float FOV = 1.2f;
+constexpr float NEAR = 0.1f;
+constexpr float FAR = 500.0f;
+
+//Perspective projection looking down -z from the origin, column major like glm.
+std::array<float, 16> makeProjection(float aspect) {
+	const float f = 1.0f / std::tan(FOV / 2.0f);
+	std::array<float, 16> proj = {};
+
+	proj[0] = f / aspect;
+	proj[5] = f;
+	proj[10] = -(FAR + NEAR) / (FAR - NEAR);
+	proj[11] = -1.0f;
+	proj[14] = -(2.0f * FAR * NEAR) / (FAR - NEAR);
+
+	return proj;
+}
+
+template<typename Func>
+double timeCull(Func cull) {
+	double start = ExMath::getTimeMillis();
+
+	for (size_t i = 0; i < REPEATS; i++) {
+		cull();
+	}
+
+	double end = ExMath::getTimeMillis();
+
+	return (end - start) / REPEATS;
+}
+
+int main(int argc, char** argv) {
+	FrustumCuller culler;
+	const std::array<float, 16> proj = makeProjection(16.0f / 9.0f);
+
+	culler.setFrustum(proj.data());
+	culler.resize(OBJECT_COUNT);
+
+	for (size_t i = 0; i < OBJECT_COUNT; i++) {
+		culler.setSphere(i,
+			ExMath::randomFloat(-WORLD_SIZE / 2.0f, WORLD_SIZE / 2.0f),
+			ExMath::randomFloat(-WORLD_SIZE / 2.0f, WORLD_SIZE / 2.0f),
+			ExMath::randomFloat(-WORLD_SIZE / 2.0f, WORLD_SIZE / 2.0f),
+			ExMath::randomFloat(0.5f, 5.0f));
+	}
+
+	std::vector<uint32_t> scalarVisible;
+	std::vector<uint32_t> simdVisible;
+	scalarVisible.reserve(OBJECT_COUNT);
+	simdVisible.reserve(OBJECT_COUNT);
+
+	const double scalarTime = timeCull([&]() {
+		scalarVisible.clear();
+		culler.cullScalar(0, OBJECT_COUNT, scalarVisible);
+	});
+
+	const double simdTime = timeCull([&]() {
+		simdVisible.clear();
+		culler.cull(0, OBJECT_COUNT, simdVisible);
+	});
+
+	if (scalarVisible != simdVisible) {
+		std::cout << "SIMD and scalar culling disagree! Scalar: " << scalarVisible.size() << " visible, SIMD: " << simdVisible.size() << " visible\n";
+		return 1;
+	}
+
+	std::cout << "Objects: " << OBJECT_COUNT << ", visible: " << simdVisible.size() << "\n";
+	std::cout << "Scalar: " << scalarTime << " ms, SIMD: " << simdTime << " ms, speedup: " << scalarTime / simdTime << "\n";
+
+	return 0;
+}
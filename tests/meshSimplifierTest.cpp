@@ -0,0 +1,246 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <array>
+#include <algorithm>
+
+#include "../src/Models/MeshSimplifier.hpp"
+
+//Checks that simplification reduces triangle counts without tearing open edges, losing corners, or leaving degenerate triangles.
+
+typedef std::array<float, 3> Position;
+
+struct TestMesh {
+	std::vector<Position> positions;
+	std::vector<uint32_t> indices;
+};
+
+//Makes a cube from six subdivided faces, with shared vertices along the edges so it's closed.
+TestMesh makeCube(int divisions) {
+	TestMesh mesh;
+	std::map<std::array<int, 3>, uint32_t> vertexIndices;
+
+	auto getVertex = [&](const std::array<int, 3>& gridPos) {
+		auto vertexLoc = vertexIndices.find(gridPos);
+
+		if (vertexLoc != vertexIndices.end()) {
+			return vertexLoc->second;
+		}
+
+		const uint32_t index = mesh.positions.size();
+		vertexIndices.emplace(gridPos, index);
+		mesh.positions.push_back({(float) gridPos[0] / divisions, (float) gridPos[1] / divisions, (float) gridPos[2] / divisions});
+
+		return index;
+	};
+
+	for (int axis = 0; axis < 3; axis++) {
+		for (int side = 0; side < 2; side++) {
+			const int u = (axis + 1) % 3;
+			const int v = (axis + 2) % 3;
+
+			for (int i = 0; i < divisions; i++) {
+				for (int j = 0; j < divisions; j++) {
+					uint32_t corners[4];
+
+					for (int k = 0; k < 4; k++) {
+						std::array<int, 3> gridPos;
+						gridPos[axis] = side * divisions;
+						gridPos[u] = i + (k == 1 || k == 2);
+						gridPos[v] = j + (k >= 2);
+						corners[k] = getVertex(gridPos);
+					}
+
+					//Wind outwards on both sides
+					if (side == 1) {
+						mesh.indices.insert(mesh.indices.end(), {corners[0], corners[1], corners[2], corners[0], corners[2], corners[3]});
+					}
+					else {
+						mesh.indices.insert(mesh.indices.end(), {corners[0], corners[2], corners[1], corners[0], corners[3], corners[2]});
+					}
+				}
+			}
+		}
+	}
+
+	return mesh;
+}
+
+//Makes a flat, open grid.
+TestMesh makeGrid(int divisions) {
+	TestMesh mesh;
+
+	for (int i = 0; i <= divisions; i++) {
+		for (int j = 0; j <= divisions; j++) {
+			mesh.positions.push_back({(float) i, (float) j, 0.0f});
+		}
+	}
+
+	for (int i = 0; i < divisions; i++) {
+		for (int j = 0; j < divisions; j++) {
+			const uint32_t corner = i * (divisions + 1) + j;
+			const uint32_t next = corner + divisions + 1;
+
+			mesh.indices.insert(mesh.indices.end(), {corner, next, next + 1, corner, next + 1, corner + 1});
+		}
+	}
+
+	return mesh;
+}
+
+std::vector<uint32_t> simplify(const TestMesh& mesh, size_t targetTriangles) {
+	MeshSimplifier simplifier((const unsigned char*) mesh.positions.data(), sizeof(Position), mesh.positions.size(), mesh.indices);
+	return simplifier.simplify(targetTriangles);
+}
+
+//Counts how many triangles use each edge, in either direction.
+std::map<std::pair<uint32_t, uint32_t>, size_t> countEdges(const std::vector<uint32_t>& indices) {
+	std::map<std::pair<uint32_t, uint32_t>, size_t> edges;
+
+	for (size_t i = 0; i < indices.size(); i++) {
+		edges[std::minmax(indices.at(i), indices.at(i - i % 3 + (i + 1) % 3))]++;
+	}
+
+	return edges;
+}
+
+bool hasDegenerateTriangles(const TestMesh& mesh, const std::vector<uint32_t>& indices) {
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		const Position& p0 = mesh.positions.at(indices.at(i));
+		const Position& p1 = mesh.positions.at(indices.at(i + 1));
+		const Position& p2 = mesh.positions.at(indices.at(i + 2));
+
+		const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+		const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+		const float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+
+		if (normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] <= 0.0f) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool checkCube() {
+	const TestMesh cube = makeCube(8);
+	const size_t originalTriangles = cube.indices.size() / 3;
+	const std::vector<uint32_t> simplified = simplify(cube, originalTriangles / 8);
+	const size_t triangles = simplified.size() / 3;
+
+	bool passed = true;
+
+	if (triangles > originalTriangles / 4) {
+		std::cout << "Cube reduction test failed! " << originalTriangles << " triangles became " << triangles << ".\n";
+		passed = false;
+	}
+
+	//Every edge should still have exactly two triangles
+	for (const auto& edge : countEdges(simplified)) {
+		if (edge.second != 2) {
+			std::cout << "Cube closed test failed! Edge used by " << edge.second << " triangles.\n";
+			passed = false;
+			break;
+		}
+	}
+
+	//Moving a corner adds a lot of error, so they should all survive
+	const std::set<uint32_t> used(simplified.begin(), simplified.end());
+	size_t corners = 0;
+
+	for (uint32_t vertex : used) {
+		const Position& pos = cube.positions.at(vertex);
+
+		if ((pos[0] == 0.0f || pos[0] == 1.0f) && (pos[1] == 0.0f || pos[1] == 1.0f) && (pos[2] == 0.0f || pos[2] == 1.0f)) {
+			corners++;
+		}
+	}
+
+	if (corners != 8) {
+		std::cout << "Cube corner test failed! " << corners << " corners left.\n";
+		passed = false;
+	}
+
+	if (hasDegenerateTriangles(cube, simplified)) {
+		std::cout << "Cube degenerate triangle test failed!\n";
+		passed = false;
+	}
+
+	if (passed) {
+		std::cout << "Cube test passed, " << originalTriangles << " triangles became " << triangles << ".\n";
+	}
+
+	return passed;
+}
+
+bool checkGrid() {
+	const int divisions = 16;
+	const TestMesh grid = makeGrid(divisions);
+	const size_t originalTriangles = grid.indices.size() / 3;
+	const std::vector<uint32_t> simplified = simplify(grid, 0);
+	const size_t triangles = simplified.size() / 3;
+
+	bool passed = true;
+
+	if (triangles >= originalTriangles / 2) {
+		std::cout << "Grid reduction test failed! " << originalTriangles << " triangles became " << triangles << ".\n";
+		passed = false;
+	}
+
+	//Open edges are locked, so the outline of the grid can't change
+	const std::set<uint32_t> used(simplified.begin(), simplified.end());
+
+	for (size_t i = 0; i < grid.positions.size(); i++) {
+		const Position& pos = grid.positions.at(i);
+		const bool border = pos[0] == 0.0f || pos[1] == 0.0f || pos[0] == divisions || pos[1] == divisions;
+
+		if (border && !used.count(i)) {
+			std::cout << "Grid border test failed! Lost vertex " << i << ".\n";
+			passed = false;
+			break;
+		}
+	}
+
+	if (hasDegenerateTriangles(grid, simplified)) {
+		std::cout << "Grid degenerate triangle test failed!\n";
+		passed = false;
+	}
+
+	if (passed) {
+		std::cout << "Grid test passed, " << originalTriangles << " triangles became " << triangles << ".\n";
+	}
+
+	return passed;
+}
+
+int main(int argc, char** argv) {
+	bool passed = checkCube();
+	passed = checkGrid() && passed;
+
+	if (!passed) {
+		return 1;
+	}
+
+	std::cout << "All tests passed.\n";
+	return 0;
+}
@@ -0,0 +1,124 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <array>
+#include <cmath>
+
+#include "../src/Renderer/OcclusionCuller.hpp"
+
+//Rasterizes a small wall in front of the camera and checks which boxes it hides.
+
+constexpr float FOV = 1.2f;
+constexpr float NEAR = 0.1f;
+constexpr float FAR = 500.0f;
+
+//Perspective projection looking down -z from the origin, column major like glm.
+std::array<float, 16> makeProjection(float aspect) {
+	const float f = 1.0f / std::tan(FOV / 2.0f);
+	std::array<float, 16> proj = {};
+
+	proj[0] = f / aspect;
+	proj[5] = f;
+	proj[10] = -(FAR + NEAR) / (FAR - NEAR);
+	proj[11] = -1.0f;
+	proj[14] = -(2.0f * FAR * NEAR) / (FAR - NEAR);
+
+	return proj;
+}
+
+//Translation matrix, column major.
+std::array<float, 16> makeTranslation(float x, float y, float z) {
+	std::array<float, 16> trans = {};
+
+	trans[0] = 1.0f;
+	trans[5] = 1.0f;
+	trans[10] = 1.0f;
+	trans[12] = x;
+	trans[13] = y;
+	trans[14] = z;
+	trans[15] = 1.0f;
+
+	return trans;
+}
+
+bool checkVisible(const OcclusionCuller& culler, const std::string& name, std::array<float, 3> min, std::array<float, 3> max, bool expected) {
+	if (culler.isVisible(min.data(), max.data()) != expected) {
+		std::cout << name << " test failed! Expected " << (expected ? "visible" : "hidden") << ".\n";
+		return false;
+	}
+
+	std::cout << name << " test passed.\n";
+	return true;
+}
+
+int main(int argc, char** argv) {
+	//A 4x4 square around the origin, with normals between the positions to test the stride.
+	const std::array<float, 24> vertices = {
+		-2.0f, -2.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+		2.0f, -2.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+		2.0f, 2.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+		-2.0f, 2.0f, 0.0f, 0.0f, 0.0f, 1.0f
+	};
+	const std::array<uint32_t, 6> indices = {0, 1, 2, 2, 3, 0};
+	//Same square, but wound the other way.
+	const std::array<uint32_t, 6> reverseIndices = {2, 1, 0, 0, 3, 2};
+
+	const unsigned char* positions = reinterpret_cast<const unsigned char*>(vertices.data());
+	const size_t stride = 6 * sizeof(float);
+
+	const std::array<float, 16> proj = makeProjection(2.0f);
+	const std::array<float, 16> wallTransform = makeTranslation(0.0f, 0.0f, -10.0f);
+
+	OcclusionCuller culler;
+	culler.begin(proj.data());
+
+	if (culler.hasOccluders() || !checkVisible(culler, "Empty buffer", {-0.5f, -0.5f, -30.5f}, {0.5f, 0.5f, -29.5f}, true)) {
+		return 1;
+	}
+
+	culler.addOccluder(wallTransform.data(), positions, stride, indices.data(), indices.size());
+	culler.rasterize();
+
+	bool passed = culler.hasOccluders();
+	passed = checkVisible(culler, "Behind wall", {-0.5f, -0.5f, -30.5f}, {0.5f, 0.5f, -29.5f}, false) && passed;
+	passed = checkVisible(culler, "In front of wall", {-0.5f, -0.5f, -5.5f}, {0.5f, 0.5f, -4.5f}, true) && passed;
+	passed = checkVisible(culler, "Beside wall", {7.5f, -0.5f, -30.5f}, {8.5f, 0.5f, -29.5f}, true) && passed;
+	passed = checkVisible(culler, "Partly behind wall", {5.5f, -0.5f, -30.5f}, {6.5f, 0.5f, -29.5f}, true) && passed;
+	passed = checkVisible(culler, "Intersecting wall", {-0.5f, -0.5f, -10.5f}, {0.5f, 0.5f, -9.5f}, true) && passed;
+	passed = checkVisible(culler, "Crossing near plane", {-0.5f, -0.5f, -1.0f}, {0.5f, 0.5f, 1.0f}, true) && passed;
+	passed = checkVisible(culler, "Off screen", {500.0f, -0.5f, -30.5f}, {501.0f, 0.5f, -29.5f}, false) && passed;
+
+	//Move the wall off to the side and flip its winding, the box behind the old position should show up.
+	const std::array<float, 16> sideTransform = makeTranslation(8.0f, 0.0f, -10.0f);
+
+	culler.begin(proj.data());
+	culler.addOccluder(sideTransform.data(), positions, stride, reverseIndices.data(), reverseIndices.size());
+	culler.rasterize();
+
+	passed = checkVisible(culler, "Moved wall", {-0.5f, -0.5f, -30.5f}, {0.5f, 0.5f, -29.5f}, true) && passed;
+	passed = checkVisible(culler, "Reverse winding", {23.5f, -0.5f, -30.5f}, {24.5f, 0.5f, -29.5f}, false) && passed;
+
+	if (!passed) {
+		return 1;
+	}
+
+	std::cout << "All tests passed.\n";
+	return 0;
+}
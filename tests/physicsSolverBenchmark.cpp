@@ -0,0 +1,133 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include <iostream>
+#include <vector>
+#include <memory>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+
+#include "../src/TBBThreadHandlerBtCompat.hpp"
+#include "../src/ExtraMath.hpp"
+
+//Measures how the physics simulation scales with thread count, using a
+//scene similar to a large game world - lots of stacks of boxes, all touching.
+
+constexpr size_t STACKS_PER_SIDE = 24;
+constexpr size_t STACK_HEIGHT = 8;
+constexpr size_t WARMUP_STEPS = 60;
+constexpr size_t TIMED_STEPS = 300;
+constexpr btScalar TIMESTEP = 1.0 / 60.0;
+constexpr int MAX_BENCH_THREADS = 32;
+
+double runBenchmark(TaskSchedulerTBB& scheduler) {
+	btDefaultCollisionConfiguration conf;
+	btDbvtBroadphase broadphase;
+	btCollisionDispatcherMt dispatcher(&conf, 40);
+	btSequentialImpulseConstraintSolverMt solver;
+	btConstraintSolverPoolMt solverPool(scheduler.getNumThreads());
+	btDiscreteDynamicsWorldMt world(&dispatcher, &broadphase, &solverPool, &solver, &conf);
+	world.setGravity(btVector3(0.0, -9.80665, 0.0));
+
+	//All boxes share one shape, like the engine does.
+	btBoxShape boxShape(btVector3(0.5, 0.5, 0.5));
+	btStaticPlaneShape groundShape(btVector3(0.0, 1.0, 0.0), 0.0);
+
+	std::vector<std::unique_ptr<btDefaultMotionState>> states;
+	std::vector<std::unique_ptr<btRigidBody>> bodies;
+
+	btRigidBody::btRigidBodyConstructionInfo groundInfo(0.0, nullptr, &groundShape);
+	bodies.emplace_back(new btRigidBody(groundInfo));
+	world.addRigidBody(bodies.back().get());
+
+	btVector3 inertia;
+	boxShape.calculateLocalInertia(1.0, inertia);
+
+	for (size_t x = 0; x < STACKS_PER_SIDE; x++) {
+		for (size_t z = 0; z < STACKS_PER_SIDE; z++) {
+			for (size_t y = 0; y < STACK_HEIGHT; y++) {
+				btTransform transform;
+				transform.setIdentity();
+				transform.setOrigin(btVector3(x * 3.0, 0.5 + y * 1.01, z * 3.0));
+
+				states.emplace_back(new btDefaultMotionState(transform));
+
+				btRigidBody::btRigidBodyConstructionInfo info(1.0, states.back().get(), &boxShape, inertia);
+				bodies.emplace_back(new btRigidBody(info));
+				world.addRigidBody(bodies.back().get());
+			}
+		}
+	}
+
+	for (size_t i = 0; i < WARMUP_STEPS; i++) {
+		world.stepSimulation(TIMESTEP, 0);
+	}
+
+	double start = ExMath::getTimeMillis();
+
+	for (size_t i = 0; i < TIMED_STEPS; i++) {
+		world.stepSimulation(TIMESTEP, 0);
+	}
+
+	double end = ExMath::getTimeMillis();
+
+	for (std::unique_ptr<btRigidBody>& body : bodies) {
+		world.removeRigidBody(body.get());
+	}
+
+	return (end - start) / TIMED_STEPS;
+}
+
+int main(int argc, char** argv) {
+	TaskSchedulerTBB scheduler;
+	btSetTaskScheduler(&scheduler);
+
+	const int maxThreads = scheduler.getMaxNumThreads();
+
+	std::cout << "Bodies: " << STACKS_PER_SIDE * STACKS_PER_SIDE * STACK_HEIGHT << ", steps: " << TIMED_STEPS << ", max threads: " << maxThreads << "\n\n";
+	std::cout << "threads\tms/step\tspeedup\n";
+
+	double singleThreaded = 0.0;
+
+	for (int threads = 1; threads <= MAX_BENCH_THREADS; threads++) {
+		//Thread count is clamped to what the machine supports, so higher counts would just repeat the last one.
+		if (threads > maxThreads) {
+			std::cout << threads << "\t-\t-\n";
+			continue;
+		}
+
+		scheduler.setNumThreads(threads);
+		double stepTime = runBenchmark(scheduler);
+
+		if (threads == 1) {
+			singleThreaded = stepTime;
+		}
+
+		std::cout << threads << "\t" << stepTime << "\t" << singleThreaded / stepTime << "\n";
+	}
+
+	if (maxThreads < MAX_BENCH_THREADS) {
+		std::cout << "\nCounts above " << maxThreads << " skipped, this machine doesn't have enough hardware threads.\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/******************************************************************************
+ * SGIS-Engine - the engine for SGIS
+ * Copyright (C) 2020
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstring>
+
+#include "../src/Renderer/Std140Aligner.hpp"
+#include "../src/Renderer/UniformLayout.hpp"
+
+//Packs the same values with a compiled layout and a Std140Aligner, and checks the results match.
+
+bool checkLayout(const std::string& name, const UniformList& uniforms) {
+	UniformSet set(UniformSetType::PER_OBJECT, 1, uniforms);
+	UniformLayout layout(set);
+	Std140Aligner aligner(set.getBufferedUniforms());
+
+	if (layout.getSize() != aligner.getData().second || layout.getInstanceStride() != Std140Aligner::getInstanceStride(set)) {
+		std::cout << name << " test failed! Sizes don't match.\n";
+		return false;
+	}
+
+	//Every uniform reads from the start of the same array of distinct values
+	std::array<float, 64> values = {};
+
+	for (size_t i = 0; i < values.size(); i++) {
+		values.at(i) = (float) i + 1.0f;
+	}
+
+	//Padding isn't written by either, so start both from zero
+	std::memset(const_cast<unsigned char*>(aligner.getData().first), 0, aligner.getData().second);
+	std::vector<unsigned char> block(layout.getSize(), 0);
+
+	for (const UniformDescription& uniform : set.getBufferedUniforms()) {
+		const size_t count = uniform.count;
+
+		switch (uniform.type) {
+			case UniformType::FLOAT: count ? aligner.setFloatArray(uniform.name, 0, count, values.data()) : aligner.setFloat(uniform.name, values.at(0)); break;
+			case UniformType::VEC2: count ? aligner.setVec2Array(uniform.name, 0, count, (const glm::vec2*) values.data()) : aligner.setVec2(uniform.name, *(const glm::vec2*) values.data()); break;
+			case UniformType::VEC3: count ? aligner.setVec3Array(uniform.name, 0, count, (const glm::vec3*) values.data()) : aligner.setVec3(uniform.name, *(const glm::vec3*) values.data()); break;
+			case UniformType::VEC4: count ? aligner.setVec4Array(uniform.name, 0, count, (const glm::vec4*) values.data()) : aligner.setVec4(uniform.name, *(const glm::vec4*) values.data()); break;
+			case UniformType::MAT3: count ? aligner.setMat3Array(uniform.name, 0, count, (const glm::mat3*) values.data()) : aligner.setMat3(uniform.name, *(const glm::mat3*) values.data()); break;
+			case UniformType::MAT4: count ? aligner.setMat4Array(uniform.name, 0, count, (const glm::mat4*) values.data()) : aligner.setMat4(uniform.name, *(const glm::mat4*) values.data()); break;
+			default: break;
+		}
+	}
+
+	for (const UniformRecord& record : layout.getRecords()) {
+		UniformLayout::writeValue(record, values.data(), block.data());
+	}
+
+	if (std::memcmp(block.data(), aligner.getData().first, block.size()) != 0) {
+		std::cout << name << " test failed! Packed data doesn't match.\n";
+		return false;
+	}
+
+	std::cout << name << " test passed.\n";
+	return true;
+}
+
+int main(int argc, char** argv) {
+	bool passed = true;
+
+	passed = checkLayout("Matrices", {
+		{UniformType::MAT4, "modelView", 0, UniformProviderType::OBJECT_MODEL_VIEW, USE_VERTEX_SHADER},
+		{UniformType::MAT3, "normal", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::MAT4, "transform", 0, UniformProviderType::OBJECT_TRANSFORM, USE_VERTEX_SHADER}
+	}) && passed;
+
+	passed = checkLayout("Mixed", {
+		{UniformType::FLOAT, "a", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::VEC3, "b", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::FLOAT, "c", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::VEC2, "d", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::MAT3, "e", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::FLOAT, "f", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER}
+	}) && passed;
+
+	passed = checkLayout("Arrays", {
+		{UniformType::FLOAT, "a", 3, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::VEC2, "b", 2, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::VEC3, "c", 0, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::MAT3, "d", 2, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::VEC4, "e", 2, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER},
+		{UniformType::MAT4, "f", 2, UniformProviderType::OBJECT_STATE, USE_VERTEX_SHADER}
+	}) && passed;
+
+	//Object providers aren't allowed in screen sets
+	try {
+		UniformLayout layout(UniformSet(UniformSetType::PER_SCREEN, 1, {{UniformType::MAT4, "transform", 0, UniformProviderType::OBJECT_TRANSFORM, USE_VERTEX_SHADER}}));
+
+		std::cout << "Provider validation test failed! No exception thrown.\n";
+		passed = false;
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "Provider validation test passed.\n";
+	}
+
+	if (!passed) {
+		return 1;
+	}
+
+	std::cout << "All tests passed.\n";
+	return 0;
+}